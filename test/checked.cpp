@@ -0,0 +1,112 @@
+//
+// Test of the checked mode. NaN, infinite and subnormal results must be
+// reported with their unit and call site, and finite normal results must not.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "tu/typesafe_units.h"
+#include "tu/calculus.h"
+
+using namespace tu;
+
+namespace {
+constexpr std::size_t capacity = 16;
+Check_report reports[capacity];
+std::size_t count = 0;
+
+void record(const Check_report& r) {
+  if (count < capacity) {
+    reports[count] = r;
+  }
+  ++count;
+}
+
+int failures = 0;
+
+void expect(bool condition, int line) {
+  if (!condition) {
+    std::printf("checked.cpp:%d failed\n", line);
+    ++failures;
+  }
+}
+
+//
+// Exactly one report of `failure` for `unit` from `line` of this file.
+//
+void expect_report(check_failure failure, const char* unit, unsigned line, int test_line) {
+  expect(count == 1, test_line);
+  expect(reports[0].failure == failure, test_line);
+  expect(std::strcmp(reports[0].unit, unit) == 0, test_line);
+  expect(reports[0].call_site.line() == line && std::strstr(reports[0].call_site.file_name(), "checked.cpp") != nullptr, test_line);
+  count = 0;
+}
+} // namespace
+
+int main() {
+  static_assert(std::string_view(internal::dimension_name<std::ratio<-2>, std::ratio<2>, std::ratio<1>, std::ratio<0>,
+                                                           std::ratio<0>, std::ratio<0>, std::ratio<0>>.data()) == "s^-2 m^2 kg");
+  static_assert(std::string_view(internal::dimension_name<std::ratio<0>, std::ratio<-1, 2>, std::ratio<0>, std::ratio<0>,
+                                                           std::ratio<3>, std::ratio<0>, std::ratio<0>>.data()) == "m^-1/2 K^3");
+  static_assert(std::string_view(internal::dimension_name<std::ratio<0>, std::ratio<0>, std::ratio<0>, std::ratio<0>,
+                                                           std::ratio<0>, std::ratio<0>, std::ratio<0>>.data()) == "1");
+
+  Check_handler previous = set_check_handler(record);
+  expect(previous == internal::print_check_report, __LINE__);
+
+  const TU_TYPE huge = std::numeric_limits<TU_TYPE>::max();
+  const TU_TYPE tiny = std::numeric_limits<TU_TYPE>::min();
+
+  // Finite normal results are not reported.
+  const Unit<prefix::no_prefix, electronvolt> e(1.0f);
+  const joule j = e + joule(1.0f);
+  const auto j2 = pow<std::ratio<2>>(j);
+  const Unit<prefix::kilo, electronvolt> ke = j;
+  expect(count == 0 && ke.value > (TU_TYPE)0.0 && j2.base_value > (TU_TYPE)0.0, __LINE__);
+
+  // Construction and conversion report the caller.
+  const metre m(huge * (TU_TYPE)2.0); expect_report(check_failure::infinite, "m", __LINE__, __LINE__);
+  const Unit<prefix::milli, metre> mm(m); expect_report(check_failure::infinite, "m", __LINE__, __LINE__);
+  const Unit<prefix::no_prefix, second> s(tiny / (TU_TYPE)4.0); expect_report(check_failure::subnormal, "s", __LINE__, __LINE__);
+  const auto c = convert_to<prefix::milli, second>(Unit<prefix::no_prefix, second>(huge)); expect_report(check_failure::infinite, "s", __LINE__, __LINE__);
+  (void)mm;
+  (void)c;
+
+  // pow, sqrt and unop report the caller.
+  const auto root = sqrt(metre_squared(-1.0f)); expect_report(check_failure::nan, "m", __LINE__, __LINE__);
+  const auto cube = pow<std::ratio<3>>(metre(huge)); expect_report(check_failure::infinite, "m^3", __LINE__, __LINE__);
+  const auto l = unop<std::log>(scalar(0.0f)); expect_report(check_failure::infinite, "1", __LINE__, __LINE__);
+  (void)root;
+  (void)cube;
+  (void)l;
+
+  // Operators report the operator with the operand types.
+  const auto w = joule(tiny) / second(4.0f);
+  expect(count == 1 && reports[0].failure == check_failure::subnormal && std::strcmp(reports[0].unit, "s^-3 m^2 kg") == 0, __LINE__);
+  expect(std::strstr(reports[0].call_site.function_name(), "operator/") != nullptr, __LINE__);
+  count = 0;
+  (void)w;
+
+  // Batch results report the kernel.
+  std::vector<watt> p(4, watt(huge));
+  std::vector<joule> energy(p.size());
+  cumulative_trapezoid(std::span<const watt>(p), second(4.0f), std::span<joule>(energy));
+  expect(count == 3 && std::strcmp(reports[0].unit, "s^-2 m^2 kg") == 0, __LINE__);
+  count = 0;
+
+  // Constant expressions are not checked.
+  constexpr metre nan(std::numeric_limits<TU_TYPE>::quiet_NaN());
+  (void)nan;
+  expect(count == 0, __LINE__);
+
+  if (failures > 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+//
+// Test and benchmark of flushing subnormal values to zero. `Flush_denormals`
+// must set the mode of the calling thread and restore the previous one,
+// workers of the batch kernels must run in the mode of the calling thread,
+// and `policy::flushed` must set the mode for one kernel only.
+//
+// The benchmark runs kernels on quantities in dalton and electronvolt, whose
+// products are subnormal in float, with and without flushing and prints the
+// times. In double they stay normal, so flushing makes no difference there.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "tu/typesafe_units.h"
+#include "tu/calculus.h"
+#include "tu/denormal.h"
+
+using namespace tu;
+
+namespace {
+int failures = 0;
+
+void expect(bool condition, int line) {
+  if (!condition) {
+    std::printf("denormal.cpp:%d failed\n", line);
+    ++failures;
+  }
+}
+
+volatile TU_TYPE sink;
+
+//
+// Best time of `runs` calls of f in milliseconds.
+//
+template<typename F>
+double best_time(F&& f, int runs = 20) {
+  double best = std::numeric_limits<double>::max();
+  for (int r = 0; r < runs; ++r) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+template<typename F>
+void benchmark(const char* name, F&& f) {
+  const double plain = best_time(f);
+  double flushed;
+  {
+    const Flush_denormals flush;
+    flushed = best_time(f);
+  }
+  std::printf("%-40s %10.3f %10.3f %8.1fx\n", name, plain, flushed, plain / flushed);
+}
+} // namespace
+
+int main() {
+  using Mass = Unit<prefix::no_prefix, dalton>;
+  using Energy = Unit<prefix::no_prefix, electronvolt>;
+  const TU_TYPE tiny = std::numeric_limits<TU_TYPE>::denorm_min() * (TU_TYPE)1000.0;
+  const std::size_t n = 1 << 16;
+  const std::vector<kilogram> subnormal(n, kilogram(tiny));
+  const std::span<const kilogram> values(subnormal);
+
+  expect(std::fpclassify(tiny) == FP_SUBNORMAL, __LINE__);
+  expect(sum(values).base_value > (TU_TYPE)0.0, __LINE__);
+  if (can_flush_denormals) {
+    const bool before = denormals_flushed();
+    {
+      const Flush_denormals flush;
+      expect(denormals_flushed(), __LINE__);
+      {
+        const Flush_denormals keep(false);
+        expect(!denormals_flushed(), __LINE__);
+      }
+      expect(denormals_flushed(), __LINE__);
+      // Subnormal inputs are read as zero, also by the workers.
+      expect(sum(values, 4).base_value == (TU_TYPE)0.0, __LINE__);
+      expect(sum(values, 4, policy::strict).base_value == (TU_TYPE)0.0, __LINE__);
+    }
+    expect(denormals_flushed() == before, __LINE__);
+
+    // The policy flushes for the kernel only.
+    expect(sum(values, 4, policy::flushed).base_value == (TU_TYPE)0.0, __LINE__);
+    expect(sum(values, 4, policy::Flushed<policy::Reproducible>{}).base_value == (TU_TYPE)0.0, __LINE__);
+    expect(denormals_flushed() == before, __LINE__);
+    expect(sum(values, 4).base_value > (TU_TYPE)0.0, __LINE__);
+  }
+
+  // Normal results are the same with and without flushing.
+  std::vector<second> time;
+  std::vector<watt> power;
+  for (std::size_t i = 0; i < 1000; ++i) {
+    time.push_back(second((TU_TYPE)i * (TU_TYPE)0.01));
+    power.push_back(watt((TU_TYPE)1.0 + (TU_TYPE)(i % 10)));
+  }
+  const std::span<const second> ts(time);
+  const std::span<const watt> ps(power);
+  expect(trapezoid(ts, ps, 1, policy::Flushed<policy::Strict>{}) == trapezoid(ts, ps, 1, policy::strict), __LINE__);
+
+  // Masses of molecules in dalton, energies in electronvolt and their
+  // squares in millielectronvolt.
+  std::vector<Mass> mass;
+  std::vector<Energy> energy;
+  std::vector<Power_unit<joule, std::ratio<2>>> squared;
+  for (std::size_t i = 0; i < n; ++i) {
+    mass.push_back(Mass((TU_TYPE)i * (TU_TYPE)100.0));
+    energy.push_back(Energy((TU_TYPE)1.0 + (TU_TYPE)(i % 7)));
+    const joule e = Unit<prefix::milli, electronvolt>((TU_TYPE)1.0 + (TU_TYPE)(i % 7));
+    squared.push_back(e * e);
+  }
+  const std::span<const Mass> ms(mass);
+  const std::span<const Energy> es(energy);
+  std::vector<Product_unit<joule, kilogram>> running(n);
+
+  std::printf("%-40s %10s %10s %9s\n", "kernel", "plain ms", "flushed ms", "speedup");
+  benchmark("trapezoid electronvolt over dalton", [&] { sink = trapezoid(ms, es).base_value; });
+  benchmark("cumulative_trapezoid", [&] {
+    cumulative_trapezoid(ms, es, std::span<Product_unit<joule, kilogram>>(running));
+  });
+  benchmark("sum of squared millielectronvolt", [&] {
+    sink = sum(std::span<const Power_unit<joule, std::ratio<2>>>(squared)).base_value;
+  });
+
+  if (failures > 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
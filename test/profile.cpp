@@ -0,0 +1,103 @@
+//
+// Test of the conversion profile. Conversions must be counted per unit pair
+// and call site on each thread, and merged and ranked across threads.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "tu/typesafe_units.h"
+
+using namespace tu;
+
+namespace {
+int failures = 0;
+
+void expect(bool condition, int line) {
+  if (!condition) {
+    std::printf("profile.cpp:%d failed\n", line);
+    ++failures;
+  }
+}
+
+//
+// Converts `n` times on three lines and returns the line of the first. The
+// last line has one conversion from kelvin to degree Celsius and two
+// promotions each of degree Celsius and kilometre.
+//
+unsigned convert(int n) {
+  const Unit<prefix::milli, metre> mm(5.0f);
+  const unsigned line = __LINE__ + 2;
+  for (int i = 0; i < n; ++i) {
+    const metre m = mm + metre(1.0f);
+    const Unit<prefix::kilo, metre> km(m); const Unit<prefix::no_prefix, minute> min(second(m.base_value));
+    const auto c = convert_to<prefix::no_prefix, degree_Celsius>(Unit<prefix::no_prefix, kelvin>(300.0f)); const auto f = c + c; const auto g = sqrt(km * km);
+    (void)min;
+    (void)f;
+    (void)g;
+  }
+  return line;
+}
+} // namespace
+
+int main() {
+  // Only conversions are counted.
+  const metre a(1.0f);
+  const Unit<prefix::milli, metre> b(2.0f);
+  const auto area = a * a + metre_squared(1.0f);
+  const Unit<prefix::no_prefix, metre> c(a.base_value);
+  (void)area;
+  (void)c;
+  expect(thread_conversion_profile().total() == 0, __LINE__);
+
+  const metre d = b; const Unit<prefix::kilo, metre> e = a; const Unit<prefix::kilo, metre> f = convert_to<prefix::kilo, metre>(b);
+  const unsigned line = __LINE__ - 1;
+  (void)d;
+  (void)e;
+  (void)f;
+  std::vector<Conversion_count> sites = thread_conversion_profile().ranked();
+  expect(sites.size() == 3 && thread_conversion_profile().total() == 3, __LINE__);
+  for (const Conversion_count& s : sites) {
+    expect(s.count == 1 && s.call_site.line() == line, __LINE__);
+    expect(s.to->multiplier == (TU_TYPE)1.0 || s.to->multiplier == (TU_TYPE)1000.0, __LINE__);
+    expect(std::strcmp(s.from->dimension, "m") == 0 && std::strcmp(s.to->dimension, "m") == 0, __LINE__);
+  }
+  thread_conversion_profile().clear();
+
+  // Counts of several threads are merged and the sites ranked.
+  Conversion_profile total;
+  {
+    std::vector<std::jthread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&total] {
+        convert(1000);
+        collect_conversion_profile(total);
+      });
+    }
+  }
+  expect(thread_conversion_profile().total() == 0, __LINE__);
+  const unsigned first = convert(0);
+  sites = total.ranked();
+  expect(sites.size() == 6 && total.total() == 4 * 8000, __LINE__);
+  expect(sites[0].call_site.line() == first + 2 && sites[0].count == 8000, __LINE__);
+  expect(sites[1].call_site.line() == first + 2 && sites[1].count == 8000, __LINE__);
+  expect(sites[0].from->adder != (TU_TYPE)0.0 || sites[1].from->adder != (TU_TYPE)0.0, __LINE__);
+  for (std::size_t i = 2; i < sites.size(); ++i) {
+    expect(sites[i].count == 4000, __LINE__);
+  }
+
+  Conversion_profile twice;
+  twice.merge(total);
+  twice.merge(total);
+  expect(twice.ranked().size() == 6 && twice.total() == 2 * total.total(), __LINE__);
+
+  total.print(stdout, 3);
+
+  if (failures > 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
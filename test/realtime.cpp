@@ -0,0 +1,478 @@
+//
+// Real-time safety audit of the quantity API. Every scalar operation and the
+// single threaded batch kernels are run with the global allocator
+// interposed, exceptions caught and the latency of each call measured. An
+// operation fails the audit if it allocates, throws, or has a 99th percentile
+// or a worst case latency above its budget. Objects that allocate by design,
+// e.g. splines, transforms, sparse matrices and the workspace of
+// conjugate_gradient, are built before the audit.
+//
+// On glibc malloc, calloc, realloc, memalign, aligned_alloc, posix_memalign
+// and free are replaced and forward to the __libc_ versions, so also
+// allocations by the C++ runtime are seen. Everywhere the global operator new
+// and delete, also the aligned ones, are replaced. Each allocation and
+// deallocation is counted once.
+//
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <vector>
+
+#include "tu/typesafe_units.h"
+#include "tu/complex.h"
+#include "tu/level.h"
+#include "tu/angle.h"
+#include "tu/random.h"
+#include "tu/polynomial.h"
+#include "tu/solver.h"
+#include "tu/spline.h"
+#include "tu/pid.h"
+#include "tu/rotation.h"
+#include "tu/sparse.h"
+#include "tu/grid.h"
+#include "tu/calculus.h"
+#include "tu/regression.h"
+#include "tu/fft.h"
+#include "tu/resample.h"
+
+namespace {
+std::atomic<bool> armed{false};
+std::atomic<std::size_t> allocations{0};
+
+void note() noexcept {
+  if (armed.load(std::memory_order_relaxed)) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+} // namespace
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* p);
+
+void* malloc(std::size_t size) noexcept {
+  note();
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) noexcept {
+  note();
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, std::size_t size) noexcept {
+  note();
+  return __libc_realloc(p, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) noexcept {
+  note();
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+  note();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, std::size_t alignment, std::size_t size) noexcept {
+  note();
+  if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  void* q = __libc_memalign(alignment, size);
+  if (q == nullptr) {
+    return ENOMEM;
+  }
+  *p = q;
+  return 0;
+}
+
+void free(void* p) noexcept {
+  if (p != nullptr) {
+    note();
+  }
+  __libc_free(p);
+}
+}
+
+// operator new and delete are seen by the replaced malloc and free.
+constexpr bool malloc_replaced = true;
+#else
+constexpr bool malloc_replaced = false;
+#endif
+
+namespace {
+void* aligned_allocate(std::size_t size, std::size_t alignment) noexcept {
+#if defined(_MSC_VER)
+  return _aligned_malloc(size, alignment);
+#else
+  // aligned_alloc needs a size that is a multiple of the alignment.
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+void aligned_free(void* p) noexcept {
+#if defined(_MSC_VER)
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+} // namespace
+
+void* operator new(std::size_t size) {
+  if (!malloc_replaced) {
+    note();
+  }
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  if (!malloc_replaced) {
+    note();
+  }
+  if (void* p = aligned_allocate(size == 0 ? 1 : size, (std::size_t)alignment)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+  if (p != nullptr && !malloc_replaced) {
+    note();
+  }
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  if (p != nullptr && !malloc_replaced) {
+    note();
+  }
+  aligned_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept {
+  operator delete(p, alignment);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept {
+  operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept {
+  operator delete(p, alignment);
+}
+
+using namespace tu;
+
+namespace {
+using namespace std::chrono_literals;
+
+//
+// Budgets for the 99th percentile and the worst case latency. They are loose
+// enough for debug builds and loaded machines, and catch calls that block or
+// page.
+//
+struct Budget {
+  std::chrono::nanoseconds p99;
+  std::chrono::nanoseconds max;
+};
+
+constexpr Budget scalar_budget{20us, 1ms};
+constexpr Budget kernel_budget{5ms, 50ms};
+
+//
+// A worst case above its budget is measured again up to this many times,
+// since a single call can be preempted by the operating system. A call that
+// blocks or pages does so in every round.
+//
+constexpr int rounds = 3;
+
+constexpr std::size_t runs = 2000;
+std::array<std::chrono::nanoseconds, runs> latency;
+
+volatile TU_TYPE sink;
+
+int failures = 0;
+
+template<typename F>
+void audit(const char* name, Budget budget, F&& f) {
+  // Warm up caches and lazily initialized state of the runtime.
+  for (int i = 0; i < 10; ++i) {
+    try {
+      f();
+    } catch (...) {
+    }
+  }
+  std::size_t allocated = 0;
+  std::size_t exceptions = 0;
+  std::chrono::nanoseconds p99{};
+  bool failed = false;
+  for (int round = 0; round < rounds; ++round) {
+    exceptions = 0;
+    allocations = 0;
+    armed = true;
+    for (std::size_t i = 0; i < runs; ++i) {
+      const auto start = std::chrono::steady_clock::now();
+      try {
+        f();
+      } catch (...) {
+        ++exceptions;
+      }
+      latency[i] = std::chrono::steady_clock::now() - start;
+    }
+    armed = false;
+    allocated = allocations;
+    std::sort(latency.begin(), latency.end());
+    p99 = latency[runs * 99 / 100];
+    failed = allocated > 0 || exceptions > 0 || p99 > budget.p99 || latency.back() > budget.max;
+    if (!failed || allocated > 0 || exceptions > 0 || p99 > budget.p99) {
+      break;
+    }
+  }
+  failures += failed ? 1 : 0;
+  std::printf("%-34s %s allocations %6zu exceptions %4zu p99 %9lld ns max %9lld ns\n", name, failed ? "FAIL" : "ok  ",
+              allocated, exceptions, (long long)p99.count(), (long long)latency.back().count());
+}
+
+// Operations that must not throw.
+static_assert(noexcept(metre(1.0f)));
+static_assert(noexcept(Unit<prefix::milli, metre>(1.0f)));
+static_assert(noexcept(metre(Unit<prefix::milli, metre>(1.0f))));
+static_assert(noexcept(Unit<prefix::milli, metre>(metre(1.0f))));
+static_assert(noexcept(metre(1.0f) + metre(1.0f)));
+static_assert(noexcept(metre(1.0f) - Unit<prefix::milli, metre>(1.0f)));
+static_assert(noexcept(metre(1.0f) * second(1.0f)));
+static_assert(noexcept(metre(1.0f) / Unit<prefix::milli, second>(1.0f)));
+static_assert(noexcept(metre(1.0f) < metre(1.0f)));
+static_assert(noexcept(metre(1.0f) == Unit<prefix::milli, metre>(1.0f)));
+static_assert(noexcept(pow<std::ratio<3>>(metre(1.0f))));
+static_assert(noexcept(sqrt(metre_squared(1.0f))));
+static_assert(noexcept(unop<std::sin>(radian(1.0f))));
+static_assert(noexcept(convert_to<prefix::kilo, metre>(Unit<prefix::no_prefix, metre>(1.0f))));
+} // namespace
+
+int main() {
+  constexpr std::size_t n = 1024;
+  std::vector<metre> x;
+  std::vector<second> time;
+  std::vector<watt> power;
+  for (std::size_t i = 0; i < n; ++i) {
+    x.push_back(metre((TU_TYPE)1.0 + (TU_TYPE)(i % 17) * (TU_TYPE)0.1));
+    time.push_back(second((TU_TYPE)i * (TU_TYPE)0.01));
+    power.push_back(watt((TU_TYPE)100.0 + (TU_TYPE)(i % 13)));
+  }
+  std::vector<metre> y(n);
+  std::vector<watt> p(n);
+  std::vector<joule> energy(n);
+  std::vector<Quotient_unit<watt, second>> slope(n);
+  const std::span<const metre> xs(x);
+  const std::span<const second> ts(time);
+  const std::span<const watt> ps(power);
+
+  std::printf("Real-time audit, %zu runs per operation\n", runs);
+
+  // Scalar operations.
+  audit("construct", scalar_budget, [] { sink = metre((TU_TYPE)sink).base_value; });
+  audit("convert", scalar_budget, [] { sink = Unit<prefix::kilo, metre>(metre((TU_TYPE)sink)).value; });
+  audit("arithmetic", scalar_budget, [] {
+    const metre a((TU_TYPE)sink);
+    sink = ((a + Unit<prefix::milli, metre>(1.0f)) * a / second(2.0f) - metre_squared(1.0f) / second(1.0f)).base_value;
+  });
+  audit("compare", scalar_budget, [] { sink = metre((TU_TYPE)sink) < Unit<prefix::kilo, metre>(1.0f) ? (TU_TYPE)1.0 : (TU_TYPE)0.0; });
+  audit("pow sqrt", scalar_budget, [] { sink = sqrt(pow<std::ratio<2>>(metre((TU_TYPE)sink) + metre(1.0f))).base_value; });
+  audit("unop", scalar_budget, [] { sink = unop<std::sin>(Unit<prefix::no_prefix, degree>((TU_TYPE)sink)).base_value; });
+  audit("convert_to", scalar_budget, [] { sink = convert_to<prefix::kilo, metre>(Unit<prefix::no_prefix, metre>((TU_TYPE)sink)).value; });
+  audit("Complex multiply divide", scalar_budget, [] {
+    const Complex<ohm> z(ohm(3.0f), ohm((TU_TYPE)sink + (TU_TYPE)1.0));
+    sink = (z * Complex<ampere>(ampere(2.0f)) / z).real().base_value;
+  });
+  audit("Level", scalar_budget, [] { sink = dBm(watt((TU_TYPE)sink + (TU_TYPE)1.0)).linear().base_value; });
+  audit("Wrapped_angle", scalar_budget, [] {
+    sink = shortest_difference(radian((TU_TYPE)sink), Wrapped_angle<angle_range::positive>(radian(7.0f))).base_value;
+  });
+  audit("Quaternion Rotation_matrix", scalar_budget, [] {
+    const Quaternion q = Quaternion::from_axis_angle(Vec3<metre>{metre(0.0f), metre(0.0f), metre(1.0f)}, radian((TU_TYPE)sink))
+                         * Quaternion::from_euler(radian(0.1f), radian(0.2f), radian(0.3f));
+    const Rotation_matrix r = Rotation_matrix(q) * Rotation_matrix::about_x(radian(0.1f)) * Rotation_matrix::about_y(radian(0.2f))
+                              * Rotation_matrix::about_z(radian(0.3f));
+    sink = r.rotate(Vec3<metre>{metre(1.0f), metre(0.0f), metre(0.0f)}).x.base_value;
+  });
+  audit("integrate", scalar_budget, [] {
+    const Vec3<Quotient_unit<radian, second>> omega{Quotient_unit<radian, second>(0.1f), Quotient_unit<radian, second>((TU_TYPE)sink),
+                                                    Quotient_unit<radian, second>(0.3f)};
+    sink = integrate(Quaternion(1.0f, 0.0f, 0.0f, 0.0f), omega, Unit<prefix::milli, second>(10.0f)).w;
+  });
+  Random_stream draws(3, 4);
+  audit("draw", scalar_budget, [&] { sink = draw(Normal_distribution<metre>{metre(1.0f), metre(0.1f)}, draws).base_value; });
+
+  // Scalar solvers of x^2 = 2 m^2.
+  static volatile TU_TYPE two = 2.0f;
+  const auto square = [](metre v) { return v * v - metre_squared((TU_TYPE)two); };
+  audit("newton_raphson", scalar_budget, [&] {
+    sink = newton_raphson(square, [](metre v) { return v + v; }, metre(1.0f), metre(1.0e-6f), metre_squared(1.0e-6f)).x.base_value;
+  });
+  audit("bisection brent", scalar_budget, [&] {
+    sink = bisection(square, metre(0.0f), metre(2.0f), metre(1.0e-6f), metre_squared(1.0e-6f)).x.base_value
+           + brent(square, metre(0.0f), metre(2.0f), metre(1.0e-6f), metre_squared(1.0e-6f)).x.base_value;
+  });
+  audit("minimize", scalar_budget, [&] {
+    sink = minimize([](metre v) { return (v - metre((TU_TYPE)two)) * (v - metre((TU_TYPE)two)); }, metre(0.0f), metre(4.0f),
+                    metre(1.0e-6f)).x.base_value;
+  });
+
+  // Batch kernels on one thread.
+  std::vector<dBm> level(n);
+  audit("to_level to_linear", kernel_budget, [&] {
+    to_level(ps, std::span<dBm>(level));
+    to_linear(std::span<const dBm>(level), std::span<watt>(p));
+  });
+  std::vector<radian> angle(n);
+  std::vector<Wrapped_angle<angle_range::symmetric>> wrapped(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::construct_at(&angle[i], (TU_TYPE)i * (TU_TYPE)0.1);
+  }
+  audit("wrap", kernel_budget, [&] {
+    wrap(std::span<const radian>(angle), std::span<Wrapped_angle<angle_range::symmetric>>(wrapped));
+  });
+  Random_stream stream(1, 2);
+  audit("generate", kernel_budget, [&] {
+    generate(Normal_distribution<metre>{metre(1.0f), metre(0.1f)}, stream, std::span<metre>(y));
+  });
+  const Polynomial<metre, watt, 3> polynomial(watt(1.0f), Quotient_unit<watt, metre>(2.0f), Quotient_unit<watt, metre_squared>(3.0f));
+  audit("Polynomial evaluate", kernel_budget, [&] { evaluate(polynomial, xs, std::span<watt>(p)); });
+  audit("newton_raphson batch", kernel_budget, [&] {
+    for (std::size_t i = 0; i < n; ++i) {
+      std::construct_at(&y[i], (TU_TYPE)1.0);
+    }
+    sink = (TU_TYPE)newton_raphson([&](std::size_t i, metre v) { return v * v - metre_squared(x[i].base_value); },
+                                   [](std::size_t, metre v) { return v + v; }, std::span<metre>(y), metre(1.0e-3f),
+                                   metre_squared(1.0e-3f));
+  });
+  const Spline spline(spline_kind::akima, ts.first(64), ps.first(64));
+  audit("Spline evaluate", kernel_budget, [&] { evaluate(spline, ts, std::span<watt>(p)); });
+  Pid_parameters<kelvin, watt> parameters{.kp = Quotient_unit<watt, kelvin>(2.0f),
+                                          .ki = Quotient_unit<watt, Product_unit<kelvin, second>>(0.5f),
+                                          .kd = Quotient_unit<Product_unit<watt, second>, kelvin>(0.1f),
+                                          .derivative_filter = Unit<prefix::milli, second>(10.0f),
+                                          .tracking = second(1.0f),
+                                          .lower = watt(-100.0f),
+                                          .upper = watt(100.0f)};
+  Pid<kelvin, watt> pid(parameters, Unit<prefix::milli, second>(10.0f));
+  audit("Pid update", scalar_budget, [&] { sink = pid.update(kelvin(300.0f), kelvin((TU_TYPE)sink + (TU_TYPE)290.0)).base_value; });
+  constexpr std::size_t loops = 64;
+  Pid_bank<kelvin, watt, loops> bank(parameters, Unit<prefix::milli, second>(10.0f));
+  std::array<kelvin, loops> setpoint;
+  std::array<kelvin, loops> measured;
+  std::array<watt, loops> output;
+  for (std::size_t i = 0; i < loops; ++i) {
+    std::construct_at(&setpoint[i], (TU_TYPE)300.0);
+    std::construct_at(&measured[i], (TU_TYPE)290.0 + (TU_TYPE)i * (TU_TYPE)0.1);
+  }
+  audit("Pid_bank update", kernel_budget, [&] {
+    bank.update(std::span<const kelvin, loops>(setpoint), std::span<const kelvin, loops>(measured), std::span<watt, loops>(output));
+  });
+  std::vector<metre> x2(n);
+  std::vector<metre> y2(n);
+  std::vector<metre> z2(n);
+  const Quaternion q = Quaternion::from_euler(radian(0.1f), radian(0.2f), radian(0.3f));
+  audit("rotate", kernel_budget, [&] { rotate(q, Vec3_span<const metre>{x, x, x}, Vec3_span<metre>{x2, y2, z2}); });
+
+  std::vector<Triplet<siemens>> stamps;
+  for (std::size_t i = 0; i < n; ++i) {
+    stamps.push_back({i, i, siemens(4.0f)});
+    if (i + 1 < n) {
+      stamps.push_back({i, i + 1, siemens(-1.0f)});
+      stamps.push_back({i + 1, i, siemens(-1.0f)});
+    }
+  }
+  const Csr_matrix<siemens> g = Csr_matrix<siemens>::from_triplets(n, n, std::span<const Triplet<siemens>>(stamps));
+  std::vector<volt> u(n, volt(1.0f));
+  std::vector<ampere> current(n);
+  audit("Csr_matrix multiply", kernel_budget, [&] { multiply(g, std::span<const volt>(u), std::span<ampere>(current)); });
+  Cg_workspace workspace(n);
+  std::vector<volt> solution(n);
+  audit("conjugate_gradient", kernel_budget, [&] {
+    for (std::size_t i = 0; i < n; ++i) {
+      std::construct_at(&solution[i], (TU_TYPE)0.0);
+    }
+    sink = conjugate_gradient(g, std::span<const ampere>(current), std::span<volt>(solution), Unit<prefix::milli, ampere>(1.0f),
+                              100, workspace).residual.base_value;
+  });
+
+  Grid<kelvin, 2> temperature({64, 16}, 1, kelvin(300.0f));
+  Grid<Quotient_unit<kelvin, metre_squared>, 2> curvature({64, 16}, 0);
+  const auto lap = laplacian<2>(Unit<prefix::centi, metre>(1.0f));
+  audit("Grid fill_halo apply", kernel_budget, [&] {
+    temperature.fill_halo(boundary::zero_gradient);
+    apply(lap, temperature, curvature);
+  });
+
+  audit("trapezoid simpson", kernel_budget, [&] {
+    sink = trapezoid(ts, ps).base_value + simpson(ps, second(0.01f)).base_value;
+  });
+  audit("cumulative_trapezoid", kernel_budget, [&] { cumulative_trapezoid(ts, ps, std::span<joule>(energy)); });
+  audit("derivative", kernel_budget, [&] { derivative(ts, ps, std::span<Quotient_unit<watt, second>>(slope)); });
+  audit("linear_fit", kernel_budget, [&] { sink = linear_fit(ts, ps).slope.base_value; });
+  std::array<Quotient_unit<watt, second>, 4> rates;
+  std::array<watt, 4> offsets;
+  audit("linear_fit batch", kernel_budget, [&] {
+    linear_fit(ts.first(n / 4), ps, std::span<Quotient_unit<watt, second>>(rates), std::span<watt>(offsets));
+  });
+  Least_squares<second, watt> trend;
+  audit("Least_squares add", scalar_budget, [&] { trend.add(second((TU_TYPE)sink), watt(1.0f)); });
+
+  Real_fft fft(n);
+  std::vector<watt> re(fft.bins());
+  std::vector<watt> im(fft.bins());
+  std::vector<Quotient_unit<Power_unit<watt, std::ratio<2>>, hertz>> psd(fft.bins());
+  audit("Real_fft transform", kernel_budget, [&] { fft.transform(ps, Complex_span<watt>{re, im}); });
+  audit("power_spectral_density", kernel_budget, [&] {
+    power_spectral_density(fft, Complex_span<const watt>{re, im}, second(0.01f), std::span<Quotient_unit<Power_unit<watt, std::ratio<2>>, hertz>>(psd));
+  });
+
+  Resampler<watt> resampler(Unit<prefix::kilo, hertz>(12.8f), Unit<prefix::kilo, hertz>(10.0f));
+  std::vector<watt> resampled(resampler.max_output(n));
+  audit("Resampler process", kernel_budget, [&] { sink = (TU_TYPE)resampler.process(ps, std::span<watt>(resampled)); });
+
+  if (failures > 0) {
+    std::printf("%d operations failed the audit\n", failures);
+    return 1;
+  }
+  return 0;
+}
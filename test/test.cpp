@@ -7,6 +7,25 @@
 #include <iostream>
 
 #include "tu/typesafe_units.h"
+#include "tu/complex.h"
+#include "tu/level.h"
+#include "tu/angle.h"
+#include "tu/random.h"
+#include "tu/polynomial.h"
+#include "tu/solver.h"
+#include "tu/spline.h"
+#include "tu/pid.h"
+#include "tu/rotation.h"
+#include "tu/sparse.h"
+#include "tu/grid.h"
+#include "tu/calculus.h"
+#include "tu/regression.h"
+#include "tu/fft.h"
+#include "tu/resample.h"
+#include "tu/shadow.h"
+#include "tu/constrained.h"
+#include "tu/optional.h"
+#include "tu/metrics.h"
 
 #define ESC "\033["
 #define LIGHT_BLUE "\033[106m"
@@ -23,6 +42,11 @@ namespace tu {
   struct degree_Fahrenheit : Non_coherent_unit<(TU_TYPE)(1.0 / 1.8), (TU_TYPE)-32.0, degree_Celsius> {
     using Non_coherent_unit<(TU_TYPE)(1.0 / 1.8), (TU_TYPE)-32.0f, degree_Celsius>::Base;
   };
+
+  // Batch kernels with results in weber use the strict policy in tests.
+  template<> struct Default_policy<weber> {
+    using type = policy::Strict;
+  };
 }
 
 template<typename T = TU_TYPE>
@@ -583,5 +607,1470 @@ int main() {
     
   );
 
+  Test<"Product_unit Quotient_unit Power_unit">(
+    []<typename T>(T) {
+      static_assert(std::is_same_v<Product_unit<ohm, ampere>, volt>);
+      static_assert(std::is_same_v<Product_unit<Unit<prefix::milli, ohm>, ampere>, volt>);
+      static_assert(std::is_same_v<Quotient_unit<metre, second>, metre_per_second>);
+      static_assert(std::is_same_v<Power_unit<metre, std::ratio<2>>, metre_squared>);
+      static_assert(internal::Coherent<volt>);
+      static_assert(!internal::Coherent<minute>);
+    }
+  );
+
+  Test<"Complex">(
+    []<typename T>(T &t) {
+      Complex<ohm> z(Unit<prefix::no_prefix, ohm>(3.0f), Unit<prefix::kilo, ohm>((TU_TYPE)0.004));
+      Complex<ampere> i(Unit<prefix::milli, ampere>(200.0f));
+      Complex<volt> u = z * i;
+      t.template assert<near<>>(u.real().base_value, (TU_TYPE)0.6, __LINE__);
+      t.template assert<near<>>(u.imag().base_value, (TU_TYPE)0.8, __LINE__);
+      t.template assert<near<>>(abs(z).base_value, (TU_TYPE)5.0, __LINE__);
+      t.template assert<near<>>(arg(conj(z)).base_value, -std::atan2((TU_TYPE)4.0, (TU_TYPE)3.0), __LINE__);
+
+      Complex<siemens> y = scalar(1.0f) / z;
+      t.template assert<near<>>(y.real().base_value, (TU_TYPE)0.12, __LINE__);
+      t.template assert<near<>>(y.imag().base_value, (TU_TYPE)-0.16, __LINE__);
+
+      Complex<ampere> i2 = u / z;
+      t.template assert<near<>>(i2.real().base_value, (TU_TYPE)0.2, __LINE__);
+      Complex<volt> u2 = u + z * Unit<prefix::no_prefix, ampere>(1.0f) - u;
+      t.template assert<near<>>(u2.imag().base_value, (TU_TYPE)4.0, __LINE__);
+
+      Complex<volt> p = polar(Unit<prefix::no_prefix, volt>(2.0f), Unit<prefix::no_prefix, degree>(90.0f));
+      t.template assert<near<>>(p.imag().base_value, (TU_TYPE)2.0, __LINE__);
+    }
+  );
+
+  Test<"Complex batch multiply divide">(
+    []<typename T>(T &t) {
+      std::vector<ohm> z_re{ohm(3.0f), ohm(1.0f), ohm(0.0f)};
+      std::vector<ohm> z_im{ohm(4.0f), ohm(-1.0f), ohm(2.0f)};
+      std::vector<ampere> i_re{ampere(0.2f), ampere(2.0f), ampere(1.0f)};
+      std::vector<ampere> i_im{ampere(0.0f), ampere(1.0f), ampere(-1.0f)};
+      std::vector<volt> u_re(3);
+      std::vector<volt> u_im(3);
+      std::vector<ampere> i2_re(3);
+      std::vector<ampere> i2_im(3);
+
+      multiply(Complex_span<const ohm>{z_re, z_im}, Complex_span<const ampere>{i_re, i_im}, Complex_span<volt>{u_re, u_im});
+      divide(Complex_span<const volt>{u_re, u_im}, Complex_span<const ohm>{z_re, z_im}, Complex_span<ampere>{i2_re, i2_im});
+
+      for (std::size_t k = 0; k < u_re.size(); ++k) {
+        Complex<volt> u = Complex<ohm>(z_re[k], z_im[k]) * Complex<ampere>(i_re[k], i_im[k]);
+        t.template assert<near<>>(u_re[k].base_value, u.real().base_value, __LINE__);
+        t.template assert<near<>>(u_im[k].base_value, u.imag().base_value, __LINE__);
+        t.template assert<near<>>(i2_re[k].base_value, i_re[k].base_value, __LINE__);
+        t.template assert<near<>>(i2_im[k].base_value, i_im[k].base_value, __LINE__);
+      }
+    }
+  );
+
+  Test<"Level">(
+    []<typename T>(T &t) {
+      dBm p(Unit<prefix::no_prefix, watt>(1.0f));
+      t.template assert<near<>>(p.value, (TU_TYPE)30.0, __LINE__);
+      dBW pw = p;
+      t.template assert<near<>>(pw.value, (TU_TYPE)0.0, __LINE__);
+
+      dBm p2 = p + Gain(-3.0f);
+      t.template assert<near<>>(p2.linear().base_value, std::pow((TU_TYPE)10.0, (TU_TYPE)-0.3), __LINE__);
+      Gain g = p - p2;
+      t.template assert<near<>>(g.value, (TU_TYPE)3.0, __LINE__);
+      t.template assert<near<>>(Gain::from_neper(g.neper()).value, (TU_TYPE)3.0, __LINE__);
+
+      dBuV u(Unit<prefix::milli, volt>(1.0f));
+      t.template assert<near<>>(u.value, (TU_TYPE)60.0, __LINE__);
+      dBV uv = u;
+      t.template assert<near<>>(uv.value, (TU_TYPE)-60.0, __LINE__);
+      t.assert_true(dBm::from_decibel(10.0f) < p2, __LINE__);
+    }
+  );
+
+  Test<"Level batch conversion">(
+    []<typename T>(T &t) {
+      std::vector<watt> p;
+      for (TU_TYPE v : {(TU_TYPE)1e-12, (TU_TYPE)3.7e-5, (TU_TYPE)0.001, (TU_TYPE)0.5, (TU_TYPE)1.0, (TU_TYPE)2.0, (TU_TYPE)123.4, (TU_TYPE)5e6}) {
+        p.push_back(watt(v));
+      }
+      std::vector<dBm> l(p.size());
+      std::vector<watt> p2(p.size());
+      to_level(std::span<const watt>(p), std::span<dBm>(l));
+      to_linear(std::span<const dBm>(l), std::span<watt>(p2));
+      for (std::size_t i = 0; i < p.size(); ++i) {
+        t.assert_true(std::abs(l[i].value - dBm(p[i]).value) < (TU_TYPE)1e-4, __LINE__);
+        t.assert_true(std::abs(p2[i].base_value / p[i].base_value - (TU_TYPE)1.0) < (TU_TYPE)1e-5, __LINE__);
+      }
+
+      for (TU_TYPE x = (TU_TYPE)-100.0; x < (TU_TYPE)100.0; x += (TU_TYPE)0.37) {
+        t.assert_true(std::abs(internal::fast_exp2(x) / std::exp2(x) - (TU_TYPE)1.0) < 8 * std::numeric_limits<TU_TYPE>::epsilon(), __LINE__);
+        t.assert_true(std::abs(internal::fast_log2(std::exp2(x)) - std::log2(std::exp2(x))) < 8 * std::numeric_limits<TU_TYPE>::epsilon() * std::max(std::abs(x), (TU_TYPE)1.0), __LINE__);
+      }
+    }
+  );
+
+  Test<"Wrapped_angle">(
+    []<typename T>(T &t) {
+      using deg = Unit<prefix::no_prefix, degree>;
+      Wrapped_angle<angle_range::symmetric> heading(deg(350.0f));
+      t.assert_true(std::abs(deg(heading).value - (TU_TYPE)-10.0) < (TU_TYPE)1e-3, __LINE__);
+      Wrapped_angle<angle_range::positive> bearing = heading + deg(20.0f);
+      t.assert_true(std::abs(deg(bearing).value - (TU_TYPE)10.0) < (TU_TYPE)1e-3, __LINE__);
+      t.assert_true(std::abs(deg(bearing - deg(30.0f)).value - (TU_TYPE)340.0) < (TU_TYPE)1e-3, __LINE__);
+      t.assert_true(std::abs(deg(-bearing).value - (TU_TYPE)350.0) < (TU_TYPE)1e-3, __LINE__);
+      t.template assert<near<>>(Wrapped_angle<angle_range::positive>(Unit<prefix::no_prefix, arc_minute>(-60.0f)).base_value, (TU_TYPE)(2.0 * tu::PI) - (TU_TYPE)(tu::PI / 180.0), __LINE__);
+
+      t.template assert<std::equal_to<>>(Wrapped_angle<angle_range::symmetric>(tu::PI).base_value, tu::PI, __LINE__);
+      t.template assert<std::equal_to<>>(Wrapped_angle<angle_range::symmetric>(-tu::PI).base_value, tu::PI, __LINE__);
+      t.template assert<std::equal_to<>>(Wrapped_angle<angle_range::positive>((TU_TYPE)0.0).base_value, (TU_TYPE)0.0, __LINE__);
+      t.assert_true(Wrapped_angle<angle_range::positive>(-std::numeric_limits<TU_TYPE>::denorm_min()).base_value < (TU_TYPE)(2.0 * tu::PI), __LINE__);
+
+      auto d = shortest_difference(deg(10.0f), deg(350.0f));
+      t.assert_true(std::abs(deg(d).value - (TU_TYPE)20.0) < (TU_TYPE)1e-3, __LINE__);
+      t.assert_true(std::abs(deg(shortest_difference(deg(350.0f), deg(10.0f))).value - (TU_TYPE)-20.0) < (TU_TYPE)1e-3, __LINE__);
+
+      // Angles in (-pi, pi] are not changed by the symmetric range, so small
+      // differences stay exact.
+      for (const TU_TYPE x : {(TU_TYPE)0.0, (TU_TYPE)1e-6, (TU_TYPE)-1e-6, (TU_TYPE)3.0, (TU_TYPE)-3.0}) {
+        const TU_TYPE w = Wrapped_angle<angle_range::symmetric>(x).base_value;
+        t.assert_true(w == x && std::signbit(w) == std::signbit(x), __LINE__);
+      }
+      // Angles in their own unit wrap by whole turns of that unit exactly.
+      using arcsec = Unit<prefix::no_prefix, arc_second>;
+      t.template assert<std::equal_to<>>(wrap<angle_range::positive>(arcsec(2.0f * 1296000.0f + 1.0f)).value, (TU_TYPE)1.0, __LINE__);
+      t.template assert<std::equal_to<>>(wrap<angle_range::symmetric>(Unit<prefix::no_prefix, arc_minute>(-21599.0f)).value, (TU_TYPE)1.0, __LINE__);
+      t.template assert<std::equal_to<>>(wrap<angle_range::positive>(deg(-0.25f)).value, (TU_TYPE)359.75, __LINE__);
+      t.template assert<std::equal_to<>>(wrap<angle_range::symmetric>(deg(-180.0f)).value, (TU_TYPE)180.0, __LINE__);
+      t.template assert<std::equal_to<>>(wrap<angle_range::symmetric>(deg(3.0f * 360.0f + 0.5f)).value, (TU_TYPE)0.5, __LINE__);
+      t.assert_true(std::abs(wrap<angle_range::positive>(Unit<prefix::milli, radian>(7000.0f)).value - (TU_TYPE)(7000.0 - 2000.0 * tu::PI)) < (TU_TYPE)1e-2, __LINE__);
+
+      const TU_TYPE a = std::nextafter((TU_TYPE)1.0, (TU_TYPE)2.0);
+      t.template assert<std::equal_to<>>(shortest_difference(radian(a), radian(1.0f)).base_value, a - (TU_TYPE)1.0, __LINE__);
+      t.template assert<std::equal_to<>>(shortest_difference(radian(1.0f), radian(a)).base_value, (TU_TYPE)1.0 - a, __LINE__);
+    }
+  );
+
+  Test<"Wrapped_angle batch">(
+    []<typename T>(T &t) {
+      std::vector<radian> in;
+      for (TU_TYPE x = (TU_TYPE)-20.0; x < (TU_TYPE)20.0; x += (TU_TYPE)0.1) {
+        in.push_back(radian(x));
+      }
+      std::vector<Wrapped_angle<angle_range::positive>> positive(in.size());
+      std::vector<Wrapped_angle<angle_range::symmetric>> symmetric(in.size());
+      std::vector<Wrapped_angle<angle_range::symmetric>> difference(in.size());
+      wrap(std::span<const radian>(in), std::span<Wrapped_angle<angle_range::positive>>(positive));
+      wrap(std::span<const radian>(in), std::span<Wrapped_angle<angle_range::symmetric>>(symmetric));
+      shortest_difference(std::span<const radian>(in), std::span<const Wrapped_angle<angle_range::positive>>(positive), std::span<Wrapped_angle<angle_range::symmetric>>(difference));
+      for (std::size_t i = 0; i < in.size(); ++i) {
+        t.assert_true(positive[i].base_value >= (TU_TYPE)0.0 && positive[i].base_value < (TU_TYPE)(2.0 * tu::PI), __LINE__);
+        t.assert_true(symmetric[i].base_value > -tu::PI && symmetric[i].base_value <= tu::PI, __LINE__);
+        t.assert_true(std::abs(std::sin(positive[i].base_value) - std::sin(in[i].base_value)) < (TU_TYPE)1e-5, __LINE__);
+        t.assert_true(std::abs(std::cos(symmetric[i].base_value) - std::cos(in[i].base_value)) < (TU_TYPE)1e-5, __LINE__);
+        t.assert_true(std::abs(difference[i].base_value) < (TU_TYPE)1e-5, __LINE__);
+      }
+    }
+  );
+
+  Test<"fast_sin">(
+    []<typename T>(T &t) {
+      for (TU_TYPE x = -tu::PI; x <= tu::PI; x += (TU_TYPE)0.01) {
+        t.assert_true(std::abs(internal::fast_sin(x) - std::sin(x)) < 4 * std::numeric_limits<TU_TYPE>::epsilon(), __LINE__);
+      }
+    }
+  );
+
+  Test<"philox4x32">(
+    []<typename T>(T &t) {
+      // Known answer test from the Random123 distribution.
+      auto r = internal::philox4x32({0, 0, 0, 0}, {0, 0});
+      t.assert_true(r[0] == 0x6627e8d5 && r[1] == 0xe169c58d && r[2] == 0xbc57ac4c && r[3] == 0x9b00dbd8, __LINE__);
+      auto r2 = internal::philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0});
+      t.assert_true(r2[0] == 0xd16cfe09 && r2[1] == 0x94fdcceb && r2[2] == 0x5001e420 && r2[3] == 0x24126ea1, __LINE__);
+    }
+  );
+
+  Test<"random distributions">(
+    []<typename T>(T &t) {
+      constexpr std::size_t n = 100000;
+      std::vector<metre> x(n);
+      Random_stream stream(2024, 7);
+      generate(Normal_distribution<metre>{Unit<prefix::milli, metre>(5.0f), Unit<prefix::milli, metre>(2.0f)}, stream, std::span<metre>(x));
+      double mean = 0.0;
+      double var = 0.0;
+      for (const auto& v : x) { mean += v.base_value; }
+      mean /= n;
+      for (const auto& v : x) { var += (v.base_value - mean) * (v.base_value - mean); }
+      var /= n;
+      t.assert_true(std::abs(mean - 5.0e-3) < 5.0e-5, __LINE__);
+      t.assert_true(std::abs(std::sqrt(var) - 2.0e-3) < 5.0e-5, __LINE__);
+
+      std::vector<second> s(n);
+      generate(Exponential_distribution<second>{Unit<prefix::kilo, hertz>(2.0f)}, stream, std::span<second>(s));
+      mean = 0.0;
+      for (const auto& v : s) { mean += v.base_value; t.assert_true(v.base_value >= (TU_TYPE)0.0, __LINE__); }
+      t.assert_true(std::abs(mean / n - 0.5e-3) < 1.0e-5, __LINE__);
+
+      std::vector<radian> a(n);
+      generate(Uniform_distribution<radian>{Unit<prefix::no_prefix, degree>(-90.0f), Unit<prefix::no_prefix, degree>(90.0f)}, stream, std::span<radian>(a));
+      mean = 0.0;
+      for (const auto& v : a) { mean += v.base_value; t.assert_true(std::abs(v.base_value) <= tu::PI / (TU_TYPE)2.0, __LINE__); }
+      t.assert_true(std::abs(mean / n) < 1.0e-2, __LINE__);
+      t.assert_true(stream.counter == 3 * n, __LINE__);
+    }
+  );
+
+  Test<"random reproducible streams">(
+    []<typename T>(T &t) {
+      Normal_distribution<metre> d{metre(1.0f), metre(0.5f)};
+      std::vector<metre> whole(1000);
+      Random_stream stream(1, 3);
+      generate(d, stream, std::span<metre>(whole));
+
+      std::vector<metre> parts(1000);
+      Random_stream first(1, 3);
+      Random_stream second_half(1, 3);
+      second_half.discard(400);
+      generate(d, first, std::span<metre>(parts).first(400));
+      generate(d, second_half, std::span<metre>(parts).subspan(400));
+      t.assert_true(std::equal(whole.begin(), whole.end(), parts.begin()), __LINE__);
+
+      Random_stream again(1, 3);
+      t.assert_true(draw(d, again) == whole[0], __LINE__);
+      t.assert_true(draw(d, again) == whole[1], __LINE__);
+      Random_stream other(1, 4);
+      t.assert_false(draw(d, other) == whole[0], __LINE__);
+    }
+  );
+
+  Test<"Polynomial">(
+    []<typename T>(T &t) {
+      Polynomial<second, metre, 3> s(Unit<prefix::no_prefix, metre>(1.0f),
+                                     Unit<prefix::no_prefix, metre_per_second>(2.0f),
+                                     Quotient_unit<metre, second_squared>(0.5f));
+      metre m = s(Unit<prefix::milli, second>(2000.0f));
+      t.template assert<near<>>(m.base_value, (TU_TYPE)7.0, __LINE__);
+      t.template assert<near<>>(s.coefficient<2>().base_value, (TU_TYPE)0.5, __LINE__);
+
+      Polynomial<Unit<prefix::milli, second>, Unit<prefix::kilo, metre>, 2> s2(metre(1000.0f), metre_per_second(2000.0f));
+      t.template assert<near<>>(s2.values[1], (TU_TYPE)0.002, __LINE__);
+      t.template assert<near<>>(s2(Unit<prefix::no_prefix, second>(1.0f)).value, (TU_TYPE)3.0, __LINE__);
+      t.template assert<near<>>(s2.coefficient<1>().base_value, (TU_TYPE)2000.0, __LINE__);
+
+      static_assert(std::is_constructible_v<Polynomial<second, metre, 2>, metre, metre_per_second>);
+      static_assert(!std::is_constructible_v<Polynomial<second, metre, 2>, metre, metre>);
+      static_assert(!std::is_constructible_v<Polynomial<second, metre, 2>, metre>);
+      static_assert(std::is_same_v<decltype(s.coefficient<2>()), Quotient_unit<metre, second_squared>>);
+
+      // NIST type K thermocouple, 0 to 500 degree Celsius, coefficients in degree Celsius per microvolt^i.
+      using Type_K = Polynomial<Unit<prefix::micro, volt>, Unit<prefix::no_prefix, degree_Celsius>, 10>;
+      constexpr Type_K type_k = Type_K::from_values({(TU_TYPE)0.0, (TU_TYPE)2.508355e-2, (TU_TYPE)7.860106e-8, (TU_TYPE)-2.503131e-10,
+                                                     (TU_TYPE)8.315270e-14, (TU_TYPE)-1.228034e-17, (TU_TYPE)9.804036e-22,
+                                                     (TU_TYPE)-4.413030e-26, (TU_TYPE)1.057734e-30, (TU_TYPE)-1.052755e-35});
+      static_assert(type_k.values[1] == (TU_TYPE)2.508355e-2);
+      Unit<prefix::no_prefix, degree_Celsius> c = type_k(Unit<prefix::milli, volt>(20.644f));
+      t.assert_true(std::abs(c.value - (TU_TYPE)500.0) < (TU_TYPE)0.1, __LINE__);
+      t.assert_true(std::abs(c.base_value - (TU_TYPE)773.15) < (TU_TYPE)0.1, __LINE__);
+
+      Rational_function<second, metre, 2, 2> r{Polynomial<second, metre, 2>(metre(2.0f), metre_per_second(0.0f)),
+                                              Polynomial<second, scalar, 2>(scalar(1.0f), hertz(1.0f))};
+      t.template assert<near<>>(r(second(3.0f)).base_value, (TU_TYPE)0.5, __LINE__);
+    }
+  );
+
+  Test<"Polynomial batch">(
+    []<typename T>(T &t) {
+      Polynomial<Unit<prefix::milli, second>, metre, 4> p = Polynomial<Unit<prefix::milli, second>, metre, 4>::from_values({(TU_TYPE)1.0, (TU_TYPE)-0.5, (TU_TYPE)0.25, (TU_TYPE)0.125});
+      std::vector<Unit<prefix::milli, second>> x;
+      for (int i = 0; i < 37; ++i) {
+        x.push_back(Unit<prefix::milli, second>((TU_TYPE)i * (TU_TYPE)0.1 - (TU_TYPE)1.5));
+      }
+      std::vector<metre> y(x.size());
+      evaluate(p, std::span<const Unit<prefix::milli, second>>(x), std::span<metre>(y));
+      for (std::size_t i = 0; i < x.size(); ++i) {
+        TU_TYPE v = x[i].value;
+        t.template assert<near<>>(y[i].base_value, (TU_TYPE)1.0 - (TU_TYPE)0.5 * v + (TU_TYPE)0.25 * v * v + (TU_TYPE)0.125 * v * v * v, __LINE__);
+        t.template assert<near<>>(y[i].base_value, p(x[i]).base_value, __LINE__);
+      }
+
+      Rational_function<Unit<prefix::milli, second>, metre, 4, 1> r{p, Polynomial<Unit<prefix::milli, second>, scalar, 1>(scalar(2.0f))};
+      evaluate(r, std::span<const Unit<prefix::milli, second>>(x), std::span<metre>(y));
+      t.template assert<near<>>(y[3].base_value, p(x[3]).base_value / (TU_TYPE)2.0, __LINE__);
+    }
+  );
+
+  Test<"root finding">(
+    []<typename T>(T &t) {
+      using J_per_kg = Quotient_unit<joule, kilogram>;
+      Quotient_unit<J_per_kg, kelvin> cp(1000.0f);
+      Quotient_unit<Quotient_unit<J_per_kg, kelvin>, kelvin> b(0.5f);
+      J_per_kg target(345000.0f);
+      auto h = [&](kelvin temperature) { return cp * temperature + b * temperature * temperature - target; };
+      auto dh = [&](kelvin temperature) { return cp + b * temperature + b * temperature; };
+      // 0.5 T^2 + 1000 T - 345000 = 0 has the root T = 300 K.
+      Root<kelvin> n = newton_raphson(h, dh, Unit<prefix::no_prefix, degree_Celsius>(0.0f), Unit<prefix::milli, kelvin>(1.0f), J_per_kg(1.0e-3f));
+      t.assert_true(n.converged, __LINE__);
+      t.assert_true(std::abs(n.x.base_value - (TU_TYPE)300.0) < (TU_TYPE)1.0e-3, __LINE__);
+      t.assert_true(n.iterations < 10, __LINE__);
+
+      Root<kelvin> r = brent(h, kelvin(0.0f), kelvin(1000.0f), Unit<prefix::milli, kelvin>(1.0f), J_per_kg(1.0e-3f));
+      t.assert_true(r.converged, __LINE__);
+      t.assert_true(std::abs(r.x.base_value - (TU_TYPE)300.0) < (TU_TYPE)1.0e-3, __LINE__);
+      t.assert_true(r.iterations < 20, __LINE__);
+
+      Root<kelvin> s = bisection(h, kelvin(0.0f), kelvin(1000.0f), Unit<prefix::milli, kelvin>(1.0f), J_per_kg(1.0e-3f));
+      t.assert_true(s.converged, __LINE__);
+      t.assert_true(std::abs(s.x.base_value - (TU_TYPE)300.0) < (TU_TYPE)1.0e-3, __LINE__);
+
+      t.assert_false(brent(h, kelvin(400.0f), kelvin(1000.0f), kelvin(1.0f), J_per_kg(1.0f)).converged, __LINE__);
+      t.assert_false(bisection(h, kelvin(400.0f), kelvin(1000.0f), kelvin(1.0f), J_per_kg(1.0f)).converged, __LINE__);
+      // h(300 K) is exactly 0, so the bracket has no sign change but an end is a root.
+      Root<kelvin> end = bisection(h, kelvin(300.0f), kelvin(1000.0f), kelvin(1.0f), J_per_kg(1.0e-3f));
+      t.assert_true(end.converged && end.x.base_value == (TU_TYPE)300.0 && end.iterations == 0, __LINE__);
+      t.assert_true(bisection(h, kelvin(0.0f), kelvin(300.0f), kelvin(1.0f), J_per_kg(1.0e-3f)).x.base_value == (TU_TYPE)300.0, __LINE__);
+      t.assert_false(newton_raphson(h, dh, kelvin(0.0f), kelvin(1.0e-9f), J_per_kg(1.0e-9f), 1).converged, __LINE__);
+
+      // Minimum of the potential energy of a spring loaded by a weight, at x = m g / k.
+      auto energy = [](metre x) { return Quotient_unit<newton, metre>(100.0f) * x * x / scalar(2.0f) - newton(10.0f) * x; };
+      Minimum<metre, joule> m = minimize(energy, Unit<prefix::centi, metre>(0.0f), metre(1.0f), Unit<prefix::micro, metre>(1.0f));
+      t.assert_true(m.converged, __LINE__);
+      t.assert_true(std::abs(m.x.base_value - (TU_TYPE)0.1) < (TU_TYPE)1.0e-4, __LINE__);
+      t.assert_true(std::abs(m.value.base_value + (TU_TYPE)0.5) < (TU_TYPE)1.0e-4, __LINE__);
+
+      auto solve = [](auto f, auto df, auto x_tolerance) -> decltype(newton_raphson(f, df, kelvin(1.0f), x_tolerance, J_per_kg(1.0f))) {
+        return newton_raphson(f, df, kelvin(1.0f), x_tolerance, J_per_kg(1.0f));
+      };
+      auto wrong = [&](kelvin temperature) { return cp * temperature; };
+      static_assert(std::is_invocable_v<decltype(solve), decltype(h), decltype(dh), kelvin>);
+      static_assert(!std::is_invocable_v<decltype(solve), decltype(h), decltype(wrong), kelvin>);
+      static_assert(!std::is_invocable_v<decltype(solve), decltype(h), decltype(dh), metre>);
+    }
+  );
+
+  Test<"root finding batch">(
+    []<typename T>(T &t) {
+      using J_per_kg = Quotient_unit<joule, kilogram>;
+      Quotient_unit<J_per_kg, kelvin> cp(1000.0f);
+      Quotient_unit<Quotient_unit<J_per_kg, kelvin>, kelvin> b(0.5f);
+      std::vector<J_per_kg> target;
+      for (int i = 0; i < 1001; ++i) {
+        const TU_TYPE v = (TU_TYPE)200.0 + (TU_TYPE)i * (TU_TYPE)0.3;
+        target.push_back(J_per_kg((TU_TYPE)1000.0 * v + (TU_TYPE)0.5 * v * v));
+      }
+      auto h = [&](std::size_t i, kelvin temperature) { return cp * temperature + b * temperature * temperature - target[i]; };
+      auto dh = [&](std::size_t, kelvin temperature) { return cp + b * temperature + b * temperature; };
+      std::vector<kelvin> x(target.size(), kelvin(250.0f));
+      t.assert_true(newton_raphson(h, dh, std::span<kelvin>(x), Unit<prefix::milli, kelvin>(1.0f), J_per_kg(1.0e-3f)) == 0, __LINE__);
+      for (std::size_t i = 0; i < x.size(); ++i) {
+        t.assert_true(std::abs(x[i].base_value - ((TU_TYPE)200.0 + (TU_TYPE)i * (TU_TYPE)0.3)) < (TU_TYPE)1.0e-2, __LINE__);
+      }
+
+      // No real roots for negative targets below the minimum of h.
+      std::vector<J_per_kg> unreachable(target);
+      std::construct_at(&unreachable[7], -1.0e9f);
+      target.swap(unreachable);
+      std::vector<kelvin> y(target.size(), kelvin(250.0f));
+      t.assert_true(newton_raphson(h, dh, std::span<kelvin>(y), Unit<prefix::milli, kelvin>(1.0f), J_per_kg(1.0e-3f), 20) == 1, __LINE__);
+
+      // A problem with a zero derivative keeps its estimate and does not converge.
+      target.swap(unreachable);
+      auto flat = [&](std::size_t i, kelvin temperature) {
+        return i == 3 ? Quotient_unit<J_per_kg, kelvin>(0.0f) : dh(i, temperature);
+      };
+      std::vector<kelvin> z(target.size(), kelvin(250.0f));
+      t.assert_true(newton_raphson(h, flat, std::span<kelvin>(z), Unit<prefix::milli, kelvin>(1.0f), J_per_kg(1.0e-3f), 20) == 1, __LINE__);
+      t.template assert<std::equal_to<>>(z[3].base_value, (TU_TYPE)250.0, __LINE__);
+      t.assert_true(std::abs(z[4].base_value - ((TU_TYPE)200.0 + (TU_TYPE)4 * (TU_TYPE)0.3)) < (TU_TYPE)1.0e-2, __LINE__);
+    }
+  );
+
+  Test<"Spline">(
+    []<typename T>(T &t) {
+      std::vector<second> x{second(0.0f), second(0.5f), second(2.0f), second(3.0f), second(4.5f)};
+      std::vector<metre> y;
+      for (const second& s : x) {
+        y.push_back(metre((TU_TYPE)2.0 * s.base_value + (TU_TYPE)1.0));
+      }
+      // All kinds reproduce linear data.
+      for (spline_kind kind : {spline_kind::natural, spline_kind::akima, spline_kind::pchip}) {
+        Spline s(kind, std::span<const second>(x), std::span<const metre>(y));
+        t.template assert<near<>>(s(Unit<prefix::milli, second>(1250.0f)).base_value, (TU_TYPE)3.5, __LINE__);
+        t.template assert<near<>>(s.derivative(second(4.0f)).base_value, (TU_TYPE)2.0, __LINE__);
+        t.template assert<near<>>(s.integral(second(0.0f), Unit<prefix::no_prefix, minute>(0.05f)).base_value, (TU_TYPE)12.0, __LINE__);
+        t.template assert<near<>>(s.integral(second(4.0f), second(1.0f)).base_value, (TU_TYPE)-18.0, __LINE__);
+        t.template assert<near<>>(s(second(5.0f)).base_value, (TU_TYPE)11.0, __LINE__);
+        static_assert(std::is_same_v<decltype(s.derivative(second(0.0f))), metre_per_second>);
+        static_assert(std::is_same_v<decltype(s.integral(second(0.0f), second(1.0f))), Product_unit<metre, second>>);
+      }
+
+      // Natural spline through (0, 0), (1, 1), (2, 0) has the second derivative -3 at 1.
+      constexpr std::array<second, 3> x3{second(0.0f), second(1.0f), second(2.0f)};
+      constexpr std::array<metre, 3> y3{metre(0.0f), metre(1.0f), metre(0.0f)};
+      constexpr Spline natural(spline_kind::natural, x3, y3);
+      static_assert(natural.size() == 3);
+      static_assert(natural(second(1.0f)).base_value == (TU_TYPE)1.0);
+      t.template assert<near<>>(natural(second(0.5f)).base_value, (TU_TYPE)0.6875, __LINE__);
+      t.template assert<near<>>(natural.derivative(second(0.0f)).base_value, (TU_TYPE)1.5, __LINE__);
+
+      // Monotone data. PCHIP stays monotone and within the data where the
+      // natural spline overshoots.
+      constexpr std::array<second, 5> x5{second(0.0f), second(1.0f), second(2.0f), second(3.0f), second(4.0f)};
+      constexpr std::array<metre, 5> y5{metre(0.0f), metre(0.0f), metre(1.0f), metre(1.0f), metre(1.0f)};
+      constexpr Spline pchip(spline_kind::pchip, x5, y5);
+      constexpr Spline natural5(spline_kind::natural, x5, y5);
+      constexpr Spline akima(spline_kind::akima, x5, y5);
+      bool monotone = true;
+      bool overshoot = false;
+      TU_TYPE previous = (TU_TYPE)0.0;
+      for (int i = 0; i <= 400; ++i) {
+        const second s((TU_TYPE)i * (TU_TYPE)0.01);
+        const TU_TYPE v = pchip(s).base_value;
+        monotone = monotone && v >= previous && v <= (TU_TYPE)1.0;
+        previous = v;
+        overshoot = overshoot || natural5(s).base_value < (TU_TYPE)0.0;
+      }
+      t.assert_true(monotone, __LINE__);
+      t.assert_true(overshoot, __LINE__);
+      for (std::size_t i = 0; i < x5.size(); ++i) {
+        t.template assert<near<>>(pchip(x5[i]).base_value, y5[i].base_value, __LINE__);
+        t.template assert<near<>>(akima(x5[i]).base_value, y5[i].base_value, __LINE__);
+        t.template assert<near<>>(natural5(x5[i]).base_value, y5[i].base_value, __LINE__);
+      }
+      t.template assert<near<>>(pchip.derivative(second(3.0f)).base_value, (TU_TYPE)0.0, __LINE__);
+      // Akima keeps the flat part flat.
+      t.template assert<near<>>(akima(second(2.5f)).base_value, (TU_TYPE)1.0, __LINE__);
+      t.template assert<near<>>(akima.derivative(second(3.5f)).base_value, (TU_TYPE)0.0, __LINE__);
+    }
+  );
+
+  Test<"Spline batch">(
+    []<typename T>(T &t) {
+      std::vector<second> x;
+      std::vector<kelvin> y;
+      for (int i = 0; i < 50; ++i) {
+        x.push_back(second((TU_TYPE)i * (TU_TYPE)0.7 + (TU_TYPE)(i % 3) * (TU_TYPE)0.2));
+        y.push_back(kelvin((TU_TYPE)300.0 + (TU_TYPE)10.0 * std::sin((TU_TYPE)i * (TU_TYPE)0.3)));
+      }
+      Spline s(spline_kind::akima, std::span<const second>(x), std::span<const kelvin>(y));
+      std::vector<Unit<prefix::milli, second>> grid;
+      for (int i = 0; i < 300; ++i) {
+        grid.push_back(Unit<prefix::milli, second>((TU_TYPE)i * (TU_TYPE)125.0 - (TU_TYPE)500.0));
+      }
+      std::vector<kelvin> out(grid.size());
+      evaluate(s, std::span<const Unit<prefix::milli, second>>(grid), std::span<kelvin>(out));
+      for (std::size_t i = 0; i < grid.size(); ++i) {
+        t.template assert<near<>>(out[i].base_value, s(grid[i]).base_value, __LINE__);
+      }
+    }
+  );
+
+  Test<"Pid">(
+    []<typename T>(T &t) {
+      Pid_parameters<kelvin, watt> p{.kp = Quotient_unit<watt, kelvin>(2.0f),
+                                     .ki = Quotient_unit<watt, Product_unit<kelvin, second>>(0.0f),
+                                     .kd = Quotient_unit<Product_unit<watt, second>, kelvin>(0.0f),
+                                     .derivative_filter = second(0.0f),
+                                     .tracking = second(1.0f),
+                                     .lower = watt(-100.0f),
+                                     .upper = Unit<prefix::kilo, watt>(0.1f)};
+      Pid<kelvin, watt> proportional(p, Unit<prefix::milli, second>(500.0f));
+      proportional.reset(kelvin(10.0f), kelvin(7.0f));
+      t.template assert<near<>>(proportional.update(kelvin(10.0f), kelvin(7.0f)).base_value, (TU_TYPE)6.0, __LINE__);
+      t.assert_true(std::abs(proportional.update(Unit<prefix::no_prefix, degree_Celsius>(0.0f), kelvin(273.65f)).base_value + (TU_TYPE)1.0) < (TU_TYPE)1.0e-3, __LINE__);
+      t.template assert<near<>>(proportional.update(kelvin(100.0f), kelvin(0.0f)).base_value, (TU_TYPE)100.0, __LINE__);
+
+      // The integral grows by ki dt e per update.
+      Pid_parameters<kelvin, watt> pi = p;
+      std::construct_at(&pi.kp, 0.0f);
+      std::construct_at(&pi.ki, 1.0f);
+      Pid<kelvin, watt> integrating(pi, second(0.5f));
+      integrating.reset(kelvin(2.0f), kelvin(0.0f));
+      t.template assert<near<>>(integrating.update(kelvin(2.0f), kelvin(0.0f)).base_value, (TU_TYPE)0.0, __LINE__);
+      t.template assert<near<>>(integrating.update(kelvin(2.0f), kelvin(0.0f)).base_value, (TU_TYPE)1.0, __LINE__);
+      t.template assert<near<>>(integrating.update(kelvin(2.0f), kelvin(0.0f)).base_value, (TU_TYPE)2.0, __LINE__);
+
+      // Anti-windup keeps the integral bounded while the output saturates so
+      // the output leaves the limit soon after the error changes sign.
+      std::construct_at(&pi.upper, 5.0f);
+      std::construct_at(&pi.tracking, 0.5f);
+      Pid<kelvin, watt> limited(pi, second(0.5f));
+      limited.reset(kelvin(2.0f), kelvin(0.0f));
+      for (int i = 0; i < 1000; ++i) {
+        t.assert_true(limited.update(kelvin(2.0f), kelvin(0.0f)).base_value <= (TU_TYPE)5.0, __LINE__);
+      }
+      // The integral settles at upper + ki e tracking = 6 W.
+      t.template assert<near<>>(limited.update(kelvin(0.0f), kelvin(2.0f)).base_value, (TU_TYPE)5.0, __LINE__);
+      t.template assert<near<>>(limited.update(kelvin(0.0f), kelvin(2.0f)).base_value, (TU_TYPE)4.0, __LINE__);
+
+      // PI-D has no derivative kick on setpoint steps but PID has.
+      Pid_parameters<kelvin, watt> d = p;
+      std::construct_at(&d.kp, 0.0f);
+      std::construct_at(&d.kd, 1.0f);
+      Pid<kelvin, watt> pi_d(d, Unit<prefix::milli, second>(100.0f));
+      Pid<kelvin, watt, pid_form::pid> full(d, Unit<prefix::milli, second>(100.0f));
+      pi_d.reset(kelvin(0.0f), kelvin(0.0f));
+      full.reset(kelvin(0.0f), kelvin(0.0f));
+      t.template assert<near<>>(pi_d.update(kelvin(1.0f), kelvin(0.0f)).base_value, (TU_TYPE)0.0, __LINE__);
+      t.template assert<near<>>(full.update(kelvin(1.0f), kelvin(0.0f)).base_value, (TU_TYPE)10.0, __LINE__);
+      // A measurement ramp of 10 K/s gives -kd 10 K/s.
+      t.template assert<near<>>(pi_d.update(kelvin(1.0f), kelvin(1.0f)).base_value, (TU_TYPE)-10.0, __LINE__);
+
+      // The filter spreads the derivative over time.
+      std::construct_at(&d.derivative_filter, 0.1f);
+      Pid<kelvin, watt> filtered(d, Unit<prefix::milli, second>(100.0f));
+      filtered.reset(kelvin(0.0f), kelvin(0.0f));
+      t.template assert<near<>>(filtered.update(kelvin(0.0f), kelvin(1.0f)).base_value, (TU_TYPE)-5.0, __LINE__);
+      t.template assert<near<>>(filtered.update(kelvin(0.0f), kelvin(1.0f)).base_value, (TU_TYPE)-2.5, __LINE__);
+
+      static_assert(std::is_same_v<decltype(p.ki), Quotient_unit<watt, Product_unit<kelvin, second>>>);
+      static_assert(!std::is_constructible_v<Pid<kelvin, watt>, Pid_parameters<kelvin, watt>, metre>);
+    }
+  );
+
+  Test<"Pid bank">(
+    []<typename T>(T &t) {
+      constexpr std::size_t n = 19;
+      Pid_parameters<radian, Product_unit<newton, metre>> p{.kp = Quotient_unit<Product_unit<newton, metre>, radian>(20.0f),
+                                                           .ki = Quotient_unit<Product_unit<newton, metre>, Product_unit<radian, second>>(4.0f),
+                                                           .kd = Quotient_unit<Product_unit<Product_unit<newton, metre>, second>, radian>(0.5f),
+                                                           .derivative_filter = Unit<prefix::milli, second>(1.0f),
+                                                           .tracking = Unit<prefix::milli, second>(10.0f),
+                                                           .lower = Product_unit<newton, metre>(-3.0f),
+                                                           .upper = Product_unit<newton, metre>(3.0f)};
+      Pid_bank<radian, Product_unit<newton, metre>, n> bank(p, Unit<prefix::micro, second>(50.0f));
+      std::vector<Pid<radian, Product_unit<newton, metre>>> single(n, Pid<radian, Product_unit<newton, metre>>(p, Unit<prefix::micro, second>(50.0f)));
+      Pid_parameters<radian, Product_unit<newton, metre>> q = p;
+      std::construct_at(&q.kp, 5.0f);
+      bank.configure(3, q);
+      single[3] = Pid<radian, Product_unit<newton, metre>>(q, Unit<prefix::micro, second>(50.0f));
+
+      std::array<radian, n> target;
+      std::array<radian, n> angle;
+      std::array<Product_unit<newton, metre>, n> torque;
+      for (std::size_t i = 0; i < n; ++i) {
+        std::construct_at(&target[i], (TU_TYPE)i * (TU_TYPE)0.1);
+        std::construct_at(&angle[i], (TU_TYPE)0.0);
+        single[i].reset(target[i], angle[i]);
+      }
+      bank.reset(std::span<const radian, n>(target), std::span<const radian, n>(angle));
+      for (int step = 0; step < 100; ++step) {
+        bank.update(std::span<const radian, n>(target), std::span<const radian, n>(angle), std::span<Product_unit<newton, metre>, n>(torque));
+        for (std::size_t i = 0; i < n; ++i) {
+          t.template assert<near<>>(torque[i].base_value, single[i].update(target[i], angle[i]).base_value, __LINE__);
+          // Simple plant.
+          std::construct_at(&angle[i], angle[i].base_value + torque[i].base_value * (TU_TYPE)1.0e-3);
+        }
+      }
+    }
+  );
+
+  Test<"Quaternion Rotation_matrix">(
+    []<typename T>(T &t) {
+      auto close = [](TU_TYPE a, TU_TYPE b) { return std::abs(a - b) < (TU_TYPE)1.0e-5; };
+      const Vec3<scalar> z_axis{scalar(0.0f), scalar(0.0f), scalar(2.0f)};
+      const Quaternion q = Quaternion::from_axis_angle(z_axis, Unit<prefix::no_prefix, degree>(90.0f));
+      const Vec3<metre> r = q.rotate(Vec3<metre>{metre(1.0f), metre(0.0f), Unit<prefix::milli, metre>(500.0f)});
+      static_assert(std::is_same_v<decltype(r), const Vec3<metre>>);
+      t.assert_true(close(r.x.base_value, (TU_TYPE)0.0) && close(r.y.base_value, (TU_TYPE)1.0) && close(r.z.base_value, (TU_TYPE)0.5), __LINE__);
+      const Quaternion none = Quaternion::from_axis_angle(Vec3<metre>{metre(0.0f), metre(0.0f), metre(0.0f)}, radian(1.0f));
+      t.assert_true(none.w == (TU_TYPE)1.0 && none.x == (TU_TYPE)0.0 && none.y == (TU_TYPE)0.0 && none.z == (TU_TYPE)0.0, __LINE__);
+      t.assert_true(close(q.angle().base_value, std::numbers::pi_v<TU_TYPE> / (TU_TYPE)2.0), __LINE__);
+      t.assert_true(close(Unit<prefix::no_prefix, degree>(q.angle()).value, (TU_TYPE)90.0), __LINE__);
+
+      const Rotation_matrix m = Rotation_matrix::about_z(radian(std::numbers::pi_v<TU_TYPE> / (TU_TYPE)2.0));
+      const Rotation_matrix mq(q);
+      for (std::size_t i = 0; i < 9; ++i) {
+        t.assert_true(close(m.m[i], mq.m[i]), __LINE__);
+      }
+      const Vec3<metre_per_second> v{metre_per_second(1.0f), metre_per_second(2.0f), metre_per_second(3.0f)};
+      const Vec3<metre_per_second> back = m.transpose().rotate(m.rotate(v));
+      t.assert_true(close(back.x.base_value, (TU_TYPE)1.0) && close(back.y.base_value, (TU_TYPE)2.0) && close(back.z.base_value, (TU_TYPE)3.0), __LINE__);
+
+      // Euler angles compose as yaw, pitch and roll.
+      const Quaternion e = Quaternion::from_euler(Unit<prefix::no_prefix, degree>(10.0f), radian(0.2f), Unit<prefix::no_prefix, degree>(-30.0f));
+      const Rotation_matrix me = Rotation_matrix::about_z(Unit<prefix::no_prefix, degree>(-30.0f)) * Rotation_matrix::about_y(radian(0.2f)) * Rotation_matrix::about_x(Unit<prefix::no_prefix, degree>(10.0f));
+      const Vec3<metre_per_second> a = e.rotate(v);
+      const Vec3<metre_per_second> b = me.rotate(v);
+      t.assert_true(close(a.x.base_value, b.x.base_value) && close(a.y.base_value, b.y.base_value) && close(a.z.base_value, b.z.base_value), __LINE__);
+      const Vec3<metre_per_second> c = (e * q).rotate(v);
+      const Vec3<metre_per_second> d = e.rotate(q.rotate(v));
+      t.assert_true(close(c.x.base_value, d.x.base_value) && close(c.y.base_value, d.y.base_value) && close(c.z.base_value, d.z.base_value), __LINE__);
+      const Vec3<metre_per_second> f = e.conjugate().rotate(a);
+      t.assert_true(close(f.x.base_value, (TU_TYPE)1.0) && close(f.y.base_value, (TU_TYPE)2.0) && close(f.z.base_value, (TU_TYPE)3.0), __LINE__);
+
+      // A quarter turn about x at 90 degrees per second in 100 steps.
+      Quaternion attitude;
+      const Vec3<Quotient_unit<radian, second>> omega{Quotient_unit<radian, second>(std::numbers::pi_v<TU_TYPE> / (TU_TYPE)2.0),
+                                                      Quotient_unit<radian, second>(0.0f), Quotient_unit<radian, second>(0.0f)};
+      for (int i = 0; i < 100; ++i) {
+        attitude = integrate(attitude, omega, Unit<prefix::milli, second>(10.0f));
+      }
+      const Vec3<metre> y = attitude.rotate(Vec3<metre>{metre(0.0f), metre(1.0f), metre(0.0f)});
+      t.assert_true(std::abs(y.z.base_value - (TU_TYPE)1.0) < (TU_TYPE)1.0e-4, __LINE__);
+
+      t.template assert<near<>>(dot(v, v).base_value, (TU_TYPE)14.0, __LINE__);
+      static_assert(std::is_same_v<decltype(dot(v, z_axis)), metre_per_second>);
+      static_assert(std::is_same_v<decltype(cross(r, v)), Vec3<Product_unit<metre, metre_per_second>>>);
+      t.template assert<near<>>(cross(v, v).z.base_value, (TU_TYPE)0.0, __LINE__);
+    }
+  );
+
+  Test<"Rotation batch">(
+    []<typename T>(T &t) {
+      constexpr std::size_t n = 203;
+      std::vector<metre> x;
+      std::vector<metre> y;
+      std::vector<metre> z;
+      std::vector<Quaternion> q;
+      for (std::size_t i = 0; i < n; ++i) {
+        x.push_back(metre((TU_TYPE)i));
+        y.push_back(metre((TU_TYPE)1.0 - (TU_TYPE)i * (TU_TYPE)0.5));
+        z.push_back(metre((TU_TYPE)(i % 7)));
+        q.push_back(Quaternion::from_euler(radian((TU_TYPE)i * (TU_TYPE)0.01), radian(0.1f), Unit<prefix::no_prefix, degree>((TU_TYPE)i)));
+      }
+      std::vector<metre> xr(n);
+      std::vector<metre> yr(n);
+      std::vector<metre> zr(n);
+      rotate(q[5], Vec3_span<const metre>{x, y, z}, Vec3_span<metre>{xr, yr, zr});
+      for (std::size_t i = 0; i < n; ++i) {
+        const Vec3<metre> r = q[5].rotate(Vec3<metre>{x[i], y[i], z[i]});
+        t.assert_true(std::abs(xr[i].base_value - r.x.base_value) < (TU_TYPE)1.0e-3, __LINE__);
+        t.assert_true(std::abs(yr[i].base_value - r.y.base_value) < (TU_TYPE)1.0e-3, __LINE__);
+        t.assert_true(std::abs(zr[i].base_value - r.z.base_value) < (TU_TYPE)1.0e-3, __LINE__);
+      }
+      rotate(std::span<const Quaternion>(q), Vec3_span<const metre>{x, y, z}, Vec3_span<metre>{xr, yr, zr});
+      for (std::size_t i = 0; i < n; ++i) {
+        const Vec3<metre> r = q[i].rotate(Vec3<metre>{x[i], y[i], z[i]});
+        t.assert_true(xr[i] == r.x && yr[i] == r.y && zr[i] == r.z, __LINE__);
+      }
+      // In place.
+      rotate(Rotation_matrix::about_z(Unit<prefix::no_prefix, degree>(180.0f)), Vec3_span<const metre>{xr, yr, zr}, Vec3_span<metre>{xr, yr, zr});
+      const Vec3<metre> r = q[9].rotate(Vec3<metre>{x[9], y[9], z[9]});
+      t.assert_true(std::abs(xr[9].base_value + r.x.base_value) < (TU_TYPE)1.0e-3, __LINE__);
+    }
+  );
+
+  Test<"Sparse matrix">(
+    []<typename T>(T &t) {
+      // Resistor chain with a grounding resistor at every node. Stamps of the
+      // same node are added.
+      const std::size_t n = 100;
+      std::vector<Triplet<siemens>> stamps;
+      // Stamped from the last node so that the entries are not sorted.
+      for (std::size_t i = n; i-- > 0;) {
+        stamps.push_back({i, i, siemens(0.5f)});
+        if (i + 1 < n) {
+          stamps.push_back({i, i, siemens(2.0f)});
+          stamps.push_back({i + 1, i + 1, siemens(2.0f)});
+          stamps.push_back({i, i + 1, siemens(-2.0f)});
+          stamps.push_back({i + 1, i, siemens(-2.0f)});
+        }
+      }
+      const Csr_matrix<siemens> g = Csr_matrix<siemens>::from_triplets(n, n, std::span<const Triplet<siemens>>(stamps));
+      t.assert_true(g.non_zeros() == 3 * n - 2, __LINE__);
+      t.assert_true(g(0, 0) == siemens(2.5f) && g(1, 1) == siemens(4.5f) && g(n - 1, n - 1) == siemens(2.5f), __LINE__);
+      t.assert_true(g(3, 4) == siemens(-2.0f) && g(4, 3) == siemens(-2.0f) && g(3, 5) == siemens(0.0f), __LINE__);
+
+      std::vector<volt> u;
+      for (std::size_t i = 0; i < n; ++i) {
+        u.push_back(volt((TU_TYPE)(i % 5)));
+      }
+      std::vector<ampere> current(n);
+      multiply(g, std::span<const volt>(u), std::span<ampere>(current));
+      static_assert(std::is_same_v<decltype(current)::value_type, Product_unit<siemens, volt>>);
+      t.assert_true(current[0] == ampere(-2.0f), __LINE__);
+      t.assert_true(current[2] == ampere(1.0f), __LINE__);
+      t.assert_true(current[4] == ampere(12.0f), __LINE__);
+
+      // Rows split between threads give the same result.
+      std::vector<ampere> threaded(n);
+      multiply(g, std::span<const volt>(u), std::span<ampere>(threaded), 4);
+      t.assert_true(std::equal(current.begin(), current.end(), threaded.begin()), __LINE__);
+
+      const auto wrong_unit = [](auto& a, auto x, auto y) -> decltype(multiply(a, x, y)) {};
+      static_assert(std::is_invocable_v<decltype(wrong_unit), const Csr_matrix<siemens>&, std::span<const volt>, std::span<ampere>>);
+      static_assert(!std::is_invocable_v<decltype(wrong_unit), const Csr_matrix<siemens>&, std::span<const volt>, std::span<volt>>);
+    }
+  );
+
+  Test<"Conjugate gradient">(
+    []<typename T>(T &t) {
+      // Grid of 20 x 20 nodes connected by 1 ohm resistors and grounded by
+      // 10 ohm resistors. 1 A is injected in one corner.
+      const std::size_t side = 20;
+      const std::size_t n = side * side;
+      std::vector<Triplet<siemens>> stamps;
+      const auto connect = [&stamps](std::size_t a, std::size_t b, siemens s) {
+        stamps.push_back({a, a, s});
+        stamps.push_back({b, b, s});
+        stamps.push_back({a, b, siemens(-s.base_value)});
+        stamps.push_back({b, a, siemens(-s.base_value)});
+      };
+      for (std::size_t i = 0; i < side; ++i) {
+        for (std::size_t j = 0; j < side; ++j) {
+          const std::size_t node = i * side + j;
+          stamps.push_back({node, node, siemens(0.1f)});
+          if (j + 1 < side) {
+            connect(node, node + 1, siemens(1.0f));
+          }
+          if (i + 1 < side) {
+            connect(node, node + side, siemens(1.0f));
+          }
+        }
+      }
+      const Csr_matrix<siemens> g = Csr_matrix<siemens>::from_triplets(n, n, std::span<const Triplet<siemens>>(stamps));
+      std::vector<ampere> injected(n, ampere(0.0f));
+      std::construct_at(&injected[0], 1.0f);
+      std::vector<volt> u(n, volt(0.0f));
+      const Solver_result<ampere> r = conjugate_gradient(g, std::span<const ampere>(injected), std::span<volt>(u),
+                                                         Unit<prefix::micro, ampere>(10.0f), 1000, 3);
+      t.assert_true(r.converged, __LINE__);
+      t.assert_true(r.iterations > 0 && r.iterations < 200, __LINE__);
+      t.assert_true(r.residual <= Unit<prefix::micro, ampere>(10.0f), __LINE__);
+
+      // The node voltages give back the injected currents.
+      std::vector<ampere> current(n);
+      multiply(g, std::span<const volt>(u), std::span<ampere>(current));
+      for (std::size_t i = 0; i < n; ++i) {
+        t.assert_true(std::abs(current[i].base_value - injected[i].base_value) < (TU_TYPE)1.0e-4, __LINE__);
+      }
+      // The voltage falls with the distance from the injection.
+      t.assert_true(u[0] > u[1] && u[1] > u[side + 1] && u[side + 1] > u[n - 1] && u[n - 1] > volt(0.0f), __LINE__);
+      // All the injected current flows to ground through the 10 ohm resistors.
+      TU_TYPE grounded = 0.0f;
+      for (const volt& v : u) {
+        grounded += (TU_TYPE)0.1 * v.base_value;
+      }
+      t.assert_true(std::abs(grounded - (TU_TYPE)1.0) < (TU_TYPE)1.0e-3, __LINE__);
+
+      // A workspace of the caller gives the same solution.
+      Cg_workspace workspace(n);
+      std::vector<volt> w(n, volt(0.0f));
+      const Solver_result<ampere> reused = conjugate_gradient(g, std::span<const ampere>(injected), std::span<volt>(w),
+                                                              Unit<prefix::micro, ampere>(10.0f), 1000, workspace, 3);
+      t.assert_true(reused.iterations == r.iterations && std::equal(u.begin(), u.end(), w.begin()), __LINE__);
+      Cg_workspace small(n - 1);
+      const Solver_result<ampere> mismatched = conjugate_gradient(g, std::span<const ampere>(injected), std::span<volt>(w),
+                                                                  Unit<prefix::micro, ampere>(10.0f), 1000, small);
+      t.assert_true(!mismatched.converged && std::isnan(mismatched.residual.base_value), __LINE__);
+      t.assert_false(conjugate_gradient(g, std::span<const ampere>(injected).first(n - 1), std::span<volt>(w),
+                                        Unit<prefix::micro, ampere>(10.0f), 1000).converged, __LINE__);
+
+      // A converged solution as start needs no iterations.
+      const Solver_result<ampere> again = conjugate_gradient(g, std::span<const ampere>(injected), std::span<volt>(u),
+                                                             Unit<prefix::milli, ampere>(1.0f), 1000);
+      t.assert_true(again.converged && again.iterations == 0, __LINE__);
+    }
+  );
+
+  Test<"Grid stencil">(
+    []<typename T>(T &t) {
+      // Quadratic field with a constant Laplacian of 4 K / m^2.
+      const std::size_t nx = 150;
+      const std::size_t ny = 40;
+      const TU_TYPE h = 0.5f;
+      Grid<kelvin, 2> temperature({nx, ny}, 1);
+      for (std::ptrdiff_t y = -1; y <= (std::ptrdiff_t)ny; ++y) {
+        for (std::ptrdiff_t x = -1; x <= (std::ptrdiff_t)nx; ++x) {
+          temperature.set({x, y}, kelvin((TU_TYPE)(x * x + y * y) * h * h));
+        }
+      }
+      t.assert_true(temperature({3, -1}) == kelvin((TU_TYPE)10.0 * h * h), __LINE__);
+      const auto lap = laplacian<2>(Unit<prefix::centi, metre>(50.0f));
+      static_assert(std::is_same_v<decltype(lap)::Unit_type, Quotient_unit<scalar, metre_squared>>);
+      Grid<Quotient_unit<kelvin, metre_squared>, 2> curvature({nx, ny}, 0);
+      apply(lap, temperature, curvature);
+      bool exact = true;
+      for (std::ptrdiff_t y = 0; y < (std::ptrdiff_t)ny; ++y) {
+        for (std::ptrdiff_t x = 0; x < (std::ptrdiff_t)nx; ++x) {
+          exact = exact && std::abs(curvature({x, y}).base_value - (TU_TYPE)4.0) < (TU_TYPE)0.05;
+        }
+      }
+      t.assert_true(exact, __LINE__);
+
+      // Tiles split between threads give the same result.
+      Grid<Quotient_unit<kelvin, metre_squared>, 2> threaded({nx, ny}, 0);
+      apply(lap, temperature, threaded, 3);
+      t.assert_true(std::ranges::equal(curvature.data(), threaded.data()), __LINE__);
+
+      Grid<Quotient_unit<kelvin, metre>, 2> slope({nx, ny}, 0);
+      apply(central_difference<2>(1, metre(h)), temperature, slope);
+      t.assert_true(std::abs(slope({7, 9}).base_value - (TU_TYPE)2.0 * (TU_TYPE)9.0 * h) < (TU_TYPE)1.0e-3, __LINE__);
+
+      const auto wrong_unit = [](auto& s, auto& in, auto& out) -> decltype(apply(s, in, out)) {};
+      static_assert(!std::is_invocable_v<decltype(wrong_unit), decltype(lap)&, Grid<kelvin, 2>&, Grid<Quotient_unit<kelvin, metre>, 2>&>);
+
+      // Halos.
+      Grid<kelvin, 3> cube({4, 3, 2}, 2);
+      for (std::ptrdiff_t z = 0; z < 2; ++z) {
+        for (std::ptrdiff_t y = 0; y < 3; ++y) {
+          for (std::ptrdiff_t x = 0; x < 4; ++x) {
+            cube.set({x, y, z}, kelvin((TU_TYPE)(x + 10 * y + 100 * z)));
+          }
+        }
+      }
+      cube.fill_halo(boundary::periodic);
+      t.assert_true(cube({-1, 0, 0}) == kelvin(3.0f) && cube({-2, 0, 0}) == kelvin(2.0f) && cube({5, 1, 1}) == kelvin(111.0f), __LINE__);
+      t.assert_true(cube({-1, -1, -1}) == kelvin(123.0f) && cube({4, 3, 2}) == kelvin(0.0f), __LINE__);
+      cube.fill_halo(boundary::zero_gradient);
+      t.assert_true(cube({-2, 1, 1}) == kelvin(110.0f) && cube({5, 4, 3}) == kelvin(123.0f), __LINE__);
+      cube.fill_halo(boundary::fixed, kelvin(-1.0f));
+      t.assert_true(cube({-1, 1, 1}) == kelvin(-1.0f) && cube({0, 1, 2}) == kelvin(-1.0f) && cube({0, 1, 1}) == kelvin(110.0f), __LINE__);
+
+      // A uniform field with insulated boundaries has no curvature, up to the
+      // rounding of the 1.8e7 K / m^2 terms of the stencil.
+      Grid<kelvin, 3> field({70, 20, 5}, 1, Unit<prefix::no_prefix, degree_Celsius>(20.0f));
+      field.fill_halo(boundary::zero_gradient);
+      Grid<Quotient_unit<kelvin, metre_squared>, 3> change({70, 20, 5}, 0);
+      apply(laplacian<3>(Unit<prefix::centi, metre>(1.0f)), field, change, 4);
+      t.assert_true(std::ranges::all_of(change.data(), [](const auto& c) { return std::abs(c.base_value) < (TU_TYPE)100.0; }), __LINE__);
+    }
+  );
+
+  Test<"Integration">(
+    []<typename T>(T &t) {
+      const auto close = [](const auto& a, const auto& b) {
+        return std::abs(a.base_value - b.base_value) <= (TU_TYPE)1.0e-4 * std::abs(b.base_value);
+      };
+      // Power ramping linearly from 0 to 1000 W over 10 s, sampled unevenly.
+      std::vector<second> time;
+      std::vector<watt> power;
+      for (int i = 0; i <= 20; ++i) {
+        const TU_TYPE s = (TU_TYPE)(i * i) / (TU_TYPE)40.0;
+        time.push_back(second(s));
+        power.push_back(watt((TU_TYPE)100.0 * s));
+      }
+      const joule energy = trapezoid(std::span<const second>(time), std::span<const watt>(power));
+      t.assert_true(close(energy, joule(5000.0f)), __LINE__);
+      std::vector<joule> running(time.size());
+      cumulative_trapezoid(std::span<const second>(time), std::span<const watt>(power), std::span<joule>(running));
+      t.assert_true(running[0] == joule(0.0f) && close(running[20], energy), __LINE__);
+      t.assert_true(close(running[10], joule((TU_TYPE)50.0 * time[10].base_value * time[10].base_value)), __LINE__);
+
+      // Constant spacing in another unit than the coherent one.
+      const Unit<prefix::milli, second> dt(250.0f);
+      std::vector<watt> cubic;
+      for (int i = 0; i <= 8; ++i) {
+        const TU_TYPE s = (TU_TYPE)i * (TU_TYPE)0.25;
+        cubic.push_back(watt(s * s * s));
+      }
+      // Exact for cubic polynomials with both an odd and an even number of samples.
+      t.assert_true(close(simpson(std::span<const watt>(cubic), dt), joule(4.0f)), __LINE__);
+      t.assert_true(close(simpson(std::span<const watt>(cubic).first(8), dt), joule((TU_TYPE)0.25 * (TU_TYPE)std::pow(1.75, 4))), __LINE__);
+      t.assert_true(close(simpson(std::span<const watt>(cubic).first(2), dt), joule((TU_TYPE)0.5 * (TU_TYPE)0.25 * (TU_TYPE)std::pow(0.25, 3))), __LINE__);
+      t.assert_true(std::abs(trapezoid(std::span<const watt>(cubic), dt).base_value - (TU_TYPE)4.0) < (TU_TYPE)0.1, __LINE__);
+      static_assert(std::is_same_v<decltype(simpson(std::span<const watt>(cubic), dt)), joule>);
+
+      // Long series split between threads.
+      const std::size_t n = 50001;
+      std::vector<watt> load;
+      for (std::size_t i = 0; i < n; ++i) {
+        load.push_back(watt((TU_TYPE)(i % 100)));
+      }
+      const joule single = trapezoid(std::span<const watt>(load), second(1.0f));
+      const joule threaded = trapezoid(std::span<const watt>(load), second(1.0f), 4);
+      t.assert_true(close(single, threaded), __LINE__);
+      t.assert_true(std::abs(single.base_value - (TU_TYPE)2475000.0) < (TU_TYPE)10.0, __LINE__);
+      std::vector<joule> single_running(n);
+      std::vector<joule> threaded_running(n);
+      cumulative_trapezoid(std::span<const watt>(load), second(1.0f), std::span<joule>(single_running));
+      cumulative_trapezoid(std::span<const watt>(load), second(1.0f), std::span<joule>(threaded_running), 4);
+      t.assert_true(close(single_running[n - 1], threaded_running[n - 1]) && close(single_running[n / 2], threaded_running[n / 2]), __LINE__);
+      t.assert_true(std::abs(single_running[n - 1].base_value - single.base_value) < (TU_TYPE)10.0, __LINE__);
+    }
+  );
+
+  Test<"Differentiation">(
+    []<typename T>(T &t) {
+      const auto close = [](const auto& a, const auto& b) {
+        return std::abs(a.base_value - b.base_value) <= (TU_TYPE)1.0e-4 * std::abs(b.base_value);
+      };
+      // Position x = t^2 sampled unevenly. The central differences are exact
+      // for quadratics.
+      std::vector<second> time;
+      std::vector<metre> position;
+      for (int i = 0; i < 12; ++i) {
+        const TU_TYPE s = (TU_TYPE)(i * i) / (TU_TYPE)10.0;
+        time.push_back(second(s));
+        position.push_back(metre(s * s));
+      }
+      std::vector<metre_per_second> velocity(time.size());
+      derivative(std::span<const second>(time), std::span<const metre>(position), std::span<metre_per_second>(velocity));
+      for (std::size_t i = 1; i + 1 < time.size(); ++i) {
+        t.assert_true(std::abs(velocity[i].base_value - (TU_TYPE)2.0 * time[i].base_value) < (TU_TYPE)1.0e-3, __LINE__);
+      }
+      t.assert_true(close(velocity[0], metre_per_second(0.1f)), __LINE__);
+      t.assert_true(close(velocity[11], metre_per_second(time[10].base_value + time[11].base_value)), __LINE__);
+
+      // Constant spacing, and the derivative of the velocity is an acceleration.
+      const std::size_t n = 20000;
+      std::vector<metre_per_second> v;
+      for (std::size_t i = 0; i < n; ++i) {
+        v.push_back(metre_per_second((TU_TYPE)3.0 * (TU_TYPE)i * (TU_TYPE)0.01));
+      }
+      std::vector<Quotient_unit<metre_per_second, second>> a(n);
+      derivative(std::span<const metre_per_second>(v), Unit<prefix::centi, second>(1.0f), std::span<Quotient_unit<metre_per_second, second>>(a), 4);
+      t.assert_true(std::ranges::all_of(a, [](const Quotient_unit<metre_per_second, second>& x) { return std::abs(x.base_value - (TU_TYPE)3.0) < (TU_TYPE)0.05; }), __LINE__);
+
+      const auto wrong_unit = [](auto x, auto y, auto out) -> decltype(derivative(x, y, out)) {};
+      static_assert(!std::is_invocable_v<decltype(wrong_unit), std::span<const second>, std::span<const metre>, std::span<Quotient_unit<metre_per_second, second>>>);
+    }
+  );
+
+  Test<"Linear regression">(
+    []<typename T>(T &t) {
+      const auto close = [](const auto& a, const auto& b) {
+        return std::abs(a.base_value - b.base_value) <= (TU_TYPE)1.0e-3 * std::abs(b.base_value);
+      };
+      // Temperature rising 0.5 K per minute from 20 degrees Celsius with an
+      // alternating disturbance that does not change the trend.
+      std::vector<Unit<prefix::no_prefix, minute>> time;
+      std::vector<Unit<prefix::no_prefix, degree_Celsius>> temperature;
+      for (int i = 0; i < 20; ++i) {
+        time.push_back(Unit<prefix::no_prefix, minute>((TU_TYPE)i));
+        temperature.push_back(Unit<prefix::no_prefix, degree_Celsius>((TU_TYPE)20.0 + (TU_TYPE)0.5 * (TU_TYPE)i + (i % 2 == 0 ? (TU_TYPE)0.1 : (TU_TYPE)-0.1)));
+      }
+      const auto f = linear_fit(std::span<const Unit<prefix::no_prefix, minute>>(time),
+                                std::span<const Unit<prefix::no_prefix, degree_Celsius>>(temperature));
+      static_assert(std::is_same_v<decltype(f), const Linear_fit<second, kelvin>>);
+      static_assert(std::is_same_v<decltype(f.slope), Quotient_unit<kelvin, second>>);
+      t.assert_true(std::abs(f.slope.base_value - (TU_TYPE)0.5 / (TU_TYPE)60.0) < (TU_TYPE)1.0e-4, __LINE__);
+      t.assert_true(std::abs(f(Unit<prefix::no_prefix, minute>(10.0f)).base_value - (TU_TYPE)298.15) < (TU_TYPE)0.05, __LINE__);
+
+      // Streaming accumulators, also merged from two halves.
+      Least_squares<second, kelvin> all;
+      Least_squares<second, kelvin> first;
+      Least_squares<second, kelvin> second_half;
+      for (std::size_t i = 0; i < time.size(); ++i) {
+        all.add(time[i], temperature[i]);
+        (i < 7 ? first : second_half).add(time[i], temperature[i]);
+      }
+      first.merge(second_half);
+      t.assert_true(all.count() == 20 && first.count() == 20, __LINE__);
+      t.assert_true(close(all.fit().slope, f.slope) && close(all.fit().intercept, f.intercept), __LINE__);
+      t.assert_true(close(first.fit().slope, f.slope) && close(first.fit().intercept, f.intercept), __LINE__);
+
+      // Many series at the same points, split between threads.
+      const std::size_t series = 9000;
+      const std::size_t m = 6;
+      std::vector<second> x;
+      for (std::size_t k = 0; k < m; ++k) {
+        x.push_back(second((TU_TYPE)(10 * k)));
+      }
+      std::vector<volt> y;
+      for (std::size_t s = 0; s < series; ++s) {
+        for (std::size_t k = 0; k < m; ++k) {
+          y.push_back(volt((TU_TYPE)(s % 10) + (TU_TYPE)((s % 7) * k) * (TU_TYPE)0.01));
+        }
+      }
+      std::vector<Quotient_unit<volt, second>> slope(series);
+      std::vector<volt> intercept(series);
+      linear_fit(std::span<const second>(x), std::span<const volt>(y), std::span<Quotient_unit<volt, second>>(slope), std::span<volt>(intercept), 3);
+      bool exact = true;
+      for (std::size_t s = 0; s < series; ++s) {
+        exact = exact && std::abs(slope[s].base_value - (TU_TYPE)(s % 7) * (TU_TYPE)0.001) < (TU_TYPE)1.0e-5;
+        exact = exact && std::abs(intercept[s].base_value - (TU_TYPE)(s % 10)) < (TU_TYPE)1.0e-4;
+      }
+      t.assert_true(exact, __LINE__);
+      const auto one = linear_fit(std::span<const second>(x), std::span<const volt>(y).subspan(6 * 3, 6));
+      t.assert_true(close(one.slope, slope[3]) && close(one.intercept, intercept[3]), __LINE__);
+
+      // A y that holds fewer series than slope leaves the other slopes alone.
+      std::vector<Quotient_unit<volt, second>> short_slope(4, Quotient_unit<volt, second>(7.0f));
+      std::vector<volt> short_intercept(4, volt(7.0f));
+      linear_fit(std::span<const second>(x), std::span<const volt>(y).first(2 * m + 1), std::span<Quotient_unit<volt, second>>(short_slope),
+                 std::span<volt>(short_intercept));
+      t.assert_true(close(short_slope[1], slope[1]) && short_slope[2].base_value == (TU_TYPE)7.0, __LINE__);
+      t.assert_true(short_intercept[2].base_value == (TU_TYPE)7.0, __LINE__);
+    }
+  );
+
+  Test<"Fft">(
+    []<typename T>(T &t) {
+      // Compare with the discrete Fourier transform from the definition for
+      // sizes with radix 4, 2 and general factors.
+      for (const std::size_t n : {1, 2, 8, 9, 12, 14, 16, 30, 105, 256}) {
+        std::vector<metre> x;
+        for (std::size_t i = 0; i < n; ++i) {
+          x.push_back(metre((TU_TYPE)std::sin(0.3 * (double)(i * i)) + (TU_TYPE)(i % 3)));
+        }
+        Real_fft fft(n);
+        t.assert_true(fft.size() == n && fft.bins() == n / 2 + 1, __LINE__);
+        std::vector<metre> re(fft.bins());
+        std::vector<metre> im(fft.bins());
+        fft.transform(std::span<const metre>(x), Complex_span<metre>{re, im});
+        bool exact = true;
+        for (std::size_t k = 0; k < fft.bins(); ++k) {
+          double sr = 0.0;
+          double si = 0.0;
+          for (std::size_t i = 0; i < n; ++i) {
+            sr += x[i].base_value * std::cos(2.0 * std::numbers::pi * (double)(k * i) / (double)n);
+            si -= x[i].base_value * std::sin(2.0 * std::numbers::pi * (double)(k * i) / (double)n);
+          }
+          exact = exact && std::abs(re[k].base_value - sr) < 1.0e-3 * (double)n && std::abs(im[k].base_value - si) < 1.0e-3 * (double)n;
+        }
+        t.assert_true(exact, __LINE__);
+      }
+
+      // A 50 Hz vibration sampled at 1 kHz.
+      const std::size_t n = 200;
+      const Unit<prefix::milli, second> period(1.0f);
+      std::vector<metre_per_second> v;
+      for (std::size_t i = 0; i < n; ++i) {
+        v.push_back(metre_per_second((TU_TYPE)0.5 + (TU_TYPE)std::cos(2.0 * std::numbers::pi * 50.0 * (double)i / 1000.0)));
+      }
+      Real_fft fft(n);
+      t.assert_true(std::abs(fft.frequency(10, period).base_value - (TU_TYPE)50.0) < (TU_TYPE)1.0e-4, __LINE__);
+      std::vector<metre_per_second> re(fft.bins());
+      std::vector<metre_per_second> im(fft.bins());
+      fft.transform(std::span<const metre_per_second>(v), Complex_span<metre_per_second>{re, im});
+      t.assert_true(std::abs(re[10].base_value - (TU_TYPE)100.0) < (TU_TYPE)1.0e-2 && std::abs(re[0].base_value - (TU_TYPE)100.0) < (TU_TYPE)1.0e-2, __LINE__);
+      t.assert_true(std::abs(re[11].base_value) < (TU_TYPE)1.0e-2 && std::abs(im[10].base_value) < (TU_TYPE)1.0e-2, __LINE__);
+
+      // The density integrates to the mean square, 0.25 + 0.5.
+      using Density = Quotient_unit<Power_unit<metre_per_second, std::ratio<2>>, hertz>;
+      static_assert(std::is_same_v<Density, Quotient_unit<Product_unit<metre_per_second, metre_per_second>, hertz>>);
+      std::vector<Density> psd(fft.bins());
+      power_spectral_density(fft, Complex_span<const metre_per_second>{re, im}, period, std::span<Density>(psd));
+      TU_TYPE mean_square = 0.0f;
+      for (const Density& d : psd) {
+        mean_square += d.base_value * fft.frequency(1, period).base_value;
+      }
+      t.assert_true(std::abs(mean_square - (TU_TYPE)0.75) < (TU_TYPE)1.0e-3, __LINE__);
+      const auto wrong_unit = [](const Real_fft& f, auto s, auto p, auto o) -> decltype(power_spectral_density(f, s, p, o)) {};
+      static_assert(!std::is_invocable_v<decltype(wrong_unit), const Real_fft&, Complex_span<const metre_per_second>, second, std::span<Product_unit<Density, hertz>>>);
+
+      // Channels split between threads give the same spectra.
+      const std::size_t channels = 7;
+      std::vector<metre_per_second> many;
+      for (std::size_t c = 0; c < channels; ++c) {
+        for (std::size_t i = 0; i < n; ++i) {
+          many.push_back(metre_per_second(v[i].base_value * (TU_TYPE)(c + 1)));
+        }
+      }
+      std::vector<metre_per_second> many_re(channels * fft.bins());
+      std::vector<metre_per_second> many_im(channels * fft.bins());
+      t.assert_true(fft.transform(std::span<const metre_per_second>(many), Complex_span<metre_per_second>{many_re, many_im}, 3) == channels, __LINE__);
+      bool same = true;
+      for (std::size_t k = 0; k < fft.bins(); ++k) {
+        same = same && std::abs(many_re[4 * fft.bins() + k].base_value - (TU_TYPE)5.0 * re[k].base_value) < (TU_TYPE)1.0e-3;
+        same = same && std::abs(many_im[6 * fft.bins() + k].base_value - (TU_TYPE)7.0 * im[k].base_value) < (TU_TYPE)1.0e-3;
+      }
+      t.assert_true(same, __LINE__);
+
+      // Only whole channels that fit into out are transformed.
+      std::vector<metre_per_second> few_re(2 * fft.bins());
+      std::vector<metre_per_second> few_im(3 * fft.bins());
+      t.assert_true(fft.transform(std::span<const metre_per_second>(many).first(4 * n - 1), Complex_span<metre_per_second>{few_re, few_im}) == 2, __LINE__);
+      t.assert_true(fft.transform(std::span<const metre_per_second>(many).first(2 * n - 1), Complex_span<metre_per_second>{few_re, few_im}) == 1, __LINE__);
+      Real_fft empty(0);
+      std::vector<metre_per_second> one_re(empty.bins());
+      std::vector<metre_per_second> one_im(empty.bins());
+      t.assert_true(empty.size() == 1 && empty.bins() == 1, __LINE__);
+      t.assert_true(empty.transform(std::span<const metre_per_second>(v).first(1), Complex_span<metre_per_second>{one_re, one_im}) == 1, __LINE__);
+      t.template assert<std::equal_to<>>(one_re[0].base_value, v[0].base_value, __LINE__);
+    }
+  );
+
+  Test<"Resampler">(
+    []<typename T>(T &t) {
+      Resampler<volt> r(Unit<prefix::kilo, hertz>(12.8f), Unit<prefix::kilo, hertz>(10.0f));
+      t.assert_true(r.up() == 25 && r.down() == 32 && r.taps() == 24, __LINE__);
+      Resampler<volt> up(Unit<prefix::kilo, hertz>(10.0f), Unit<prefix::kilo, hertz>(50.0f), 16);
+      t.assert_true(up.up() == 5 && up.down() == 1, __LINE__);
+      Resampler<volt> down(hertz(50000.0f), Unit<prefix::kilo, hertz>(10.0f));
+      t.assert_true(down.up() == 1 && down.down() == 5, __LINE__);
+      // Rates that round to 0 Hz are taken as 1 Hz.
+      Resampler<volt> slow(Unit<prefix::milli, hertz>(200.0f), Unit<prefix::milli, hertz>(100.0f), 0);
+      t.assert_true(slow.up() == 1 && slow.down() == 1 && slow.taps() == 1, __LINE__);
+      std::vector<volt> slow_out(slow.max_output(3));
+      t.assert_true(slow.process(std::span<const volt>(std::vector<volt>(3, volt(1.0f))), std::span<volt>(slow_out)) == 3, __LINE__);
+
+      // A 1 kHz tone at 12.8 kHz resampled to 10 kHz, in parts of different
+      // sizes.
+      const std::size_t n = 3200;
+      std::vector<volt> in;
+      for (std::size_t i = 0; i < n; ++i) {
+        in.push_back(volt((TU_TYPE)std::sin(2.0 * std::numbers::pi * 1000.0 * (double)i / 12800.0)));
+      }
+      std::vector<volt> out(r.max_output(n));
+      std::size_t produced = 0;
+      for (std::size_t first = 0; first < n; first += 700) {
+        const std::size_t len = std::min((std::size_t)700, n - first);
+        produced += r.process(std::span<const volt>(in).subspan(first, len), std::span<volt>(out).subspan(produced, r.max_output(len)));
+      }
+      t.assert_true(produced == 2500, __LINE__);
+      const double delay = r.delay().base_value;
+      t.assert_true(std::abs(delay - 0.5 * (25.0 * 24.0 - 1.0) / (25.0 * 12800.0)) < 1.0e-6, __LINE__);
+      bool tone = true;
+      for (std::size_t i = 100; i < produced; ++i) {
+        const double expected = std::sin(2.0 * std::numbers::pi * 1000.0 * ((double)i / 10000.0 - delay));
+        tone = tone && std::abs(out[i].base_value - expected) < 1.0e-2;
+      }
+      t.assert_true(tone, __LINE__);
+
+      // The same stream in one part gives the same output.
+      r.reset();
+      std::vector<volt> whole(r.max_output(n));
+      t.assert_true(r.process(std::span<const volt>(in), std::span<volt>(whole)) == produced, __LINE__);
+      t.assert_true(std::equal(out.begin(), out.begin() + (std::ptrdiff_t)produced, whole.begin()), __LINE__);
+
+      // Constant input in millivolt passes with unit gain after upsampling.
+      std::vector<Unit<prefix::milli, volt>> dc(300, Unit<prefix::milli, volt>(500.0f));
+      std::vector<volt> dc_out(up.max_output(dc.size()));
+      t.assert_true(up.process(std::span<const Unit<prefix::milli, volt>>(dc), std::span<volt>(dc_out)) == 1500, __LINE__);
+      t.assert_true(std::all_of(dc_out.begin() + 100, dc_out.begin() + 1500, [](const volt& v) { return std::abs(v.base_value - (TU_TYPE)0.5) < (TU_TYPE)1.0e-2; }), __LINE__);
+    }
+  );
+
+  Test<"Shadow">(
+    []<typename T>(T &t) {
+      thread_shadow_profile().clear();
+
+      // Products of exact values stay within an epsilon.
+      const TU_TYPE eps = std::numeric_limits<TU_TYPE>::epsilon();
+      Shadow<metre> l(Unit<prefix::milli, metre>(1500.0f));
+      const auto a = l * l * scalar(3.0f);
+      t.assert_true(a.relative_error() <= eps, __LINE__);
+      t.assert_true(thread_shadow_profile().max_relative_error() <= eps, __LINE__);
+
+      // A long sum of small values loses precision in float, which the
+      // checkpoint records at its call site.
+      Shadow<joule> sum(0.0L);
+      for (int i = 0; i < 1000000; ++i) {
+        sum = sum + Unit<prefix::milli, joule>(0.1f);
+      }
+      const unsigned line = __LINE__ + 1;
+      const auto total = checkpoint(sum);
+      t.assert_true(std::abs(total.shadow() - 100.0L) < 1.0e-4L, __LINE__);
+      if constexpr (std::is_same_v<TU_TYPE, float>) {
+        t.assert_true(total.relative_error() > 1.0e-3L, __LINE__);
+      } else {
+        t.assert_true(total.relative_error() < 1.0e-8L, __LINE__);
+      }
+      const std::vector<Shadow_error> sites = thread_shadow_profile().ranked();
+      const auto site = std::find_if(sites.begin(), sites.end(), [](const Shadow_error& e) { return std::string(e.operation) == "checkpoint"; });
+      t.assert_true(site != sites.end() && site->call_site.line() == line && std::string(site->unit) == "s^-2 m^2 kg", __LINE__);
+      t.assert_true(site->max_relative_error == total.relative_error() && sites.front().max_relative_error >= site->max_relative_error, __LINE__);
+
+      // The rounding of a conversion to the coherent unit is recorded where
+      // the Shadow is constructed.
+      const unsigned converted = __LINE__ + 1;
+      const Shadow<joule> ionization(Unit<prefix::no_prefix, electronvolt>(13.6f));
+      t.assert_true(ionization.relative_error() > 0.0L && ionization.relative_error() <= eps, __LINE__);
+      const std::vector<Shadow_error> constructed = thread_shadow_profile().ranked();
+      t.assert_true(std::any_of(constructed.begin(), constructed.end(), [converted](const Shadow_error& e) {
+        return std::string(e.operation) == "construct" && e.call_site.line() == converted && e.max_relative_error > 0.0L;
+      }), __LINE__);
+
+      // pow, sqrt, unop and conversions are traced.
+      const auto v = sqrt(pow<std::ratio<2>>(l) + metre_squared(1.0f));
+      const auto e = unop([](auto x) { return std::exp(x); }, Shadow<scalar>(scalar(2.0f)));
+      const auto c = Shadow<kelvin>(300.0L).to<Unit<prefix::no_prefix, degree_Celsius>>();
+      t.assert_true(std::abs(v.shadow() - std::sqrt(l.shadow() * l.shadow() + 1.0L)) < 1.0e-12L && v.relative_error() < 4 * eps, __LINE__);
+      t.assert_true(std::abs(e.shadow() - std::exp(2.0L)) < 1.0e-12L && e.relative_error() < 4 * eps, __LINE__);
+      t.assert_true(std::abs(c.value - (TU_TYPE)26.85) < (TU_TYPE)1.0e-4, __LINE__);
+
+      // Profiles of several threads are merged per site.
+      Shadow_profile merged;
+      merged.merge(thread_shadow_profile());
+      merged.merge(thread_shadow_profile());
+      const std::vector<Shadow_error> twice = merged.ranked();
+      t.assert_true(twice.size() == thread_shadow_profile().ranked().size() && twice.front().max_relative_error == sites.front().max_relative_error, __LINE__);
+      Shadow_profile collected;
+      collect_shadow_profile(collected);
+      t.assert_true(thread_shadow_profile().ranked().empty() && collected.ranked().size() == twice.size(), __LINE__);
+    }
+  );
+
+  Test<"Execution policy">(
+    []<typename T>(T &t) {
+      // Strict results are the same bits on any number of threads.
+      const std::size_t n = 100003;
+      std::vector<second> time;
+      std::vector<watt> power;
+      std::vector<metre> position;
+      for (std::size_t i = 0; i < n; ++i) {
+        time.push_back(second((TU_TYPE)i * (TU_TYPE)0.01 + (TU_TYPE)1.0e-3 * (TU_TYPE)std::sin((double)i)));
+        power.push_back(watt((TU_TYPE)1000.0 + (TU_TYPE)100.0 * (TU_TYPE)std::sin(0.001 * (double)i)));
+        position.push_back(metre((TU_TYPE)std::cos(0.01 * (double)i)));
+      }
+      const std::span<const second> x(time);
+      const std::span<const watt> y(power);
+      const Unit<prefix::milli, second> dt(10.0f);
+      const joule strict = trapezoid(x, y, 1, policy::strict);
+      const joule strict_dx = trapezoid(y, dt, 1, policy::strict);
+      const joule strict_simpson = simpson(y, dt, 1, policy::strict);
+      std::vector<joule> running(n);
+      std::vector<joule> running_threads(n);
+      cumulative_trapezoid(x, y, std::span<joule>(running), 1, policy::strict);
+      std::vector<metre_per_second> v(n);
+      std::vector<metre_per_second> v_threads(n);
+      derivative(std::span<const second>(time), std::span<const metre>(position),
+                 std::span<metre_per_second>(v), 1, policy::strict);
+      for (std::size_t threads : {2, 3, 8}) {
+        t.assert_true(trapezoid(x, y, threads, policy::strict).base_value == strict.base_value, __LINE__);
+        t.assert_true(trapezoid(y, dt, threads, policy::strict).base_value == strict_dx.base_value, __LINE__);
+        t.assert_true(simpson(y, dt, threads, policy::strict).base_value == strict_simpson.base_value, __LINE__);
+        cumulative_trapezoid(x, y, std::span<joule>(running_threads), threads, policy::strict);
+        t.assert_true(std::equal(running.begin(), running.end(), running_threads.begin(), [](const joule& a, const joule& b) {
+          return a.base_value == b.base_value;
+        }), __LINE__);
+        derivative(std::span<const second>(time), std::span<const metre>(position),
+                   std::span<metre_per_second>(v_threads), threads, policy::strict);
+        t.assert_true(std::equal(v.begin(), v.end(), v_threads.begin(), [](const metre_per_second& a, const metre_per_second& b) {
+          return a.base_value == b.base_value;
+        }), __LINE__);
+      }
+      t.assert_true(running[n - 1].base_value == strict.base_value || std::abs(running[n - 1].base_value - strict.base_value) < (TU_TYPE)1.0e-3 * strict.base_value, __LINE__);
+
+      // Fast results agree within rounding.
+      const joule fast = trapezoid(x, y, 4, policy::fast);
+      t.assert_true(std::abs(fast.base_value - strict.base_value) < (TU_TYPE)1.0e-4 * strict.base_value, __LINE__);
+      t.assert_true(std::abs(simpson(y, dt, 4).base_value - strict_simpson.base_value) < (TU_TYPE)1.0e-4 * strict_simpson.base_value, __LINE__);
+
+      // Default_policy selects the strict policy for results in weber.
+      std::vector<volt> u;
+      for (const watt& p : power) {
+        u.push_back(volt(p.base_value));
+      }
+      const weber flux = trapezoid(std::span<const volt>(u), dt, 1);
+      t.assert_true(flux.base_value == trapezoid(std::span<const volt>(u), dt, 1, policy::strict).base_value, __LINE__);
+      t.assert_true(flux.base_value == trapezoid(std::span<const volt>(u), dt, 8).base_value, __LINE__);
+    }
+  );
+
+  Test<"Reproducible sum">(
+    []<typename T>(T &t) {
+      // Terms of seven orders of magnitude with both signs.
+      const std::size_t n = 50001;
+      std::vector<Unit<prefix::kilo, joule>> energy;
+      std::vector<Unit<prefix::kilo, joule>> shuffled;
+      for (std::size_t i = 0; i < n; ++i) {
+        energy.push_back(Unit<prefix::kilo, joule>((TU_TYPE)(std::sin((double)i) * std::pow(10.0, (double)(i % 7) - 3.0))));
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        shuffled.push_back(energy[i * 7919 % n]);
+      }
+      long double exact = 0.0L;
+      for (const auto& e : energy) {
+        exact += e.base_value;
+      }
+      const std::span<const Unit<prefix::kilo, joule>> values(energy);
+      const joule total = sum(values, 1, policy::reproducible);
+      t.assert_true(std::abs(total.base_value - exact) <= std::numeric_limits<TU_TYPE>::epsilon() * std::abs(exact), __LINE__);
+
+      // The same bits on any number of threads and in any order.
+      for (std::size_t threads : {2, 3, 8}) {
+        t.assert_true(sum(values, threads, policy::reproducible).base_value == total.base_value, __LINE__);
+      }
+      t.assert_true(sum(std::span<const Unit<prefix::kilo, joule>>(shuffled), 4, policy::reproducible).base_value == total.base_value, __LINE__);
+      std::vector<Unit<prefix::kilo, joule>> reversed;
+      for (std::size_t i = n; i-- > 0;) {
+        reversed.push_back(energy[i]);
+      }
+      t.assert_true(sum(std::span<const Unit<prefix::kilo, joule>>(reversed), 1, policy::reproducible).base_value == total.base_value, __LINE__);
+
+      // Cancellation is exact within the folds.
+      std::vector<second> cancel{second(1.0e6f), second(1.0f), second(-1.0e6f), second(0.5f)};
+      t.assert_true(sum(std::span<const second>(cancel), 1, policy::reproducible) == second(1.5f), __LINE__);
+      t.assert_true(sum(std::span<const second>(cancel).first(0), 1, policy::reproducible) == second(0.0f), __LINE__);
+
+      // Integrals use the policy too.
+      const Unit<prefix::milli, second> dt(10.0f);
+      const auto area = trapezoid(values, dt, 1, policy::reproducible);
+      t.assert_true(trapezoid(values, dt, 8, policy::reproducible).base_value == area.base_value, __LINE__);
+
+      // Terms that are not finite give the strict sum.
+      cancel.push_back(second(std::numeric_limits<TU_TYPE>::infinity()));
+      t.assert_true(std::isinf(sum(std::span<const second>(cancel), 1, policy::reproducible).base_value), __LINE__);
+      cancel.push_back(second(std::numeric_limits<TU_TYPE>::quiet_NaN()));
+      t.assert_true(std::isnan(sum(std::span<const second>(cancel), 1, policy::reproducible).base_value), __LINE__);
+    }
+  );
+
+  Test<"Constrained">(
+    []<typename T>(T &t) {
+      static int reports = 0;
+      const Constraint_handler previous = set_constraint_handler([](const Constraint_report&) { ++reports; });
+
+      using Temperature = Non_negative<kelvin>;
+      using Phase = Constrained<radian, 0.0f, 2.0f * PI, interval::right_open>;
+
+      // Checked at construction.
+      const Temperature room(Unit<prefix::no_prefix, degree_Celsius>(25.0f));
+      t.assert_true(room.base_value == kelvin(Unit<prefix::no_prefix, degree_Celsius>(25.0f)).base_value && reports == 0, __LINE__);
+      const Temperature below(kelvin(-1.0f));
+      t.assert_true(below.base_value == 0.0f && reports == 1, __LINE__);
+      const Phase full(radian(2.0f * PI));
+      t.assert_true(full.base_value < 2.0f * PI && Phase::contains(full.base_value) && reports == 2, __LINE__);
+      const Temperature missing(kelvin(std::numeric_limits<TU_TYPE>::quiet_NaN()));
+      t.assert_true(std::isinf(missing.base_value) && reports == 3, __LINE__);
+
+      // Results with bounds proven at compile time are not checked again.
+      const auto twice = room + room;
+      static_assert(std::is_same_v<decltype(twice), const Temperature>);
+      t.assert_true(twice.base_value == 2.0f * room.base_value, __LINE__);
+      const Constrained<radian, -1.0f, 0.5f> swing(radian(-0.75f));
+      const auto amplitude = abs(swing);
+      static_assert(std::is_same_v<decltype(amplitude), const Constrained<radian, 0.0f, 1.0f>>);
+      t.assert_true(amplitude.base_value == 0.75f, __LINE__);
+      static_assert(std::is_same_v<decltype(abs(room)), Temperature>);
+      static_assert(std::is_same_v<decltype(-swing), Constrained<radian, -0.5f, 1.0f>>);
+      const Phase wrapped = clamp<Phase>(radian(7.0f));
+      t.assert_true(Phase::contains(wrapped.base_value), __LINE__);
+      t.assert_true(clamp<Phase>(radian(-1.0f)).base_value == 0.0f, __LINE__);
+      const auto span = wrapped - clamp<Phase>(radian(1.0f));
+      t.assert_true(span.min == -2.0f * PI && span.max == 2.0f * PI && span.range == interval::closed, __LINE__);
+
+      // Conversions to a wider interval are not checked, to a narrower one are.
+      const Constrained<kelvin, 0.0f, 1000.0f> oven(room);
+      const Temperature back(oven);
+      t.assert_true(back.base_value == room.base_value && reports == 3, __LINE__);
+      const Constrained<kelvin, 0.0f, 100.0f> cold(oven);
+      t.assert_true(cold.base_value == 100.0f && reports == 4, __LINE__);
+
+      // Any other operation gives the plain unit.
+      const kelvin hotter = room * scalar(2.0f);
+      t.assert_true(hotter == kelvin(2.0f * room.base_value), __LINE__);
+
+      set_constraint_handler(previous);
+    }
+  );
+
+  Test<"Optional quantity">(
+    []<typename T>(T &t) {
+      using Power = Unit<prefix::kilo, watt>;
+      static_assert(sizeof(Optional_quantity<Power>) == sizeof(TU_TYPE));
+
+      Optional_quantity<Power> missing;
+      const Optional_quantity<Power> present(Power(1.5f));
+      t.assert_true(!missing.has_value() && !missing && std::isnan(missing.raw()), __LINE__);
+      t.assert_true(present.has_value() && present.raw() == 1.5f && present.value().base_value == 1500.0f, __LINE__);
+      t.assert_true(std::abs(missing.value_or(watt(3.0f)).base_value - 3.0f) < 1.0e-5f, __LINE__);
+      missing = watt(2000.0f);
+      t.assert_true(missing.has_value() && std::abs(missing.raw() - 2.0f) < 1.0e-6f, __LINE__);
+      missing = std::nullopt;
+      t.assert_true(!missing.has_value(), __LINE__);
+
+      // A NaN result is a present value.
+      const Optional_quantity<Power> nan(Power(std::numeric_limits<TU_TYPE>::quiet_NaN()));
+      t.assert_true(nan.has_value(), __LINE__);
+
+      // Telemetry with gaps.
+      const std::size_t n = 1003;
+      std::vector<Optional_quantity<Power>> power(n);
+      TU_TYPE expected = 0.0f;
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        if (i % 3 != 0) {
+          power[i] = Power((TU_TYPE)(i % 7) - 2.0f);
+          expected += ((TU_TYPE)(i % 7) - 2.0f) * 1000.0f;
+          ++count;
+        }
+      }
+      const std::span<const Optional_quantity<Power>> values(power);
+      const auto mask_storage = std::make_unique<bool[]>(n);
+      const std::span<bool> mask(mask_storage.get(), n);
+      is_present(values, mask);
+      bool masks_match = true;
+      for (std::size_t i = 0; i < n; ++i) {
+        masks_match = masks_match && mask[i] == (i % 3 != 0);
+      }
+      t.assert_true(masks_match && count_present(values) == count, __LINE__);
+      t.assert_true(sum(values) == watt(expected), __LINE__);
+      t.assert_true(sum(values, 4, policy::reproducible) == sum(values, 1, policy::reproducible), __LINE__);
+      t.assert_true(std::abs(mean(values).value().base_value - expected / (TU_TYPE)count) < 1.0e-3f, __LINE__);
+      t.assert_true(min(values).value() == watt(-2000.0f) && max(values).value() == watt(4000.0f), __LINE__);
+
+      // Reductions of nothing present.
+      const std::vector<Optional_quantity<Power>> gaps(5);
+      const std::span<const Optional_quantity<Power>> none(gaps);
+      t.assert_true(sum(none) == watt(0.0f) && count_present(none) == 0, __LINE__);
+      t.assert_true(!mean(none) && !min(none) && !max(none), __LINE__);
+
+      // Units with an offset.
+      const std::vector<Optional_quantity<Unit<prefix::no_prefix, degree_Celsius>>> temperature{
+        Unit<prefix::no_prefix, degree_Celsius>(20.0f), std::nullopt, Unit<prefix::no_prefix, degree_Celsius>(-10.0f)};
+      const std::span<const Optional_quantity<Unit<prefix::no_prefix, degree_Celsius>>> celsius(temperature);
+      t.assert_true(std::abs(max(celsius).value().base_value - 293.15f) < 1.0e-3f, __LINE__);
+      t.assert_true(std::abs(min(celsius).value().base_value - 263.15f) < 1.0e-3f, __LINE__);
+    }
+  );
+
+  Test<"Metrics">(
+    []<typename T>(T &t) {
+      static_assert(std::string_view(internal::metric_unit_of<Unit<prefix::milli, second>>()) == "seconds");
+      static_assert(std::string_view(internal::metric_unit_of<Unit<prefix::kilo, electronvolt>>()) == "joules");
+      static_assert(std::string_view(internal::metric_unit_of<volt>()) == "volts");
+      static_assert(std::string_view(internal::metric_unit_of<scalar>()) == "");
+      static_assert(std::string_view(internal::metric_unit_of<Quotient_unit<metre_per_second, second>>()) == "meters_per_second_squared");
+      static_assert(std::string_view(internal::metric_unit_of<Quotient_unit<kilogram, metre_cubed>>()) == "kilograms_per_meter_cubed");
+      static_assert(std::string_view(internal::metric_unit_of<Quotient_unit<scalar, second_squared>>()) == "per_second_squared");
+      static_assert(std::string_view(internal::metric_unit_of<Power_unit<metre, std::ratio<1, 2>>>()) == "meters_pow_1_2");
+
+      Metrics_registry metrics;
+      auto latency = metrics.histogram<Unit<prefix::milli, second>>("request_duration", "Request latency.",
+                                                                     {second(0.25f), second(1.0f)}, {{"path", "/a\"b"}});
+      auto energy = metrics.counter<Unit<prefix::kilo, joule>>("cpu_energy", "Energy used\nby the \"CPU\".");
+      auto temperature = metrics.gauge<Unit<prefix::no_prefix, degree_Celsius>>("room_temperature", "Temperature.", {{"room", "1"}});
+      auto received = metrics.counter<scalar>("received_bytes", "Received bytes.");
+      auto uptime = metrics.gauge<second>("uptime_seconds", "");
+      latency.observe(Unit<prefix::milli, second>(125.0f));
+      latency.observe(second(0.5f));
+      latency.observe(second(2.0f));
+      energy.add(Unit<prefix::kilo, joule>(1.5f));
+      energy.add(joule(500.0f));
+      temperature.set(kelvin(290.5f));
+      received.add(scalar(1024.0f));
+      uptime.set(Unit<prefix::no_prefix, minute>(2.0f));
+      t.assert_true(energy.get() == joule(2000.0f) && uptime.get() == second(120.0f), __LINE__);
+
+      // The same name and labels give the same series.
+      metrics.gauge<second>("uptime", "").add(second(1.0f));
+      t.assert_true(metrics.series() == 5 && uptime.get() == second(121.0f), __LINE__);
+
+      const std::string_view expected =
+        "# TYPE request_duration_seconds histogram\n"
+        "# UNIT request_duration_seconds seconds\n"
+        "# HELP request_duration_seconds Request latency.\n"
+        "request_duration_seconds_bucket{path=\"/a\\\"b\",le=\"0.25\"} 1\n"
+        "request_duration_seconds_bucket{path=\"/a\\\"b\",le=\"1\"} 2\n"
+        "request_duration_seconds_bucket{path=\"/a\\\"b\",le=\"+Inf\"} 3\n"
+        "request_duration_seconds_count{path=\"/a\\\"b\"} 3\n"
+        "request_duration_seconds_sum{path=\"/a\\\"b\"} 2.625\n"
+        "# TYPE cpu_energy_joules counter\n"
+        "# UNIT cpu_energy_joules joules\n"
+        "# HELP cpu_energy_joules Energy used\\nby the \\\"CPU\\\".\n"
+        "cpu_energy_joules_total 2000\n"
+        "# TYPE room_temperature_kelvin gauge\n"
+        "# UNIT room_temperature_kelvin kelvin\n"
+        "# HELP room_temperature_kelvin Temperature.\n"
+        "room_temperature_kelvin{room=\"1\"} 290.5\n"
+        "# TYPE received_bytes counter\n"
+        "# HELP received_bytes Received bytes.\n"
+        "received_bytes_total 1024\n"
+        "# TYPE uptime_seconds gauge\n"
+        "# UNIT uptime_seconds seconds\n"
+        "uptime_seconds 121\n"
+        "# EOF\n";
+      t.assert_true(metrics.render() == expected, __LINE__);
+
+      // The buffer is reused and values that are not finite are rendered as such.
+      uptime.set(second(std::numeric_limits<TU_TYPE>::infinity()));
+      temperature.set(kelvin(std::numeric_limits<TU_TYPE>::quiet_NaN()));
+      const std::string_view text = metrics.render();
+      t.assert_true(text.find("uptime_seconds +Inf\n") != std::string_view::npos, __LINE__);
+      t.assert_true(text.find("room_temperature_kelvin{room=\"1\"} NaN\n") != std::string_view::npos, __LINE__);
+
+      // NaN is counted in the unbounded bucket.
+      Metrics_registry nan_metrics;
+      nan_metrics.histogram<second>("wait", "", {second(1.0f)}).observe(second(std::numeric_limits<TU_TYPE>::quiet_NaN()));
+      const std::string_view nan_text = nan_metrics.render();
+      t.assert_true(nan_text.find("wait_seconds_bucket{le=\"1\"} 0\n") != std::string_view::npos, __LINE__);
+      t.assert_true(nan_text.find("wait_seconds_bucket{le=\"+Inf\"} 1\n") != std::string_view::npos, __LINE__);
+    }
+  );
+
     return Test_stats::fail;
 }
\ No newline at end of file
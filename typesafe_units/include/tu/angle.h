@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+//
+// Ranges that wrapped angles are normalized to.
+//   positive:  [0, 2 pi)
+//   symmetric: (-pi, pi]
+//
+enum struct angle_range {
+  positive,
+  symmetric
+};
+
+namespace internal {
+template<typename V>
+concept Angle = std::derived_from<V, Unit_fundament> && std::is_same<typename V::Base, radian::Base>::value;
+
+//
+// Reduce x to the range r of a turn of `period`, e.g. 2 pi for radians or 360
+// for degrees, without fmod and without branches so that loops over it can
+// be vectorized.
+// The number of turns is rounded by adding and subtracting 1.5 * 2^(digits - 1),
+// which is exact for angles below 2^(digits - 2) turns, i.e. far beyond where
+// TU_TYPE can resolve an angle. A negative remainder is moved up by a period
+// using its sign bit as a mask. Comparisons are avoided since GCC does not
+// vectorize selects on floating point conditions unless compiled with
+// -fno-trapping-math.
+// In the symmetric range the number of turns is rounded to nearest, so angles
+// that are already in range are returned unchanged, and a remainder beyond an
+// end of the range is moved by a period with masks from its bits.
+//
+template<angle_range r>
+constexpr TU_TYPE wrap_period(TU_TYPE x, TU_TYPE period) noexcept {
+  using Bits = std::conditional_t<std::is_same_v<TU_TYPE, float>, std::uint32_t, std::uint64_t>;
+  const TU_TYPE half = (TU_TYPE)0.5 * period;
+  const TU_TYPE inv_period = (TU_TYPE)1.0 / period;
+  constexpr TU_TYPE shifter = (TU_TYPE)1.5 / std::numeric_limits<TU_TYPE>::epsilon();
+  constexpr int sign_shift = sizeof(Bits) * 8 - 1;
+  const TU_TYPE nearest = (x * inv_period + shifter) - shifter;
+  if constexpr (r == angle_range::positive) {
+    // Adding 0 turns a remainder of -0 into +0.
+    const TU_TYPE y = (x - period * nearest) + (TU_TYPE)0.0;
+    const Bits negative = (Bits)0 - (std::bit_cast<Bits>(y) >> sign_shift);
+    // Rounding can give exactly a period. Non-negative values order like their
+    // bit patterns, so the upper end is excluded with an integer min.
+    const TU_TYPE z = y + std::bit_cast<TU_TYPE>(std::bit_cast<Bits>(period) & negative);
+    return std::bit_cast<TU_TYPE>(std::min(std::bit_cast<Bits>(z), std::bit_cast<Bits>(period) - 1));
+  } else {
+    const TU_TYPE y = x - period * nearest;
+    // Magnitudes order like their bit patterns, so -half and below resp.
+    // above half are found with integer comparisons.
+    const Bits bits = std::bit_cast<Bits>(y);
+    const Bits sign = bits >> sign_shift;
+    const Bits magnitude = bits & ~((Bits)1 << sign_shift);
+    const Bits below = (Bits)0 - (sign & (Bits)(magnitude >= std::bit_cast<Bits>(half)));
+    const Bits above = (Bits)0 - ((sign ^ (Bits)1) & (Bits)(magnitude > std::bit_cast<Bits>(half)));
+    return y + std::bit_cast<TU_TYPE>(std::bit_cast<Bits>(period) & below) - std::bit_cast<TU_TYPE>(std::bit_cast<Bits>(period) & above);
+  }
+}
+
+template<angle_range r>
+constexpr TU_TYPE wrap_radian(TU_TYPE x) noexcept {
+  return wrap_period<r>(x, (TU_TYPE)2.0 * std::numbers::pi_v<TU_TYPE>);
+}
+
+//
+// A turn in the angle unit V, e.g. 360 for degree and 1296000 for
+// arc_second. The quotient of 2 pi and the rounded multiplier of V is rounded
+// to a whole number when it is one but for that rounding, so that turns of
+// degrees, arc minutes and arc seconds are exact.
+//
+template<typename V>
+constexpr TU_TYPE turn() noexcept {
+  const long double period = 2.0L * std::numbers::pi_v<long double> / (long double)Unit_scale<V>::multiplier;
+  const long double whole = (long double)(long long)(period + 0.5L);
+  const long double tolerance = 8.0L * (long double)std::numeric_limits<TU_TYPE>::epsilon() * period;
+  return (TU_TYPE)(period - whole <= tolerance && whole - period <= tolerance ? whole : period);
+}
+} // namespace internal
+
+//
+// Plane angle that is normalized to the range r on construction and after
+// every operation. The angle is stored in radians and can be used wherever a
+// radian is expected. Arithmetic with other angle units e.g. degree,
+// arc_minute or arc_second gives a wrapped angle.
+//
+// Example:
+//   Wrapped_angle<angle_range::symmetric> heading(Unit<prefix::no_prefix, degree>(350.0f));
+//   auto turned = heading + Unit<prefix::no_prefix, degree>(20.0f);
+//   std::cout << Unit<prefix::no_prefix, degree>(turned).value << std::endl; // prints 10
+//
+template<angle_range r>
+struct Wrapped_angle : radian::Base {
+  static constexpr angle_range range = r;
+
+  constexpr Wrapped_angle() noexcept = default;
+  Wrapped_angle(TU_TYPE v) noexcept : radian::Base(internal::wrap_radian<r>(v)) {}
+
+  template<internal::Angle V>
+  Wrapped_angle(const V& v) noexcept : radian::Base(internal::wrap_radian<r>(v.base_value)) {}
+};
+
+template<angle_range r>
+Wrapped_angle<r> operator + (const Wrapped_angle<r>& l, const Wrapped_angle<r>& r_) noexcept {
+  return {l.base_value + r_.base_value};
+}
+
+template<angle_range r, internal::Angle V>
+Wrapped_angle<r> operator + (const Wrapped_angle<r>& l, const V& r_) noexcept {
+  return {l.base_value + r_.base_value};
+}
+
+template<angle_range r, internal::Angle V>
+Wrapped_angle<r> operator + (const V& l, const Wrapped_angle<r>& r_) noexcept {
+  return {l.base_value + r_.base_value};
+}
+
+template<angle_range r>
+Wrapped_angle<r> operator - (const Wrapped_angle<r>& l, const Wrapped_angle<r>& r_) noexcept {
+  return {l.base_value - r_.base_value};
+}
+
+template<angle_range r, internal::Angle V>
+Wrapped_angle<r> operator - (const Wrapped_angle<r>& l, const V& r_) noexcept {
+  return {l.base_value - r_.base_value};
+}
+
+template<angle_range r, internal::Angle V>
+Wrapped_angle<r> operator - (const V& l, const Wrapped_angle<r>& r_) noexcept {
+  return {l.base_value - r_.base_value};
+}
+
+template<angle_range r>
+Wrapped_angle<r> operator - (const Wrapped_angle<r>& a) noexcept {
+  return {-a.base_value};
+}
+
+//
+// The shortest signed rotation from `from` to `to` in (-pi, pi].
+// Example:
+//   shortest_difference(Unit<prefix::no_prefix, degree>(10.0f), Unit<prefix::no_prefix, degree>(350.0f)) // 20 degrees in radians
+//
+template<internal::Angle To, internal::Angle From>
+Wrapped_angle<angle_range::symmetric> shortest_difference(const To& to, const From& from) noexcept {
+  return {to.base_value - from.base_value};
+}
+
+//
+// The angle a normalized to the range r in its own unit, e.g. to [0, 360) for
+// degrees, so that whole turns of degrees, arc minutes and arc seconds are
+// removed exactly. A Wrapped_angle is reduced in radians instead, by a
+// rounded 2 pi.
+// Example:
+//   wrap<angle_range::positive>(Unit<prefix::no_prefix, arc_second>(2592001.0f)).value // 1
+//
+template<angle_range r, prefix pf, typename A>
+requires internal::Angle<Unit<pf, A>>
+Unit<pf, A> wrap(const Unit<pf, A>& a) noexcept {
+  return Unit<pf, A>(internal::wrap_period<r>(a.value, internal::turn<Unit<pf, A>>()));
+}
+
+//
+// Batch normalization out[i] = Wrapped_angle<r>(in[i]).
+// Both spans must have the same size.
+//
+template<angle_range r, internal::Angle V>
+void wrap(std::span<const V> in, std::span<Wrapped_angle<r>> out) noexcept {
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    std::construct_at(&out[i], in[i].base_value);
+  }
+}
+
+//
+// Batch shortest signed difference out[i] = shortest_difference(to[i], from[i]).
+// All spans must have the same size.
+//
+template<internal::Angle To, internal::Angle From>
+void shortest_difference(std::span<const To> to, std::span<const From> from, std::span<Wrapped_angle<angle_range::symmetric>> out) noexcept {
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    std::construct_at(&out[i], to[i].base_value - from[i].base_value);
+  }
+}
+
+} // namespace tu
@@ -0,0 +1,666 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "policy.h"
+
+namespace tu {
+
+namespace internal {
+//
+// Number of partial sums in `lane_sum`.
+//
+inline constexpr std::size_t sum_lanes = 8;
+
+//
+// Smallest number of terms given to a thread.
+//
+inline constexpr std::size_t thread_terms = 4096;
+
+//
+// Sum of term(i) for i in [first, last). The terms are added to sum_lanes
+// partial sums so that the compiler can vectorize the loop without
+// reassociating floating point additions.
+//
+template<typename F>
+TU_TYPE lane_sum(const F& term, std::size_t first, std::size_t last) noexcept {
+  std::array<TU_TYPE, sum_lanes> partial{};
+  // Counting from 0 keeps the bound from wrapping around.
+  const std::size_t count = last - first;
+  std::size_t k = 0;
+  for (; k + sum_lanes <= count; k += sum_lanes) {
+    for (std::size_t l = 0; l < sum_lanes; ++l) {
+      partial[l] += term(first + k + l);
+    }
+  }
+  TU_TYPE sum = (TU_TYPE)0.0;
+  for (; k < count; ++k) {
+    sum += term(first + k);
+  }
+  for (std::size_t l = 0; l < sum_lanes; ++l) {
+    sum += partial[l];
+  }
+  return sum;
+}
+
+//
+// Number of threads to use for n terms.
+//
+inline std::size_t thread_count(std::size_t n, std::size_t threads) noexcept {
+  return std::max(std::min(threads, n / thread_terms), (std::size_t)1);
+}
+
+//
+// Number of terms in a block of `strict_sum`.
+//
+inline constexpr std::size_t strict_block = 1024;
+
+//
+// lane_sum of term(i) for i in [first, last), at most strict_block terms.
+// The terms are stored before they are added, so that they are rounded and
+// not contracted with the additions.
+//
+template<typename F>
+TU_TYPE block_sum(const F& term, std::size_t first, std::size_t last) noexcept {
+  std::array<TU_TYPE, strict_block> terms;
+  for (std::size_t i = first; i < last; ++i) {
+    terms[i - first] = term(i);
+  }
+  memory_barrier(terms.data());
+  return lane_sum([&terms](std::size_t i) { return terms[i]; }, 0, last - first);
+}
+
+//
+// Sum of term(i) for i in [0, n) in blocks of strict_block terms, which are
+// added in order. The blocks are split between `threads` threads, which does
+// not change the result.
+//
+template<typename F>
+TU_TYPE strict_sum(const F& term, std::size_t n, std::size_t threads) {
+  const std::size_t blocks = (n + strict_block - 1) / strict_block;
+  const auto block = [&term, n](std::size_t b) {
+    return block_sum(term, b * strict_block, std::min((b + 1) * strict_block, n));
+  };
+  threads = thread_count(n, threads);
+  TU_TYPE sum = (TU_TYPE)0.0;
+  if (threads == 1) {
+    for (std::size_t b = 0; b < blocks; ++b) {
+      sum += block(b);
+    }
+    return sum;
+  }
+  std::vector<TU_TYPE> partial(blocks);
+  const auto range = [&](std::size_t t) {
+    for (std::size_t b = blocks * t / threads; b < blocks * (t + 1) / threads; ++b) {
+      partial[b] = block(b);
+    }
+  };
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+      workers.push_back(worker(range, t));
+    }
+    range(0);
+  }
+  for (const TU_TYPE p : partial) {
+    sum += p;
+  }
+  return sum;
+}
+
+//
+// Largest number of folds of `reproducible_sum`.
+//
+inline constexpr std::size_t max_folds = 4;
+
+//
+// Levels of the folds of `reproducible_sum` of n terms. The terms of level l
+// are below 2^(top - l * bits). Adding 1.5 * 2^(top - l * bits + 1 + headroom)
+// to them and subtracting it again rounds them to a multiple of
+// 2^(top - (l + 1) * bits + 1), which leaves remainders below the bound of
+// level l + 1. The headroom keeps the sums of up to n rounded terms exact in
+// double. Enough folds are used for an error below half an ulp of the
+// largest term, for up to about 2^30 terms.
+//
+struct Fold_ladder {
+  explicit Fold_ladder(std::size_t n) noexcept
+  : headroom((int)std::bit_width(n)), bits(std::numeric_limits<double>::digits - 1 - headroom),
+    top(std::numeric_limits<double>::max_exponent - 2 - headroom),
+    folds(std::min((std::size_t)((std::numeric_limits<TU_TYPE>::digits + headroom + bits) / bits), max_folds)),
+    finest((top + headroom + 1 - std::numeric_limits<double>::min_exponent) / bits - (int)folds + 1) {}
+
+  //
+  // Coarsest level of the folds of terms up to max, or -1 if max is too large.
+  //
+  int level(double max) const noexcept {
+    int e;
+    std::frexp(max, &e);
+    return e > top ? -1 : std::min((top - e) / bits, finest);
+  }
+
+  //
+  // The number added and subtracted to round the terms of level l.
+  //
+  double rounder(int l) const noexcept {
+    return std::ldexp(1.5, top - l * bits + 1 + headroom);
+  }
+
+  int headroom;
+  int bits;
+  int top;
+  std::size_t folds;
+  // Finest coarsest level, which keeps the rounders of all folds normal.
+  int finest;
+};
+
+//
+// Exact sums of the folds from `level` on. Sums at different levels are
+// merged at the coarser one, dropping the folds beyond its finest fold, which
+// gives the same result in any order.
+//
+struct Fold_sums {
+  explicit Fold_sums(std::size_t folds) noexcept : folds(folds) {}
+
+  void merge(const Fold_sums& other) noexcept {
+    finite = finite && other.finite;
+    if (other.level < level) {
+      Fold_sums coarser = other;
+      coarser.finite = finite;
+      coarser.add(*this);
+      *this = coarser;
+    } else {
+      add(other);
+    }
+  }
+
+  std::size_t folds;
+  int level = std::numeric_limits<int>::max();
+  bool finite = true;
+  std::array<double, max_folds> sum{};
+
+private:
+  // Add the folds of the finer or equal sums `other`.
+  void add(const Fold_sums& other) noexcept {
+    const long long shift = (long long)other.level - level;
+    for (std::size_t f = 0; (long long)f + shift < (long long)folds; ++f) {
+      sum[f + shift] += other.sum[f];
+    }
+  }
+};
+
+//
+// Adds the folds of term(i) for i in [first, last), at most strict_block
+// terms, to sums. The folds start at the level of the largest term, so that
+// blocks of small terms keep their precision.
+//
+template<typename F>
+void fold_block(const F& term, std::size_t first, std::size_t last, const Fold_ladder& ladder, Fold_sums& sums) noexcept {
+  // The terms with their largest absolute value, and NaN if one is not
+  // finite.
+  std::array<TU_TYPE, strict_block> terms;
+  std::array<TU_TYPE, sum_lanes> lane_max{};
+  std::array<TU_TYPE, sum_lanes> lane_nan{};
+  const std::size_t n = last - first;
+  const auto add = [&](std::size_t i, std::size_t l) {
+    terms[i] = term(first + i);
+    const TU_TYPE a = std::abs(terms[i]);
+    lane_max[l] = a > lane_max[l] ? a : lane_max[l];
+    lane_nan[l] += terms[i] * (TU_TYPE)0.0;
+  };
+  std::size_t i = 0;
+  for (; i + sum_lanes <= n; i += sum_lanes) {
+    for (std::size_t l = 0; l < sum_lanes; ++l) {
+      add(i + l, l);
+    }
+  }
+  for (; i < n; ++i) {
+    add(i, 0);
+  }
+  memory_barrier(terms.data());
+  TU_TYPE max = (TU_TYPE)0.0;
+  for (std::size_t l = 0; l < sum_lanes; ++l) {
+    max = std::max(max, lane_max[l]) + lane_nan[l];
+  }
+  Fold_sums block(ladder.folds);
+  block.level = std::isfinite(max) ? ladder.level((double)max) : -1;
+  if (block.level < 0) {
+    sums.finite = false;
+    return;
+  }
+
+  // One pass per fold over the remainders, which stay in the cache. The first
+  // fold reads the terms and the last does not store its remainders.
+  std::array<double, strict_block> remainder;
+  const auto pass = [&](auto from_terms, auto store, std::size_t f) {
+    const double r = ladder.rounder(block.level + (int)f);
+    std::array<double, sum_lanes> partial{};
+    const auto fold = [&](std::size_t i, std::size_t l) {
+      double x;
+      if constexpr (from_terms) {
+        x = (double)terms[i];
+      } else {
+        x = remainder[i];
+      }
+      const double q = (r + x) - r;
+      if constexpr (store) {
+        remainder[i] = x - q;
+      }
+      partial[l] += q;
+    };
+    std::size_t i = 0;
+    for (; i + sum_lanes <= n; i += sum_lanes) {
+      for (std::size_t l = 0; l < sum_lanes; ++l) {
+        fold(i + l, l);
+      }
+    }
+    for (; i < n; ++i) {
+      fold(i, 0);
+    }
+    for (std::size_t l = 0; l < sum_lanes; ++l) {
+      block.sum[f] += partial[l];
+    }
+  };
+  if (ladder.folds == 1) {
+    pass(std::true_type(), std::false_type(), 0);
+  } else {
+    pass(std::true_type(), std::true_type(), 0);
+    for (std::size_t f = 1; f + 1 < ladder.folds; ++f) {
+      pass(std::false_type(), std::true_type(), f);
+    }
+    pass(std::false_type(), std::false_type(), ladder.folds - 1);
+  }
+  sums.merge(block);
+}
+
+//
+// Sum of term(i) for i in [0, n) that is the same bits whatever the order of
+// the terms. The terms are rounded to the fixed multiples of the folds of
+// Fold_ladder, and the multiples are added exactly in double, with an error
+// below half an ulp of the largest term before the final rounding. Sums with
+// terms that are not finite or close to the largest double are
+// added with strict_sum instead.
+//
+template<typename F>
+TU_TYPE reproducible_sum(const F& term, std::size_t n, std::size_t threads) {
+  const Fold_ladder ladder(n);
+  const std::size_t blocks = (n + strict_block - 1) / strict_block;
+  const auto range = [&](std::size_t first, std::size_t last, Fold_sums& sums) {
+    for (std::size_t b = first; b < last; ++b) {
+      fold_block(term, b * strict_block, std::min((b + 1) * strict_block, n), ladder, sums);
+    }
+  };
+  threads = thread_count(n, threads);
+  Fold_sums total(ladder.folds);
+  if (threads == 1) {
+    range(0, blocks, total);
+  } else {
+    std::vector<Fold_sums> partial(threads, total);
+    {
+      std::vector<std::jthread> workers;
+      workers.reserve(threads - 1);
+      for (std::size_t t = 1; t < threads; ++t) {
+        workers.push_back(worker(range, blocks * t / threads, blocks * (t + 1) / threads, std::ref(partial[t])));
+      }
+      range(0, blocks / threads, partial[0]);
+    }
+    for (const Fold_sums& p : partial) {
+      total.merge(p);
+    }
+  }
+  if (!total.finite) {
+    return strict_sum(term, n, threads);
+  }
+  double sum = 0.0;
+  for (const double s : total.sum) {
+    sum += s;
+  }
+  return (TU_TYPE)sum;
+}
+
+//
+// Sum of term(i) for i in [0, n) on `threads` threads with the policy P.
+//
+template<Policy P, typename F>
+TU_TYPE parallel_sum(const F& term, std::size_t n, std::size_t threads) {
+  if constexpr (std::same_as<Arithmetic<P>, policy::Strict>) {
+    return strict_sum(term, n, threads);
+  }
+  if constexpr (std::same_as<Arithmetic<P>, policy::Reproducible>) {
+    return reproducible_sum(term, n, threads);
+  }
+  threads = thread_count(n, threads);
+  if (threads == 1) {
+    return lane_sum(term, 0, n);
+  }
+  std::vector<TU_TYPE> partial(threads);
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+      workers.push_back(worker([&, t] { partial[t] = lane_sum(term, n * t / threads, n * (t + 1) / threads); }));
+    }
+    partial[0] = lane_sum(term, 0, n / threads);
+  }
+  TU_TYPE sum = (TU_TYPE)0.0;
+  for (const TU_TYPE p : partial) {
+    sum += p;
+  }
+  return sum;
+}
+
+//
+// parallel_cumulative_sum in blocks of strict_block terms. Each block is
+// summed on its own and offset by the sum of the blocks before it, so the
+// result does not depend on the number of threads.
+//
+template<typename U, typename F>
+void strict_cumulative_sum(const F& increment, std::span<U> out, std::size_t threads) {
+  const std::size_t n = out.size();
+  const std::size_t blocks = (n + strict_block - 1) / strict_block;
+  const auto block = [&increment, out, n](std::size_t b, TU_TYPE offset) {
+    TU_TYPE sum = (TU_TYPE)0.0;
+    for (std::size_t i = std::max(b * strict_block, (std::size_t)1); i < std::min((b + 1) * strict_block, n); ++i) {
+      sum += no_contract(increment(i));
+      store(out[i], sum + offset);
+    }
+    return sum;
+  };
+  threads = thread_count(n, threads);
+  store(out[0], (TU_TYPE)0.0);
+  if (threads == 1) {
+    TU_TYPE offset = (TU_TYPE)0.0;
+    for (std::size_t b = 0; b < blocks; ++b) {
+      offset += block(b, offset);
+    }
+    return;
+  }
+  std::vector<TU_TYPE> offset(blocks, (TU_TYPE)0.0);
+  const auto sum = [&](std::size_t t) {
+    for (std::size_t b = blocks * t / threads; b < blocks * (t + 1) / threads; ++b) {
+      offset[b] = block(b, (TU_TYPE)0.0);
+    }
+  };
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+      workers.push_back(worker(sum, t));
+    }
+    sum(0);
+  }
+  // offset[b] becomes the sum of the blocks before b.
+  TU_TYPE total = (TU_TYPE)0.0;
+  for (std::size_t b = 0; b < blocks; ++b) {
+    const TU_TYPE s = offset[b];
+    offset[b] = total;
+    total += s;
+  }
+  const auto shift = [&](std::size_t t) {
+    for (std::size_t b = std::max(blocks * t / threads, (std::size_t)1); b < blocks * (t + 1) / threads; ++b) {
+      for (std::size_t i = b * strict_block; i < std::min((b + 1) * strict_block, n); ++i) {
+        store(out[i], out[i].base_value + offset[b]);
+      }
+    }
+  };
+  std::vector<std::jthread> workers;
+  workers.reserve(threads - 1);
+  for (std::size_t t = 1; t < threads; ++t) {
+    workers.push_back(worker(shift, t));
+  }
+  shift(0);
+}
+
+//
+// out[i] = sum of increment(k) for k in [1, i] and out[0] = 0 on `threads`
+// threads with the policy P. Each thread sums a chunk, then the chunks are
+// offset by the sums of the chunks before them.
+//
+template<Policy P, typename U, typename F>
+void parallel_cumulative_sum(const F& increment, std::span<U> out, std::size_t threads) {
+  const std::size_t n = out.size();
+  if (n == 0) {
+    return;
+  }
+  if constexpr (!std::same_as<Arithmetic<P>, policy::Fast>) {
+    return strict_cumulative_sum(increment, out, threads);
+  }
+  threads = thread_count(n, threads);
+  store(out[0], (TU_TYPE)0.0);
+  if (threads == 1) {
+    TU_TYPE sum = (TU_TYPE)0.0;
+    for (std::size_t i = 1; i < n; ++i) {
+      sum += increment(i);
+      store(out[i], sum);
+    }
+    return;
+  }
+  std::vector<TU_TYPE> offset(threads + 1, (TU_TYPE)0.0);
+  const auto chunk = [&](std::size_t t) {
+    TU_TYPE sum = (TU_TYPE)0.0;
+    for (std::size_t i = std::max(n * t / threads, (std::size_t)1); i < n * (t + 1) / threads; ++i) {
+      sum += increment(i);
+      store(out[i], sum);
+    }
+    offset[t + 1] = sum;
+  };
+  const auto shift = [&](std::size_t t) {
+    for (std::size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) {
+      store(out[i], out[i].base_value + offset[t]);
+    }
+  };
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+      workers.push_back(worker(chunk, t));
+    }
+    chunk(0);
+  }
+  for (std::size_t t = 1; t <= threads; ++t) {
+    offset[t] += offset[t - 1];
+  }
+  std::vector<std::jthread> workers;
+  workers.reserve(threads - 1);
+  for (std::size_t t = 1; t < threads; ++t) {
+    workers.push_back(worker(shift, t));
+  }
+}
+} // namespace internal
+
+//
+// Sum of the values in their coherent unit on `threads` threads. With
+// `policy::reproducible` the sum is the same bits on any number of threads
+// and machines, e.g. for billing that is audited on other hardware.
+//
+// Example:
+//   joule total = sum(std::span<const Unit<prefix::kilo, joule>>(readings), 8, policy::reproducible);
+//
+template<typename U, internal::Policy P = typename Default_policy<internal::Coherent_of<U>>::type>
+requires std::derived_from<U, internal::Unit_fundament>
+internal::Coherent_of<U> sum(std::span<const U> values, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  return internal::Coherent_of<U>(internal::parallel_sum<P>([values](std::size_t i) { return values[i].base_value; }, values.size(), threads));
+}
+
+//
+// Integral of the samples y at the points x with the trapezoidal rule. The
+// unit of the result is the product of the units of y and x, e.g. the energy
+// in joule from power samples in watt at times in second. The sum is split
+// between `threads` threads for long series. The policy, e.g.
+// `policy::strict`, defaults to the Default_policy of the result unit; this
+// holds for all batch kernels.
+//
+// Example:
+//   joule energy = trapezoid(std::span<const second>(time), std::span<const watt>(power));
+//   joule billed = trapezoid(std::span<const second>(time), std::span<const watt>(power), 8, policy::strict);
+//
+template<typename X, typename Y, internal::Policy P = typename Default_policy<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>> trapezoid(std::span<const X> x, std::span<const Y> y, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  const std::size_t n = std::min(x.size(), y.size());
+  const auto term = [x, y](std::size_t i) {
+    return (x[i + 1].base_value - x[i].base_value) * (y[i + 1].base_value + y[i].base_value);
+  };
+  return Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>(
+    n < 2 ? (TU_TYPE)0.0 : (TU_TYPE)0.5 * internal::parallel_sum<P>(term, n - 1, threads));
+}
+
+//
+// Integral of the samples y with the constant spacing dx with the trapezoidal
+// rule.
+//
+// Example:
+//   joule energy = trapezoid(std::span<const watt>(power), Unit<prefix::milli, second>(100.0f));
+//
+template<typename Y, typename X, internal::Policy P = typename Default_policy<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>> trapezoid(std::span<const Y> y, const X& dx, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  const std::size_t n = y.size();
+  if (n < 2) {
+    return Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>(0.0f);
+  }
+  const TU_TYPE sum = internal::parallel_sum<P>([y](std::size_t i) { return y[i].base_value; }, n, threads);
+  return Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>(
+    dx.base_value * (sum - internal::rounded<P>((TU_TYPE)0.5 * (y[0].base_value + y[n - 1].base_value))));
+}
+
+//
+// Integral of the samples y with the constant spacing dx with Simpson's rule.
+// For an even number of samples the last three intervals use Simpson's 3/8
+// rule. Two samples are integrated with the trapezoidal rule.
+//
+template<typename Y, typename X, internal::Policy P = typename Default_policy<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>> simpson(std::span<const Y> y, const X& dx, std::size_t threads = 1, P policy = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  using R = Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>;
+  const std::size_t n = y.size();
+  if (n < 3) {
+    return trapezoid(y, dx, 1, policy);
+  }
+  // Samples integrated with Simpson's 1/3 rule, an odd number.
+  const std::size_t m = n % 2 == 1 ? n : n - 3;
+  TU_TYPE sum = (TU_TYPE)0.0;
+  if (m >= 3) {
+    // Weights 1 4 2 4 ... 2 4 1.
+    const auto term = [y](std::size_t i) { return (TU_TYPE)(2 + 2 * (i & 1)) * y[i].base_value; };
+    sum = (internal::parallel_sum<P>(term, m, threads) - y[0].base_value - y[m - 1].base_value) / (TU_TYPE)3.0;
+  }
+  if (m != n) {
+    const TU_TYPE inner = internal::rounded<P>((TU_TYPE)3.0 * (y[n - 3].base_value + y[n - 2].base_value));
+    sum += internal::rounded<P>((TU_TYPE)0.375 * (y[n - 4].base_value + inner + y[n - 1].base_value));
+  }
+  return R(dx.base_value * sum);
+}
+
+//
+// Running integral of the samples y at the points x with the trapezoidal
+// rule, out[i] is the integral from x[0] to x[i]. out must have as many
+// elements as y.
+//
+// Example:
+//   std::vector<joule> energy(power.size());
+//   cumulative_trapezoid(std::span<const second>(time), std::span<const watt>(power), std::span<joule>(energy));
+//
+template<typename X, typename Y, internal::Policy P = typename Default_policy<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+void cumulative_trapezoid(std::span<const X> x, std::span<const Y> y,
+                          std::span<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>> out, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  internal::parallel_cumulative_sum<P>([x, y](std::size_t i) {
+    return (TU_TYPE)0.5 * (x[i].base_value - x[i - 1].base_value) * (y[i].base_value + y[i - 1].base_value);
+  }, out, threads);
+}
+
+//
+// Running integral of the samples y with the constant spacing dx with the
+// trapezoidal rule.
+//
+template<typename Y, typename X, internal::Policy P = typename Default_policy<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+void cumulative_trapezoid(std::span<const Y> y, const X& dx,
+                          std::span<Product_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>> out, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  const TU_TYPE h = (TU_TYPE)0.5 * dx.base_value;
+  internal::parallel_cumulative_sum<P>([y, h](std::size_t i) {
+    return h * (y[i].base_value + y[i - 1].base_value);
+  }, out, threads);
+}
+
+namespace internal {
+//
+// Split [0, n) between `threads` threads that call f(first, last).
+//
+template<typename F>
+void parallel_for(const F& f, std::size_t n, std::size_t threads) {
+  threads = thread_count(n, threads);
+  std::vector<std::jthread> workers;
+  workers.reserve(threads - 1);
+  for (std::size_t t = 1; t < threads; ++t) {
+    workers.push_back(worker(f, n * t / threads, n * (t + 1) / threads));
+  }
+  f(0, n / threads);
+}
+} // namespace internal
+
+//
+// Derivative of the samples y with respect to x. Second order central
+// differences for unevenly spaced points inside and first order one sided
+// differences at the ends. The unit of the result is the quotient of the units
+// of y and x, e.g. position in metre over time in second gives
+// metre_per_second. out must have as many elements as y, at least two.
+//
+// Example:
+//   std::vector<metre_per_second> v(position.size());
+//   derivative(std::span<const second>(time), std::span<const metre>(position), std::span<metre_per_second>(v));
+//
+template<typename X, typename Y, internal::Policy P = typename Default_policy<Quotient_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+void derivative(std::span<const X> x, std::span<const Y> y,
+                std::span<Quotient_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>> out, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  const std::size_t n = out.size();
+  internal::store(out[0], (y[1].base_value - y[0].base_value) / (x[1].base_value - x[0].base_value));
+  internal::store(out[n - 1], (y[n - 1].base_value - y[n - 2].base_value) / (x[n - 1].base_value - x[n - 2].base_value));
+  internal::parallel_for([x, y, out, n](std::size_t first, std::size_t last) {
+    for (std::size_t i = std::max(first, (std::size_t)1); i < std::min(last, n - 1); ++i) {
+      const TU_TYPE h0 = x[i].base_value - x[i - 1].base_value;
+      const TU_TYPE h1 = x[i + 1].base_value - x[i].base_value;
+      internal::store(out[i], (internal::rounded<P>(h0 * h0 * (y[i + 1].base_value - y[i].base_value)) +
+                               internal::rounded<P>(h1 * h1 * (y[i].base_value - y[i - 1].base_value))) / (h0 * h1 * (h0 + h1)));
+    }
+  }, n, threads);
+}
+
+//
+// Derivative of the samples y with the constant spacing dx.
+//
+template<typename Y, typename X, internal::Policy P = typename Default_policy<Quotient_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>>::type>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+void derivative(std::span<const Y> y, const X& dx,
+                std::span<Quotient_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>> out, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  const std::size_t n = out.size();
+  const TU_TYPE r = (TU_TYPE)1.0 / dx.base_value;
+  internal::store(out[0], r * (y[1].base_value - y[0].base_value));
+  internal::store(out[n - 1], r * (y[n - 1].base_value - y[n - 2].base_value));
+  internal::parallel_for([y, out, n, r](std::size_t first, std::size_t last) {
+    for (std::size_t i = std::max(first, (std::size_t)1); i < std::min(last, n - 1); ++i) {
+      internal::store(out[i], (TU_TYPE)0.5 * r * (y[i + 1].base_value - y[i - 1].base_value));
+    }
+  }, n, threads);
+}
+
+} // namespace tu
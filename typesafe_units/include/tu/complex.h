@@ -0,0 +1,173 @@
+#pragma once
+
+#include <complex>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+//
+// Complex valued quantity with the coherent unit U e.g. an impedance in ohm or
+// a phasor in volt. The value is stored in base units in the same way as the
+// `base_value` of a Coherent_unit.
+//
+// Example:
+//   Complex<ohm> z(Unit<prefix::no_prefix, ohm>(3.0f), Unit<prefix::kilo, ohm>(0.004f));
+//   Complex<ampere> i(Unit<prefix::milli, ampere>(200.0f));
+//   Complex<volt> u = z * i;
+//   std::cout << u.real().base_value << std::endl; // prints 0.6
+//
+template<internal::Coherent U>
+struct Complex {
+  using Unit_type = U;
+
+  constexpr Complex() noexcept = default;
+  Complex(std::complex<TU_TYPE> v) noexcept : base_value(v) {}
+
+  template<typename Re>
+  requires (std::derived_from<Re, internal::Unit_fundament> && std::is_same<typename Re::Base, typename U::Base>::value)
+  Complex(const Re& re) noexcept : base_value(re.base_value, (TU_TYPE)0.0) {}
+
+  template<typename Re, typename Im>
+  requires (std::derived_from<Re, internal::Unit_fundament> && std::is_same<typename Re::Base, typename U::Base>::value &&
+            std::derived_from<Im, internal::Unit_fundament> && std::is_same<typename Im::Base, typename U::Base>::value)
+  Complex(const Re& re, const Im& im) noexcept : base_value(re.base_value, im.base_value) {}
+
+  U real() const noexcept {
+    return U(base_value.real());
+  }
+
+  U imag() const noexcept {
+    return U(base_value.imag());
+  }
+
+  bool operator == (const Complex<U>& other) const noexcept = default;
+
+  const std::complex<TU_TYPE> base_value{};
+};
+
+//
+// Create a complex quantity from a magnitude and a phase angle.
+// Example:
+//   Complex<volt> u = polar(Unit<prefix::kilo, volt>(230.0f), Unit<prefix::no_prefix, degree>(120.0f));
+//
+template<typename Mag, prefix pf, typename Angle>
+requires (std::derived_from<Mag, internal::Unit_fundament> && std::is_same<typename Angle::Base, radian::Base>::value)
+auto polar(const Mag& magnitude, const Unit<pf, Angle>& phase) noexcept {
+  return Complex<internal::Coherent_of<Mag>>(std::polar(magnitude.base_value, phase.base_value));
+}
+
+template<typename U>
+auto conj(const Complex<U>& c) noexcept {
+  return Complex<U>(std::conj(c.base_value));
+}
+
+template<typename U>
+U abs(const Complex<U>& c) noexcept {
+  return U(std::abs(c.base_value));
+}
+
+template<typename U>
+radian arg(const Complex<U>& c) noexcept {
+  return radian(std::arg(c.base_value));
+}
+
+//
+// Define binary operations +, -, *, and / for complex quantities.
+// * and / combine dimensions in the same way as for real units and may take a
+// real unit as either operand.
+//
+template<typename U>
+Complex<U> operator + (const Complex<U>& l, const Complex<U>& r) noexcept {
+  return {l.base_value + r.base_value};
+}
+
+template<typename U>
+Complex<U> operator - (const Complex<U>& l, const Complex<U>& r) noexcept {
+  return {l.base_value - r.base_value};
+}
+
+template<typename L, typename R>
+Complex<Product_unit<L, R>> operator * (const Complex<L>& l, const Complex<R>& r) noexcept {
+  return {l.base_value * r.base_value};
+}
+
+template<typename L, typename R>
+Complex<Quotient_unit<L, R>> operator / (const Complex<L>& l, const Complex<R>& r) noexcept {
+  return {l.base_value / r.base_value};
+}
+
+template<typename L, typename... R_args>
+Complex<Product_unit<L, internal::Coherent_unit_base<R_args...>>> operator * (const Complex<L>& l, internal::Coherent_unit_base<R_args...> r) noexcept {
+  return {l.base_value * r.base_value};
+}
+
+template<typename... L_args, typename R>
+Complex<Product_unit<internal::Coherent_unit_base<L_args...>, R>> operator * (internal::Coherent_unit_base<L_args...> l, const Complex<R>& r) noexcept {
+  return {l.base_value * r.base_value};
+}
+
+template<typename L, typename... R_args>
+Complex<Quotient_unit<L, internal::Coherent_unit_base<R_args...>>> operator / (const Complex<L>& l, internal::Coherent_unit_base<R_args...> r) noexcept {
+  return {l.base_value / r.base_value};
+}
+
+template<typename... L_args, typename R>
+Complex<Quotient_unit<internal::Coherent_unit_base<L_args...>, R>> operator / (internal::Coherent_unit_base<L_args...> l, const Complex<R>& r) noexcept {
+  return {l.base_value / r.base_value};
+}
+
+//
+// Structure of arrays view of complex quantities. Real and imaginary parts are
+// kept in separate contiguous arrays of Coherent_units so that batch operations
+// run over plain arrays of base values.
+//
+template<typename U>
+requires internal::Coherent<std::remove_const_t<U>>
+struct Complex_span {
+  std::span<U> real;
+  std::span<U> imag;
+
+  std::size_t size() const noexcept {
+    return real.size();
+  }
+};
+
+//
+// Batch complex multiplication and division out[i] = a[i] op b[i].
+// The loops use the textbook formulas instead of std::complex operators. This
+// avoids the library calls std::complex makes to handle infinities and lets
+// the compiler vectorize the loops. The division does not rescale and may
+// overflow for denominators with magnitude close to the limits of TU_TYPE.
+// All spans must have the same size.
+//
+template<typename L, typename R>
+void multiply(Complex_span<const L> a, Complex_span<const R> b, Complex_span<Product_unit<L, R>> out) noexcept {
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    const TU_TYPE ar = a.real[i].base_value;
+    const TU_TYPE ai = a.imag[i].base_value;
+    const TU_TYPE br = b.real[i].base_value;
+    const TU_TYPE bi = b.imag[i].base_value;
+    internal::store(out.real[i], ar * br - ai * bi);
+    internal::store(out.imag[i], ar * bi + ai * br);
+  }
+}
+
+template<typename L, typename R>
+void divide(Complex_span<const L> a, Complex_span<const R> b, Complex_span<Quotient_unit<L, R>> out) noexcept {
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    const TU_TYPE ar = a.real[i].base_value;
+    const TU_TYPE ai = a.imag[i].base_value;
+    const TU_TYPE br = b.real[i].base_value;
+    const TU_TYPE bi = b.imag[i].base_value;
+    const TU_TYPE inv = (TU_TYPE)1.0 / (br * br + bi * bi);
+    internal::store(out.real[i], (ar * br + ai * bi) * inv);
+    internal::store(out.imag[i], (ai * br - ar * bi) * inv);
+  }
+}
+
+} // namespace tu
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <source_location>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+//
+// Whether the upper bound of a Constrained quantity is part of its interval.
+//   closed:     [min, max]
+//   right_open: [min, max)
+//
+enum struct interval {
+  closed,
+  right_open
+};
+
+//
+// A value outside the interval of a Constrained quantity it was constructed
+// with. `unit` is the dimension in base units, e.g. "K" for kelvin, and
+// `call_site` is where the Constrained quantity was constructed. The values
+// are base values.
+//
+struct Constraint_report {
+  TU_TYPE value;
+  TU_TYPE min;
+  TU_TYPE max;
+  interval bounds;
+  const char* unit;
+  std::source_location call_site;
+};
+
+using Constraint_handler = void (*)(const Constraint_report&);
+
+namespace internal {
+inline void print_constraint_report(const Constraint_report& r) noexcept {
+  std::fprintf(stderr, "tu: %g [%s] outside [%g, %g%c at %s:%u in %s\n", (double)r.value, r.unit, (double)r.min, (double)r.max,
+               r.bounds == interval::closed ? ']' : ')', r.call_site.file_name(), (unsigned)r.call_site.line(),
+               r.call_site.function_name());
+}
+
+inline std::atomic<Constraint_handler> constraint_handler{print_constraint_report};
+} // namespace internal
+
+//
+// Set the function called for values outside the interval of a Constrained
+// quantity and return the previous one. The default prints the report to
+// stderr. When the handler returns, the value is clamped to the interval,
+// and NaN to its upper end, so that the invariant holds. The handler is
+// called from noexcept functions, so to stop at the first report it should
+// abort rather than throw.
+//
+// Example:
+//   tu::set_constraint_handler([](const tu::Constraint_report&) { std::abort(); });
+//
+inline Constraint_handler set_constraint_handler(Constraint_handler handler) noexcept {
+  return internal::constraint_handler.exchange(handler);
+}
+
+template<internal::Coherent U, U Min, U Max, interval bounds = interval::closed>
+struct Constrained;
+
+namespace internal {
+template<typename T>
+struct is_constrained : std::false_type {};
+
+template<typename U, U Min, U Max, interval bounds>
+struct is_constrained<Constrained<U, Min, Max, bounds>> : std::true_type {};
+
+template<typename T>
+concept Constrained_quantity = is_constrained<T>::value;
+
+//
+// Tag of the constructor for values that are in the interval by
+// construction, e.g. the results of abs, clamp and the operators.
+//
+struct Proven {};
+
+constexpr bool is_number(TU_TYPE x) noexcept {
+  return x == x;
+}
+
+//
+// Whether every value of the interval [a_min, a_max] resp. [a_min, a_max) is
+// in [b_min, b_max] resp. [b_min, b_max).
+//
+constexpr bool is_subinterval(TU_TYPE a_min, TU_TYPE a_max, interval a, TU_TYPE b_min, TU_TYPE b_max, interval b) noexcept {
+  return b_min <= a_min && (b == interval::closed || a == interval::right_open ? a_max <= b_max : a_max < b_max);
+}
+
+//
+// v clamped to the interval, NaN to its upper end. The upper end of a right
+// open interval is the largest value below max.
+//
+inline TU_TYPE clamp_to(TU_TYPE v, TU_TYPE min, TU_TYPE max, interval bounds) noexcept {
+  const TU_TYPE top = bounds == interval::closed ? max : std::nextafter(max, min);
+  return std::fmax(min, std::fmin(v, top));
+}
+} // namespace internal
+
+//
+// Quantity of the coherent unit U whose base value is in [Min, Max], or in
+// [Min, Max) with interval::right_open. The bounds are checked when the
+// quantity is constructed from a unit or a Constrained quantity with wider
+// bounds, see `set_constraint_handler`. abs, clamp and + and - of
+// Constrained quantities return Constrained quantities with bounds derived
+// at compile time, so that their results are not checked again. Any other
+// operation gives a plain U, as a Constrained quantity can be used wherever
+// a U is expected.
+//
+// Example:
+//   using Temperature = Non_negative<kelvin>;
+//   using Phase = Constrained<radian, 0.0f, 2.0f * PI, interval::right_open>;
+//   Temperature t(Unit<prefix::no_prefix, degree_Celsius>(25.0f)); // checked
+//   Temperature sum = t + t;                                        // not checked
+//   Phase p = clamp<Phase>(radian(7.0f));                           // not checked
+//
+template<internal::Coherent U, U Min, U Max, interval bounds>
+struct Constrained : U {
+  static_assert(internal::is_number(Min.base_value) && internal::is_number(Max.base_value), "The bounds must not be NaN.");
+  static_assert(bounds == interval::closed ? Min.base_value <= Max.base_value : Min.base_value < Max.base_value,
+                "The interval must not be empty.");
+
+  using Unit_type = U;
+  static constexpr TU_TYPE min = Min.base_value;
+  static constexpr TU_TYPE max = Max.base_value;
+  static constexpr interval range = bounds;
+
+  static constexpr bool contains(TU_TYPE v) noexcept {
+    return min <= v && (bounds == interval::closed ? v <= max : v < max);
+  }
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  Constrained(const V& v, std::source_location call_site = std::source_location::current()) noexcept
+  : U(checked(U(v).base_value, call_site)) {}
+
+  //
+  // Another Constrained quantity of the same unit, checked only if its
+  // interval is not within this one.
+  //
+  template<U Other_min, U Other_max, interval other_bounds>
+  Constrained(const Constrained<U, Other_min, Other_max, other_bounds>& c,
+              std::source_location call_site = std::source_location::current()) noexcept
+  : U(internal::is_subinterval(Other_min.base_value, Other_max.base_value, other_bounds, min, max, bounds)
+      ? c.base_value : checked(c.base_value, call_site)) {}
+
+  //
+  // A base value known to be in the interval.
+  //
+  constexpr Constrained(internal::Proven, TU_TYPE v) noexcept : U(v) {}
+
+private:
+  static TU_TYPE checked(TU_TYPE v, const std::source_location& call_site) noexcept {
+    if (contains(v)) {
+      return v;
+    }
+    internal::constraint_handler.load(std::memory_order_relaxed)({v, min, max, bounds, internal::dimension_of<U>(), call_site});
+    return internal::clamp_to(v, min, max, bounds);
+  }
+};
+
+//
+// Quantity of the coherent unit U that is not negative.
+//
+template<internal::Coherent U>
+using Non_negative = Constrained<U, U((TU_TYPE)0.0), U(std::numeric_limits<TU_TYPE>::infinity())>;
+
+//
+// v clamped to the interval of the Constrained quantity C, without a check.
+// NaN is clamped to the upper end.
+//
+// Example:
+//   auto t = clamp<Non_negative<kelvin>>(t0 - dt);
+//
+template<internal::Constrained_quantity C, typename V>
+requires internal::Same_dimension<V, typename C::Unit_type>
+C clamp(const V& v) noexcept {
+  return {internal::Proven{}, internal::clamp_to(typename C::Unit_type(v).base_value, C::min, C::max, C::range)};
+}
+
+//
+// The absolute value, with bounds from the bounds of c: the same interval if
+// c is not negative, else [0, max(-Min, Max)] resp. [-Max, -Min].
+//
+template<typename U, U Min, U Max, interval bounds>
+auto abs(const Constrained<U, Min, Max, bounds>& c) noexcept {
+  if constexpr (Min.base_value >= (TU_TYPE)0.0) {
+    return c;
+  } else if constexpr (Max.base_value <= (TU_TYPE)0.0) {
+    return Constrained<U, U(-Max.base_value), U(-Min.base_value)>(internal::Proven{}, -c.base_value);
+  } else {
+    constexpr TU_TYPE top = -Min.base_value > Max.base_value ? -Min.base_value : Max.base_value;
+    return Constrained<U, U((TU_TYPE)0.0), U(top)>(internal::Proven{}, std::abs(c.base_value));
+  }
+}
+
+//
+// Sums and differences of Constrained quantities are in the closed interval
+// of the sums and differences of their bounds, since rounding to nearest is
+// monotonic. The upper end is closed since it can be reached by rounding.
+//
+template<typename U, U L_min, U L_max, interval l_bounds, U R_min, U R_max, interval r_bounds>
+requires (internal::is_number(L_min.base_value + R_min.base_value) && internal::is_number(L_max.base_value + R_max.base_value))
+auto operator + (const Constrained<U, L_min, L_max, l_bounds>& l, const Constrained<U, R_min, R_max, r_bounds>& r) noexcept {
+  return Constrained<U, U(L_min.base_value + R_min.base_value), U(L_max.base_value + R_max.base_value)>(
+    internal::Proven{}, l.base_value + r.base_value);
+}
+
+template<typename U, U L_min, U L_max, interval l_bounds, U R_min, U R_max, interval r_bounds>
+requires (internal::is_number(L_min.base_value - R_max.base_value) && internal::is_number(L_max.base_value - R_min.base_value))
+auto operator - (const Constrained<U, L_min, L_max, l_bounds>& l, const Constrained<U, R_min, R_max, r_bounds>& r) noexcept {
+  return Constrained<U, U(L_min.base_value - R_max.base_value), U(L_max.base_value - R_min.base_value)>(
+    internal::Proven{}, l.base_value - r.base_value);
+}
+
+template<typename U, U Min, U Max, interval bounds>
+auto operator - (const Constrained<U, Min, Max, bounds>& c) noexcept {
+  return Constrained<U, U(-Max.base_value), U(-Min.base_value)>(internal::Proven{}, -c.base_value);
+}
+
+} // namespace tu
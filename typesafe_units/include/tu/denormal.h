@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#endif
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+namespace internal {
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+//
+// MXCSR with flush-to-zero (bit 15) and denormals-are-zero (bit 6).
+//
+using Fp_control = unsigned int;
+inline constexpr Fp_control flush_bits = 0x8040u;
+
+inline Fp_control fp_control() noexcept {
+  return _mm_getcsr();
+}
+
+inline void set_fp_control(Fp_control c) noexcept {
+  _mm_setcsr(c);
+}
+#elif defined(__GNUC__) && defined(__aarch64__)
+//
+// FPCR with flush-to-zero (FZ, bit 24), which also treats subnormal inputs
+// as zero.
+//
+using Fp_control = std::uint64_t;
+inline constexpr Fp_control flush_bits = (Fp_control)1 << 24;
+
+inline Fp_control fp_control() noexcept {
+  Fp_control c;
+  asm volatile("mrs %0, fpcr" : "=r"(c));
+  return c;
+}
+
+inline void set_fp_control(Fp_control c) noexcept {
+  asm volatile("msr fpcr, %0" : : "r"(c));
+}
+#else
+using Fp_control = unsigned int;
+inline constexpr Fp_control flush_bits = 0u;
+
+inline Fp_control fp_control() noexcept {
+  return 0u;
+}
+
+inline void set_fp_control(Fp_control) noexcept {}
+#endif
+} // namespace internal
+
+//
+// Whether the target can flush subnormal values to zero.
+//
+inline constexpr bool can_flush_denormals = internal::flush_bits != 0;
+
+//
+// Whether subnormal inputs and results are flushed to zero on the calling
+// thread.
+//
+inline bool denormals_flushed() noexcept {
+  return (internal::fp_control() & internal::flush_bits) != 0;
+}
+
+//
+// Flushes subnormal inputs and results to zero on the calling thread until
+// the end of the scope, where the previous mode is restored: flush-to-zero
+// and denormals-are-zero in MXCSR on x86, FZ in FPCR on AArch64 and nothing
+// elsewhere. Arithmetic on subnormal values can be a hundred times slower on
+// many processors. Workers started by the batch kernels run in the mode of
+// the calling thread.
+//
+// Example:
+//   {
+//     const tu::Flush_denormals flush;
+//     energy = trapezoid(std::span<const Unit<prefix::no_prefix, electronvolt>>(samples), Unit<prefix::femto, second>(1.0f), 8);
+//   }
+//
+class Flush_denormals {
+public:
+  explicit Flush_denormals(bool flush = true) noexcept : previous(internal::fp_control()) {
+    internal::set_fp_control(flush ? previous | internal::flush_bits : previous & ~internal::flush_bits);
+  }
+
+  ~Flush_denormals() {
+    internal::set_fp_control(previous);
+  }
+
+  Flush_denormals(const Flush_denormals&) = delete;
+  Flush_denormals& operator = (const Flush_denormals&) = delete;
+
+private:
+  internal::Fp_control previous;
+};
+
+namespace internal {
+//
+// A thread that calls f(args...) with subnormal values flushed as on the
+// calling thread, since the mode is per thread.
+//
+template<typename F, typename... Args>
+std::jthread worker(F&& f, Args&&... args) {
+  return std::jthread([flush = denormals_flushed(), f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable {
+    const Flush_denormals mode(flush);
+    std::invoke(f, args...);
+  });
+}
+} // namespace internal
+
+} // namespace tu
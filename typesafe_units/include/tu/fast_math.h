@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <type_traits>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+namespace internal {
+#if defined(FP_FAST_FMAF)
+inline constexpr bool fast_fmaf = true;
+#else
+inline constexpr bool fast_fmaf = false;
+#endif
+#if defined(FP_FAST_FMA)
+inline constexpr bool fast_fma = true;
+#else
+inline constexpr bool fast_fma = false;
+#endif
+
+//
+// a * b + c. Uses std::fma when the target has fast fused multiply-add
+// instructions. Otherwise std::fma would be a slow library call.
+//
+constexpr TU_TYPE mul_add(TU_TYPE a, TU_TYPE b, TU_TYPE c) noexcept {
+  if constexpr (std::is_same_v<TU_TYPE, float> ? fast_fmaf : fast_fma) {
+    if (!std::is_constant_evaluated()) {
+      return std::fma(a, b, c);
+    }
+  }
+  return a * b + c;
+}
+
+//
+// Fast approximations of log2 and exp2 used by batch operations.
+// Both functions are branch free so that loops calling them can be vectorized.
+// The error is within a few ULP of the std:: functions.
+// `fast_log2` requires a positive, normal argument.
+//
+constexpr TU_TYPE fast_log2(TU_TYPE x) noexcept {
+  using Bits = std::conditional_t<std::is_same_v<TU_TYPE, float>, std::uint32_t, std::uint64_t>;
+  constexpr int mantissa_bits = std::numeric_limits<TU_TYPE>::digits - 1;
+  constexpr Bits mantissa_mask = (Bits(1) << mantissa_bits) - 1;
+  constexpr Bits sqrt_half_bits = std::bit_cast<Bits>(std::numbers::sqrt2_v<TU_TYPE> / (TU_TYPE)2.0);
+
+  // Split x into 2^e * m with m in [sqrt(1/2), sqrt(2)).
+  const Bits bits = std::bit_cast<Bits>(x);
+  const Bits shifted = bits - sqrt_half_bits;
+  const auto e = std::bit_cast<std::make_signed_t<Bits>>(shifted) >> mantissa_bits;
+  const TU_TYPE m = std::bit_cast<TU_TYPE>((shifted & mantissa_mask) + sqrt_half_bits);
+
+  // ln(m) = 2 atanh(t) with t = (m - 1) / (m + 1) and |t| < 0.172.
+  const TU_TYPE t = (m - (TU_TYPE)1.0) / (m + (TU_TYPE)1.0);
+  const TU_TYPE t2 = t * t;
+  TU_TYPE p;
+  if constexpr (std::is_same_v<TU_TYPE, float>) {
+    p = (TU_TYPE)1.0 + t2 * ((TU_TYPE)(1.0 / 3.0) + t2 * ((TU_TYPE)(1.0 / 5.0) + t2 * (TU_TYPE)(1.0 / 7.0)));
+  } else {
+    p = 1.0 + t2 * (1.0 / 3.0 + t2 * (1.0 / 5.0 + t2 * (1.0 / 7.0 + t2 * (1.0 / 9.0 + t2 * (1.0 / 11.0 +
+        t2 * (1.0 / 13.0 + t2 * (1.0 / 15.0 + t2 * (1.0 / 17.0))))))));
+  }
+  return (TU_TYPE)e + (TU_TYPE)2.0 * std::numbers::log2e_v<TU_TYPE> * t * p;
+}
+
+//
+// `fast_exp2` saturates to the smallest normal value and to infinity outside
+// the range of normal values.
+//
+constexpr TU_TYPE fast_exp2(TU_TYPE x) noexcept {
+  using Bits = std::conditional_t<std::is_same_v<TU_TYPE, float>, std::uint32_t, std::uint64_t>;
+  using Signed_bits = std::make_signed_t<Bits>;
+  constexpr int mantissa_bits = std::numeric_limits<TU_TYPE>::digits - 1;
+  constexpr Signed_bits exponent_bias = std::numeric_limits<TU_TYPE>::max_exponent - 1;
+  constexpr TU_TYPE max_x = (TU_TYPE)std::numeric_limits<TU_TYPE>::max_exponent;
+  constexpr TU_TYPE min_x = (TU_TYPE)(std::numeric_limits<TU_TYPE>::min_exponent - 1);
+
+  x = x < min_x ? min_x : (x > max_x ? max_x : x);
+
+  // 2^x = 2^n * e^(f ln 2) with n integer and |f| <= 1/2.
+  const Signed_bits ni = (Signed_bits)(x >= (TU_TYPE)0.0 ? x + (TU_TYPE)0.5 : x - (TU_TYPE)0.5);
+  const TU_TYPE y = (x - (TU_TYPE)ni) * std::numbers::ln2_v<TU_TYPE>;
+  TU_TYPE p;
+  if constexpr (std::is_same_v<TU_TYPE, float>) {
+    p = 1.0f + y * (1.0f + y * (1.0f / 2.0f + y * (1.0f / 6.0f + y * (1.0f / 24.0f + y * (1.0f / 120.0f +
+        y * (1.0f / 720.0f + y * (1.0f / 5040.0f)))))));
+  } else {
+    p = 1.0 + y * (1.0 + y * (1.0 / 2.0 + y * (1.0 / 6.0 + y * (1.0 / 24.0 + y * (1.0 / 120.0 +
+        y * (1.0 / 720.0 + y * (1.0 / 5040.0 + y * (1.0 / 40320.0 + y * (1.0 / 362880.0 +
+        y * (1.0 / 3628800.0 + y * (1.0 / 39916800.0 + y * (1.0 / 479001600.0 + y * (1.0 / 6227020800.0)))))))))))));
+  }
+  // Scale in two steps so that 2^n is representable also at the ends of the range.
+  const Signed_bits n1 = ni / 2;
+  const Signed_bits n2 = ni - n1;
+  const TU_TYPE s1 = std::bit_cast<TU_TYPE>((Bits)(n1 + exponent_bias) << mantissa_bits);
+  const TU_TYPE s2 = std::bit_cast<TU_TYPE>((Bits)(n2 + exponent_bias) << mantissa_bits);
+  return p * s1 * s2;
+}
+
+//
+// Fast approximation of sin for x in [-pi, pi]. The argument is folded to
+// [-pi/2, pi/2] with min and max and the Taylor series is evaluated there.
+//
+constexpr TU_TYPE fast_sin(TU_TYPE x) noexcept {
+  constexpr TU_TYPE pi = std::numbers::pi_v<TU_TYPE>;
+  x = std::max(std::min(x, pi - x), -pi - x);
+  const TU_TYPE x2 = x * x;
+  TU_TYPE p;
+  if constexpr (std::is_same_v<TU_TYPE, float>) {
+    p = 1.0f - x2 * (1.0f / 6.0f - x2 * (1.0f / 120.0f - x2 * (1.0f / 5040.0f - x2 * (1.0f / 362880.0f - x2 * (1.0f / 39916800.0f)))));
+  } else {
+    p = 1.0 - x2 * (1.0 / 6.0 - x2 * (1.0 / 120.0 - x2 * (1.0 / 5040.0 - x2 * (1.0 / 362880.0 - x2 * (1.0 / 39916800.0 -
+        x2 * (1.0 / 6227020800.0 - x2 * (1.0 / 1307674368000.0 - x2 * (1.0 / 355687428096000.0 - x2 * (1.0 / 121645100408832000.0 -
+        x2 * (1.0 / 51090942171709440000.0))))))))));
+  }
+  return x * p;
+}
+
+//
+// sqrt for non-negative x. Unlike std::sqrt it never sets errno, which lets
+// loops calling it be vectorized without compiling with -fno-math-errno.
+// A bit manipulation estimate of 1/sqrt(x) is refined with Newton iterations
+// and multiplied by x.
+//
+constexpr TU_TYPE fast_sqrt(TU_TYPE x) noexcept {
+  using Bits = std::conditional_t<std::is_same_v<TU_TYPE, float>, std::uint32_t, std::uint64_t>;
+  constexpr Bits magic = std::is_same_v<TU_TYPE, float> ? (Bits)0x5F375A86u : (Bits)0x5FE6EB50C7B537A9ull;
+  constexpr int iterations = std::is_same_v<TU_TYPE, float> ? 3 : 4;
+  TU_TYPE r = std::bit_cast<TU_TYPE>(magic - (std::bit_cast<Bits>(x) >> 1));
+  for (int i = 0; i < iterations; ++i) {
+    r = r * ((TU_TYPE)1.5 - (TU_TYPE)0.5 * x * r * r);
+  }
+  return x * r;
+}
+} // namespace internal
+
+} // namespace tu
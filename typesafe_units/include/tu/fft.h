@@ -0,0 +1,354 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <span>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "complex.h"
+#include "denormal.h"
+
+namespace tu {
+
+namespace internal {
+//
+// Buffers for the stages of a complex transform of size n.
+//
+struct Fft_work {
+  explicit Fft_work(std::size_t n) : re{std::vector<TU_TYPE>(n), std::vector<TU_TYPE>(n)}, im{std::vector<TU_TYPE>(n), std::vector<TU_TYPE>(n)} {}
+
+  std::vector<TU_TYPE> re[2];
+  std::vector<TU_TYPE> im[2];
+};
+
+//
+// Stage of a Stockham transform that combines radix transforms of size l into
+// transforms of size l * radix. m is the number of transforms of size
+// l * radix.
+//
+struct Fft_stage {
+  std::size_t radix;
+  std::size_t l;
+  std::size_t m;
+};
+} // namespace internal
+
+//
+// Forward discrete Fourier transform of real series of n samples. The
+// factorization of n, the twiddle factors and the work buffers are set up at
+// construction, so transforms do not allocate. n may be any size; radix 4 and
+// 2 stages have their own butterflies and other prime factors use a general
+// butterfly that is fast for small primes.
+//
+// An even n is transformed as a complex series of n / 2 samples and split
+// into the spectrum of the real series. The stages are Stockham stages
+// without bit reversal, working on separate arrays of real and imaginary
+// parts so that the loops of the butterflies are vectorized by the compiler.
+//
+// The transform is not normalized. The spectrum has the unit of the samples
+// and n / 2 + 1 bins from zero to the Nyquist frequency. An n of 0 is taken
+// as 1.
+//
+// Example:
+//   Real_fft fft(1024);
+//   std::vector<metre_per_second> re(fft.bins());
+//   std::vector<metre_per_second> im(fft.bins());
+//   fft.transform(std::span<const metre_per_second>(velocity), Complex_span<metre_per_second>{re, im});
+//   hertz f = fft.frequency(5, Unit<prefix::micro, second>(100.0f));
+//
+class Real_fft {
+public:
+  explicit Real_fft(std::size_t size)
+  : n(std::max(size, (std::size_t)1)), complex_size(n % 2 == 0 ? n / 2 : n), cos_n(complex_size), sin_n(complex_size), split_cos(n / 2 + 1), split_sin(n / 2 + 1), work(complex_size) {
+    for (std::size_t t = 0; t < complex_size; ++t) {
+      const double phase = 2.0 * std::numbers::pi * (double)t / (double)complex_size;
+      cos_n[t] = (TU_TYPE)std::cos(phase);
+      sin_n[t] = (TU_TYPE)-std::sin(phase);
+    }
+    for (std::size_t k = 0; k <= n / 2; ++k) {
+      const double phase = 2.0 * std::numbers::pi * (double)k / (double)n;
+      split_cos[k] = (TU_TYPE)std::cos(phase);
+      split_sin[k] = (TU_TYPE)-std::sin(phase);
+    }
+    std::size_t rest = complex_size;
+    std::size_t l = 1;
+    const auto add = [&](std::size_t radix) {
+      rest /= radix;
+      stages.push_back({radix, l, rest});
+      l *= radix;
+    };
+    while (rest % 4 == 0) {
+      add(4);
+    }
+    while (rest % 2 == 0) {
+      add(2);
+    }
+    for (std::size_t p = 3; p * p <= rest; p += 2) {
+      while (rest % p == 0) {
+        add(p);
+      }
+    }
+    if (rest > 1) {
+      add(rest);
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return n;
+  }
+
+  std::size_t bins() const noexcept {
+    return n / 2 + 1;
+  }
+
+  //
+  // Frequency of a bin for samples taken with the period `period`.
+  //
+  template<typename T>
+  requires internal::Same_dimension<T, second>
+  hertz frequency(std::size_t bin, const T& period) const noexcept {
+    return hertz((TU_TYPE)bin / ((TU_TYPE)n * period.base_value));
+  }
+
+  //
+  // Transform one or more channels. x holds the channels one after another
+  // with size() samples each, and out gets bins() bins per channel. The
+  // channels are split between `threads` threads, each with its own work
+  // buffers. The transform uses the buffers of the Real_fft, so a Real_fft
+  // must not be used for more than one transform at a time.
+  // Only whole channels that out has room for are transformed, and their
+  // number is returned. Samples of a trailing partial channel are ignored.
+  //
+  template<typename U>
+  requires std::derived_from<U, internal::Unit_fundament>
+  std::size_t transform(std::span<const U> x, Complex_span<internal::Coherent_of<U>> out, std::size_t threads = 1) {
+    const std::size_t channels = std::min({x.size() / n, out.real.size() / bins(), out.imag.size() / bins()});
+    threads = std::max(std::min(threads, channels), (std::size_t)1);
+    const auto channel_range = [&](std::size_t first, std::size_t last, internal::Fft_work& w) {
+      for (std::size_t c = first; c < last; ++c) {
+        transform_channel(x.subspan(c * n, n), out.real.subspan(c * bins(), bins()), out.imag.subspan(c * bins(), bins()), w);
+      }
+    };
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+      workers.push_back(internal::worker([&, t] {
+        internal::Fft_work w(complex_size);
+        channel_range(channels * t / threads, channels * (t + 1) / threads, w);
+      }));
+    }
+    channel_range(0, channels / threads, work);
+    return channels;
+  }
+
+private:
+  template<typename U, typename V>
+  void transform_channel(std::span<const U> x, std::span<V> re, std::span<V> im, internal::Fft_work& w) const noexcept {
+    const std::size_t h = complex_size;
+    if (n % 2 == 0) {
+      for (std::size_t k = 0; k < h; ++k) {
+        w.re[0][k] = x[2 * k].base_value;
+        w.im[0][k] = x[2 * k + 1].base_value;
+      }
+    } else {
+      for (std::size_t k = 0; k < h; ++k) {
+        w.re[0][k] = x[k].base_value;
+        w.im[0][k] = (TU_TYPE)0.0;
+      }
+    }
+    std::size_t from = 0;
+    for (const internal::Fft_stage& s : stages) {
+      run(s, w.re[from].data(), w.im[from].data(), w.re[1 - from].data(), w.im[1 - from].data());
+      from = 1 - from;
+    }
+    const TU_TYPE* zr = w.re[from].data();
+    const TU_TYPE* zi = w.im[from].data();
+    if (n % 2 == 1) {
+      for (std::size_t k = 0; k < bins(); ++k) {
+        internal::store(re[k], zr[k]);
+        internal::store(im[k], zi[k]);
+      }
+      return;
+    }
+    // Split the transform of the even and odd samples z = x[2k] + i x[2k + 1]
+    // into the spectrum of x.
+    internal::store(re[0], zr[0] + zi[0]);
+    internal::store(im[0], (TU_TYPE)0.0);
+    internal::store(re[h], zr[0] - zi[0]);
+    internal::store(im[h], (TU_TYPE)0.0);
+    constexpr std::size_t block = 64;
+    for (std::size_t k0 = 1; k0 < h; k0 += block) {
+      const std::size_t len = std::min(block, h - k0);
+      std::array<TU_TYPE, block> xr;
+      std::array<TU_TYPE, block> xi;
+      for (std::size_t i = 0; i < len; ++i) {
+        const std::size_t k = k0 + i;
+        const TU_TYPE a = zr[k];
+        const TU_TYPE b = zi[k];
+        const TU_TYPE c = zr[h - k];
+        const TU_TYPE d = zi[h - k];
+        const TU_TYPE er = (TU_TYPE)0.5 * (a + c);
+        const TU_TYPE ei = (TU_TYPE)0.5 * (b - d);
+        const TU_TYPE odd_r = (TU_TYPE)0.5 * (b + d);
+        const TU_TYPE odd_i = (TU_TYPE)0.5 * (c - a);
+        xr[i] = er + split_cos[k] * odd_r - split_sin[k] * odd_i;
+        xi[i] = ei + split_cos[k] * odd_i + split_sin[k] * odd_r;
+      }
+      for (std::size_t i = 0; i < len; ++i) {
+        internal::store(re[k0 + i], xr[i]);
+        internal::store(im[k0 + i], xi[i]);
+      }
+    }
+  }
+
+  //
+  // One Stockham stage from (ar, ai) to (br, bi). Input element
+  // j m radix + q m + k, for the sub transform j, the part q and the series k,
+  // is multiplied by the twiddle factor and the results of the radix transform
+  // go to (j + l s) m + k for the output frequency s.
+  //
+  void run(const internal::Fft_stage& s, const TU_TYPE* ar, const TU_TYPE* ai, TU_TYPE* br, TU_TYPE* bi) const noexcept {
+    const std::size_t l = s.l;
+    const std::size_t m = s.m;
+    const std::size_t p = s.radix;
+    // The butterflies write to local blocks, since the compiler does not
+    // vectorize loops that may store to the arrays they read.
+    constexpr std::size_t block = 64;
+    // Twiddle factor exp(-2 pi i e / (l p)).
+    const auto twiddle = [this, m](std::size_t e) { return (e * m) % complex_size; };
+    for (std::size_t j = 0; j < l; ++j) {
+      const TU_TYPE* xr = ar + j * m * p;
+      const TU_TYPE* xi = ai + j * m * p;
+      if (p == 2) {
+        const TU_TYPE c1 = cos_n[twiddle(j)];
+        const TU_TYPE s1 = sin_n[twiddle(j)];
+        TU_TYPE* y0r = br + j * m;
+        TU_TYPE* y0i = bi + j * m;
+        TU_TYPE* y1r = br + (j + l) * m;
+        TU_TYPE* y1i = bi + (j + l) * m;
+        for (std::size_t k0 = 0; k0 < m; k0 += block) {
+          const std::size_t len = std::min(block, m - k0);
+          std::array<TU_TYPE, block> t0r;
+          std::array<TU_TYPE, block> t0i;
+          std::array<TU_TYPE, block> t1r;
+          std::array<TU_TYPE, block> t1i;
+          for (std::size_t k = 0; k < len; ++k) {
+            const TU_TYPE tr = c1 * xr[m + k0 + k] - s1 * xi[m + k0 + k];
+            const TU_TYPE ti = c1 * xi[m + k0 + k] + s1 * xr[m + k0 + k];
+            t0r[k] = xr[k0 + k] + tr;
+            t0i[k] = xi[k0 + k] + ti;
+            t1r[k] = xr[k0 + k] - tr;
+            t1i[k] = xi[k0 + k] - ti;
+          }
+          std::copy_n(t0r.begin(), len, y0r + k0);
+          std::copy_n(t0i.begin(), len, y0i + k0);
+          std::copy_n(t1r.begin(), len, y1r + k0);
+          std::copy_n(t1i.begin(), len, y1i + k0);
+        }
+      } else if (p == 4) {
+        const TU_TYPE c1 = cos_n[twiddle(j)];
+        const TU_TYPE s1 = sin_n[twiddle(j)];
+        const TU_TYPE c2 = cos_n[twiddle(2 * j)];
+        const TU_TYPE s2 = sin_n[twiddle(2 * j)];
+        const TU_TYPE c3 = cos_n[twiddle(3 * j)];
+        const TU_TYPE s3 = sin_n[twiddle(3 * j)];
+        for (std::size_t k0 = 0; k0 < m; k0 += block) {
+          const std::size_t len = std::min(block, m - k0);
+          std::array<std::array<TU_TYPE, block>, 4> tr;
+          std::array<std::array<TU_TYPE, block>, 4> ti;
+          for (std::size_t k = 0; k < len; ++k) {
+            const std::size_t i = k0 + k;
+            const TU_TYPE a0r = xr[i];
+            const TU_TYPE a0i = xi[i];
+            const TU_TYPE a1r = c1 * xr[m + i] - s1 * xi[m + i];
+            const TU_TYPE a1i = c1 * xi[m + i] + s1 * xr[m + i];
+            const TU_TYPE a2r = c2 * xr[2 * m + i] - s2 * xi[2 * m + i];
+            const TU_TYPE a2i = c2 * xi[2 * m + i] + s2 * xr[2 * m + i];
+            const TU_TYPE a3r = c3 * xr[3 * m + i] - s3 * xi[3 * m + i];
+            const TU_TYPE a3i = c3 * xi[3 * m + i] + s3 * xr[3 * m + i];
+            // Multiplication by -i is (re, im) -> (im, -re).
+            tr[0][k] = (a0r + a2r) + (a1r + a3r);
+            ti[0][k] = (a0i + a2i) + (a1i + a3i);
+            tr[1][k] = (a0r - a2r) + (a1i - a3i);
+            ti[1][k] = (a0i - a2i) - (a1r - a3r);
+            tr[2][k] = (a0r + a2r) - (a1r + a3r);
+            ti[2][k] = (a0i + a2i) - (a1i + a3i);
+            tr[3][k] = (a0r - a2r) - (a1i - a3i);
+            ti[3][k] = (a0i - a2i) + (a1r - a3r);
+          }
+          for (std::size_t f = 0; f < 4; ++f) {
+            std::copy_n(tr[f].begin(), len, br + (j + f * l) * m + k0);
+            std::copy_n(ti[f].begin(), len, bi + (j + f * l) * m + k0);
+          }
+        }
+      } else {
+        // General radix: output frequency s of the sub transform j is the sum
+        // over q of part q times exp(-2 pi i q (j + l s) / (l p)).
+        for (std::size_t f = 0; f < p; ++f) {
+          TU_TYPE* yr = br + (j + l * f) * m;
+          TU_TYPE* yi = bi + (j + l * f) * m;
+          for (std::size_t k = 0; k < m; ++k) {
+            yr[k] = xr[k];
+            yi[k] = xi[k];
+          }
+          for (std::size_t q = 1; q < p; ++q) {
+            const TU_TYPE c = cos_n[twiddle(q * (j + l * f))];
+            const TU_TYPE sn = sin_n[twiddle(q * (j + l * f))];
+            const TU_TYPE* zr = xr + q * m;
+            const TU_TYPE* zi = xi + q * m;
+            for (std::size_t k = 0; k < m; ++k) {
+              yr[k] += c * zr[k] - sn * zi[k];
+              yi[k] += c * zi[k] + sn * zr[k];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::size_t n;
+  std::size_t complex_size;
+  std::vector<TU_TYPE> cos_n;
+  std::vector<TU_TYPE> sin_n;
+  std::vector<TU_TYPE> split_cos;
+  std::vector<TU_TYPE> split_sin;
+  std::vector<internal::Fft_stage> stages;
+  internal::Fft_work work;
+};
+
+//
+// One sided power spectral density from spectra of `fft`, for samples taken
+// with the period `period`. The density of a spectrum in U has the unit
+// U^2 / hertz. spectrum and out hold one or more channels with fft.bins()
+// bins each. The sum of the density times the bin width fft.frequency(1,
+// period) is the mean square of the samples.
+//
+// Example:
+//   std::vector<Quotient_unit<Power_unit<metre_per_second, std::ratio<2>>, hertz>> psd(fft.bins());
+//   power_spectral_density(fft, Complex_span<const metre_per_second>{re, im}, Unit<prefix::micro, second>(100.0f),
+//                          std::span<Quotient_unit<Power_unit<metre_per_second, std::ratio<2>>, hertz>>(psd));
+//
+template<typename U, typename T>
+requires internal::Same_dimension<T, second>
+void power_spectral_density(const Real_fft& fft, Complex_span<const U> spectrum, const T& period,
+                            std::span<Quotient_unit<Power_unit<U, std::ratio<2>>, hertz>> out) noexcept {
+  const std::size_t n = fft.size();
+  const std::size_t bins = fft.bins();
+  const TU_TYPE scale = period.base_value / (TU_TYPE)n;
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    const std::size_t k = i % bins;
+    // Bins other than zero and the Nyquist frequency also hold the power of
+    // the negative frequencies.
+    const TU_TYPE one_sided = k == 0 || 2 * k == n ? scale : (TU_TYPE)2.0 * scale;
+    const TU_TYPE re = spectrum.real[i].base_value;
+    const TU_TYPE im = spectrum.imag[i].base_value;
+    internal::store(out[i], one_sided * (re * re + im * im));
+  }
+}
+
+} // namespace tu
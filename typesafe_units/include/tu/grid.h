@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "denormal.h"
+
+namespace tu {
+
+//
+// How the halo of a grid is filled.
+//   periodic:      The grid wraps around.
+//   zero_gradient: Halo cells have the value of the closest interior cell.
+//   fixed:         Halo cells have a given value.
+//
+enum struct boundary {
+  periodic,
+  zero_gradient,
+  fixed
+};
+
+//
+// Two or three dimensional grid of the coherent unit U, e.g. a temperature
+// field in kelvin. Cells are indexed {x, y} or {x, y, z} with x varying
+// fastest in memory. The interior cells have indices 0 to extent - 1 and are
+// surrounded by `halo` layers of cells with indices down to -halo and up to
+// extent + halo - 1 which hold the boundary values for stencils.
+//
+// Example:
+//   Grid<kelvin, 2> temperature({512, 512}, 1, kelvin(293.15f));
+//   temperature.set({0, 0}, kelvin(373.15f));
+//   temperature.fill_halo(boundary::zero_gradient);
+//
+template<internal::Coherent U, std::size_t D>
+requires (D == 2 || D == 3)
+class Grid {
+public:
+  using Unit_type = U;
+  using Index = std::array<std::ptrdiff_t, D>;
+
+  Grid(const std::array<std::size_t, D>& extent, std::size_t halo, const U& initial = U(0.0f))
+  : extent_(extent), halo_(halo), stride_(strides(extent, halo)),
+    values((std::size_t)stride_[D - 1] * (extent[D - 1] + 2 * halo), initial) {}
+
+  const std::array<std::size_t, D>& extent() const noexcept {
+    return extent_;
+  }
+
+  std::size_t halo() const noexcept {
+    return halo_;
+  }
+
+  U operator () (const Index& i) const noexcept {
+    return values[offset(i)];
+  }
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  void set(const Index& i, const V& v) noexcept {
+    internal::store(values[offset(i)], U(v).base_value);
+  }
+
+  //
+  // Position of the cell i in `data`.
+  //
+  std::size_t offset(const Index& i) const noexcept {
+    std::ptrdiff_t o = 0;
+    for (std::size_t d = 0; d < D; ++d) {
+      o += (i[d] + (std::ptrdiff_t)halo_) * stride_[d];
+    }
+    return (std::size_t)o;
+  }
+
+  //
+  // All cells including the halo.
+  //
+  std::span<const U> data() const noexcept {
+    return values;
+  }
+
+  std::span<U> data() noexcept {
+    return values;
+  }
+
+  //
+  // Fill the halo from the interior. The dimensions are filled in order and
+  // each includes the halo of the previous ones, so edges and corners get
+  // consistent values.
+  //
+  void fill_halo(boundary b, const U& value = U(0.0f)) noexcept {
+    const std::ptrdiff_t h = (std::ptrdiff_t)halo_;
+    for (std::size_t d = 0; d < D; ++d) {
+      const std::ptrdiff_t n = (std::ptrdiff_t)extent_[d];
+      const std::size_t lines = values.size() / (extent_[d] + 2 * halo_);
+      for (std::size_t l = 0; l < lines; ++l) {
+        // First cell of line l along dimension d.
+        std::ptrdiff_t base = 0;
+        std::size_t rest = l;
+        for (std::size_t e = 0; e < D; ++e) {
+          if (e != d) {
+            const std::size_t padded = extent_[e] + 2 * halo_;
+            base += (std::ptrdiff_t)(rest % padded) * stride_[e];
+            rest /= padded;
+          }
+        }
+        for (std::ptrdiff_t t = 1; t <= h; ++t) {
+          const std::ptrdiff_t low = h - t;
+          const std::ptrdiff_t high = h + n - 1 + t;
+          switch (b) {
+          case boundary::periodic:
+            copy(base, low, h + n - t, d);
+            copy(base, high, h + t - 1, d);
+            break;
+          case boundary::zero_gradient:
+            copy(base, low, h, d);
+            copy(base, high, h + n - 1, d);
+            break;
+          case boundary::fixed:
+            internal::store(values[base + low * stride_[d]], value.base_value);
+            internal::store(values[base + high * stride_[d]], value.base_value);
+            break;
+          }
+        }
+      }
+    }
+  }
+
+private:
+  static std::array<std::ptrdiff_t, D> strides(const std::array<std::size_t, D>& extent, std::size_t halo) noexcept {
+    std::array<std::ptrdiff_t, D> stride{1};
+    for (std::size_t d = 1; d < D; ++d) {
+      stride[d] = stride[d - 1] * (std::ptrdiff_t)(extent[d - 1] + 2 * halo);
+    }
+    return stride;
+  }
+
+  void copy(std::ptrdiff_t base, std::ptrdiff_t to, std::ptrdiff_t from, std::size_t d) noexcept {
+    internal::store(values[base + to * stride_[d]], values[base + from * stride_[d]].base_value);
+  }
+
+  std::array<std::size_t, D> extent_;
+  std::size_t halo_;
+  std::array<std::ptrdiff_t, D> stride_;
+  std::vector<U> values;
+};
+
+//
+// Stencil of N points with coefficients of the coherent unit C. Applying it to
+// a grid of U gives a grid of C * U, e.g. the Laplacian with coefficients in
+// 1 / metre_squared takes kelvin to kelvin / metre_squared.
+//
+template<internal::Coherent C, std::size_t D, std::size_t N>
+struct Stencil {
+  using Unit_type = C;
+  std::array<std::array<std::ptrdiff_t, D>, N> offsets;
+  std::array<C, N> weights;
+};
+
+namespace internal {
+template<typename C, std::size_t N>
+constexpr std::array<C, N> filled(TU_TYPE v) noexcept {
+  return [v]<std::size_t... I>(std::index_sequence<I...>) {
+    return std::array<C, N>{((void)I, C(v))...};
+  }(std::make_index_sequence<N>{});
+}
+} // namespace internal
+
+//
+// Second order Laplacian with 2 D + 1 points for the grid spacing h.
+//
+// Example:
+//   const auto lap = laplacian<2>(Unit<prefix::centi, metre>(1.0f));
+//
+template<std::size_t D, typename X>
+constexpr auto laplacian(const X& h) noexcept {
+  using C = Quotient_unit<scalar, Product_unit<internal::Coherent_of<X>, internal::Coherent_of<X>>>;
+  const TU_TYPE w = (TU_TYPE)1.0 / (h.base_value * h.base_value);
+  Stencil<C, D, 2 * D + 1> s{{}, internal::filled<C, 2 * D + 1>(w)};
+  std::construct_at(&s.weights[0], -(TU_TYPE)(2 * D) * w);
+  for (std::size_t d = 0; d < D; ++d) {
+    s.offsets[2 * d + 1][d] = -1;
+    s.offsets[2 * d + 2][d] = 1;
+  }
+  return s;
+}
+
+//
+// Central difference along the dimension `axis` for the grid spacing h.
+//
+template<std::size_t D, typename X>
+constexpr auto central_difference(std::size_t axis, const X& h) noexcept {
+  using C = Quotient_unit<scalar, internal::Coherent_of<X>>;
+  const TU_TYPE w = (TU_TYPE)0.5 / h.base_value;
+  Stencil<C, D, 2> s{{}, {C(-w), C(w)}};
+  s.offsets[0][axis] = -1;
+  s.offsets[1][axis] = 1;
+  return s;
+}
+
+namespace internal {
+//
+// Width in x of the tiles a stencil is applied in.
+//
+inline constexpr std::size_t stencil_block = 64;
+
+//
+// Height in y of the tiles a stencil is applied in.
+//
+inline constexpr std::size_t stencil_rows = 16;
+
+//
+// Apply a stencil to the tiles [first, last). A tile is stencil_block cells in
+// x times stencil_rows cells in y and is swept through all z so that the
+// neighbouring rows stay in cache. Each row of a tile is summed point by point
+// in a local buffer, which the compiler can vectorize.
+//
+template<typename U, typename V, std::size_t D, std::size_t N>
+void apply_tiles(const std::array<TU_TYPE, N>& weights, const std::array<std::ptrdiff_t, N>& shifts,
+                 const Grid<U, D>& in, Grid<V, D>& out, std::size_t first, std::size_t last) noexcept {
+  const std::size_t nx = in.extent()[0];
+  const std::size_t ny = in.extent()[1];
+  const std::size_t nz = D == 3 ? in.extent()[D - 1] : 1;
+  const std::size_t x_tiles = (nx + stencil_block - 1) / stencil_block;
+  const U* source = in.data().data();
+  V* target = out.data().data();
+  for (std::size_t tile = first; tile < last; ++tile) {
+    const std::size_t x0 = tile % x_tiles * stencil_block;
+    const std::size_t y0 = tile / x_tiles * stencil_rows;
+    const std::size_t width = std::min(stencil_block, nx - x0);
+    const std::size_t y1 = std::min(y0 + stencil_rows, ny);
+    for (std::size_t z = 0; z < nz; ++z) {
+      for (std::size_t y = y0; y < y1; ++y) {
+        typename Grid<U, D>::Index i{(std::ptrdiff_t)x0, (std::ptrdiff_t)y};
+        if constexpr (D == 3) {
+          i[2] = (std::ptrdiff_t)z;
+        }
+        const U* row = source + in.offset(i);
+        std::array<TU_TYPE, stencil_block> sum{};
+        for (std::size_t p = 0; p < N; ++p) {
+          const U* shifted = row + shifts[p];
+          const TU_TYPE w = weights[p];
+          for (std::size_t x = 0; x < width; ++x) {
+            sum[x] += w * shifted[x].base_value;
+          }
+        }
+        V* result = target + out.offset(i);
+        for (std::size_t x = 0; x < width; ++x) {
+          store(result[x], sum[x]);
+        }
+      }
+    }
+  }
+}
+} // namespace internal
+
+//
+// Apply the stencil s to the interior of `in` and write the result to the
+// interior of `out`, which must have the same extent. The halo of `in` must be
+// filled and at least as wide as the largest offset of the stencil. The grid
+// is processed in cache sized tiles which are split between `threads`
+// threads.
+//
+// Example:
+//   Grid<Quotient_unit<kelvin, metre_squared>, 2> curvature({512, 512}, 0);
+//   apply(laplacian<2>(metre(0.01f)), temperature, curvature, 8);
+//
+template<typename C, typename U, std::size_t D, std::size_t N>
+void apply(const Stencil<C, D, N>& s, const Grid<U, D>& in, Grid<Product_unit<C, U>, D>& out, std::size_t threads = 1) {
+  std::array<TU_TYPE, N> weights;
+  std::array<std::ptrdiff_t, N> shifts;
+  const std::ptrdiff_t center = (std::ptrdiff_t)in.offset({});
+  for (std::size_t p = 0; p < N; ++p) {
+    weights[p] = s.weights[p].base_value;
+    shifts[p] = (std::ptrdiff_t)in.offset(s.offsets[p]) - center;
+  }
+  const std::size_t x_tiles = (in.extent()[0] + internal::stencil_block - 1) / internal::stencil_block;
+  const std::size_t y_tiles = (in.extent()[1] + internal::stencil_rows - 1) / internal::stencil_rows;
+  const std::size_t tiles = x_tiles * y_tiles;
+  threads = std::max(std::min(threads, tiles), (std::size_t)1);
+  std::vector<std::jthread> workers;
+  workers.reserve(threads - 1);
+  for (std::size_t t = 1; t < threads; ++t) {
+    workers.push_back(internal::worker([&, t] { internal::apply_tiles(weights, shifts, in, out, tiles * (t - 1) / threads, tiles * t / threads); }));
+  }
+  internal::apply_tiles(weights, shifts, in, out, tiles * (threads - 1) / threads, tiles);
+}
+
+} // namespace tu
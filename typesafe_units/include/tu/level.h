@@ -0,0 +1,181 @@
+#pragma once
+
+#include <numbers>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "fast_math.h"
+
+namespace tu {
+
+//
+// Logarithmic levels expressed in decibel.
+// A power quantity (e.g. watt) has the level 10 log10(P / P0) and a root-power
+// quantity (e.g. volt) has the level 20 log10(F / F0).
+//
+enum struct level_kind {
+  power = 10,
+  root_power = 20
+};
+
+namespace internal {
+template<typename Reference>
+struct Level_reference;
+
+template<prefix pf, typename U>
+requires (U::base_adder == (TU_TYPE)0.0)
+struct Level_reference<Unit<pf, U>> {
+  using Linear = Coherent_of<U>;
+  static constexpr TU_TYPE base_value = U::base_multiplier * pow10<(int)pf>();
+};
+} // namespace internal
+
+//
+// Ratio of two quantities of the same kind expressed in decibel. Adding gains
+// corresponds to multiplying the ratios.
+//
+struct Gain {
+  constexpr Gain() noexcept = default;
+  constexpr Gain(TU_TYPE db) noexcept : value(db) {}
+
+  static constexpr Gain from_neper(TU_TYPE np) noexcept {
+    return {np * decibel_per_neper};
+  }
+
+  constexpr TU_TYPE neper() const noexcept {
+    return value / decibel_per_neper;
+  }
+
+  auto operator <=> (const Gain& other) const noexcept = default;
+
+  static constexpr TU_TYPE decibel_per_neper = (TU_TYPE)20.0 / std::numbers::ln10_v<TU_TYPE>;
+  const TU_TYPE value{0.0};
+};
+
+constexpr Gain operator + (Gain l, Gain r) noexcept {
+  return {l.value + r.value};
+}
+
+constexpr Gain operator - (Gain l, Gain r) noexcept {
+  return {l.value - r.value};
+}
+
+//
+// Level of a quantity relative to the typed reference `Reference`, e.g. dBm is
+// a power level relative to `Unit<prefix::milli, watt>`. The member `value` is
+// the level in decibel.
+// Levels are created from linear quantities with the same dimension as the
+// reference and converted back with `linear()`. Adding a Gain to a Level
+// scales the linear quantity. The difference between two levels is a Gain.
+//
+// Example:
+//   dBm p(Unit<prefix::no_prefix, watt>(1.0f));
+//   std::cout << p.value << std::endl; // prints 30
+//   dBm p2 = p + Gain(-3.0f);
+//   std::cout << p2.linear().base_value << std::endl; // prints 0.501187
+//
+template<typename Reference, level_kind kind = level_kind::power>
+struct Level {
+  using Linear = typename internal::Level_reference<Reference>::Linear;
+  static constexpr TU_TYPE reference_base_value = internal::Level_reference<Reference>::base_value;
+  static constexpr TU_TYPE factor = (TU_TYPE)kind;
+
+  constexpr Level() noexcept = default;
+
+  static constexpr Level from_decibel(TU_TYPE db) noexcept {
+    return Level(db, 0);
+  }
+
+  static constexpr Level from_neper(TU_TYPE np) noexcept {
+    return Level(np * Gain::decibel_per_neper, 0);
+  }
+
+  template<typename V>
+  requires (std::derived_from<V, internal::Unit_fundament> && std::is_same<typename V::Base, typename Linear::Base>::value)
+  Level(const V& linear) noexcept : value(factor * std::log10(linear.base_value / reference_base_value)) {}
+
+  //
+  // Convert a level with a different reference of the same dimension.
+  //
+  template<typename Other_reference>
+  requires (std::is_same<typename Level<Other_reference, kind>::Linear, Linear>::value)
+  Level(const Level<Other_reference, kind>& other) noexcept
+  : value(other.value + factor * std::log10(Level<Other_reference, kind>::reference_base_value / reference_base_value)) {}
+
+  Linear linear() const noexcept {
+    return Linear(reference_base_value * std::pow((TU_TYPE)10.0, value / factor));
+  }
+
+  constexpr TU_TYPE neper() const noexcept {
+    return value / Gain::decibel_per_neper;
+  }
+
+  auto operator <=> (const Level& other) const noexcept = default;
+
+  const TU_TYPE value{0.0};
+
+private:
+  constexpr Level(TU_TYPE db, int) noexcept : value(db) {}
+};
+
+template<typename Reference, level_kind kind>
+constexpr Level<Reference, kind> operator + (const Level<Reference, kind>& l, Gain r) noexcept {
+  return Level<Reference, kind>::from_decibel(l.value + r.value);
+}
+
+template<typename Reference, level_kind kind>
+constexpr Level<Reference, kind> operator + (Gain l, const Level<Reference, kind>& r) noexcept {
+  return Level<Reference, kind>::from_decibel(l.value + r.value);
+}
+
+template<typename Reference, level_kind kind>
+constexpr Level<Reference, kind> operator - (const Level<Reference, kind>& l, Gain r) noexcept {
+  return Level<Reference, kind>::from_decibel(l.value - r.value);
+}
+
+template<typename Reference, level_kind kind>
+constexpr Gain operator - (const Level<Reference, kind>& l, const Level<Reference, kind>& r) noexcept {
+  return {l.value - r.value};
+}
+
+//
+// Common levels.
+//
+using dBW = Level<Unit<prefix::no_prefix, watt>>;
+using dBm = Level<Unit<prefix::milli, watt>>;
+using dBV = Level<Unit<prefix::no_prefix, volt>, level_kind::root_power>;
+using dBuV = Level<Unit<prefix::micro, volt>, level_kind::root_power>;
+
+//
+// Batch conversion between linear quantities and levels using `fast_log2` and
+// `fast_exp2`. Linear values must be positive and normal. Both spans must have
+// the same size.
+//
+// Example:
+//   std::vector<watt> p(n);
+//   std::vector<dBm> l(n);
+//   to_level<dBm>(std::span<const watt>(p), std::span<dBm>(l));
+//
+template<typename L, typename V>
+requires std::is_same<typename V::Base, typename L::Linear::Base>::value
+void to_level(std::span<const V> linear, std::span<L> out) noexcept {
+  constexpr TU_TYPE scale = L::factor * std::numbers::ln2_v<TU_TYPE> / std::numbers::ln10_v<TU_TYPE>;
+  const TU_TYPE offset = L::factor * std::log10(L::reference_base_value);
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    std::construct_at(&out[i], L::from_decibel(scale * internal::fast_log2(linear[i].base_value) - offset));
+  }
+}
+
+template<typename L>
+void to_linear(std::span<const L> levels, std::span<typename L::Linear> out) noexcept {
+  constexpr TU_TYPE scale = std::numbers::ln10_v<TU_TYPE> / (L::factor * std::numbers::ln2_v<TU_TYPE>);
+  const TU_TYPE offset = std::log2(L::reference_base_value);
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    internal::store(out[i], internal::fast_exp2(levels[i].value * scale + offset));
+  }
+}
+
+} // namespace tu
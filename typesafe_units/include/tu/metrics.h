@@ -0,0 +1,530 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+namespace internal {
+//
+// OpenMetrics unit of the dimension with the powers p..., e.g. "seconds",
+// "joules" or "meters_per_second_squared", and "" for dimensionless
+// quantities. Named SI units with integer powers use their name, others are
+// built from the base units: positive powers in the plural, negative powers
+// after "per" in the singular, and powers other than one with "squared",
+// "cubed" or "pow".
+//
+template<typename... p>
+inline constexpr auto metric_unit_name = [] {
+  constexpr const char* plural[] = {"seconds", "meters", "kilograms", "amperes", "kelvin", "moles", "candela"};
+  constexpr const char* singular[] = {"second", "meter", "kilogram", "ampere", "kelvin", "mole", "candela"};
+  struct Named {
+    std::intmax_t power[7];
+    const char* name;
+  };
+  constexpr Named named[] = {
+    {{-2, 2, 1, 0, 0, 0, 0}, "joules"},
+    {{-3, 2, 1, 0, 0, 0, 0}, "watts"},
+    {{-3, 2, 1, -1, 0, 0, 0}, "volts"},
+    {{-2, 1, 1, 0, 0, 0, 0}, "newtons"},
+    {{-2, -1, 1, 0, 0, 0, 0}, "pascals"},
+    {{1, 0, 0, 1, 0, 0, 0}, "coulombs"},
+    {{-3, 2, 1, -2, 0, 0, 0}, "ohms"},
+    {{-1, 0, 0, 0, 0, 0, 0}, "hertz"},
+  };
+  constexpr std::intmax_t num[] = {p::num..., 0};
+  constexpr std::intmax_t den[] = {p::den..., 1};
+  std::array<char, 160> name{};
+  std::size_t n = 0;
+  const auto append = [&](const char* s) {
+    for (; *s != '\0'; ++s) {
+      name[n++] = *s;
+    }
+  };
+  const auto append_number = [&](std::intmax_t v) {
+    char digits[24]{};
+    std::size_t d = 0;
+    do {
+      digits[d++] = (char)('0' + v % 10);
+      v /= 10;
+    } while (v > 0);
+    while (d > 0) {
+      name[n++] = digits[--d];
+    }
+  };
+  const auto append_power = [&](std::intmax_t v, std::intmax_t d) {
+    if (v == 2 && d == 1) {
+      append("_squared");
+    } else if (v == 3 && d == 1) {
+      append("_cubed");
+    } else if (v != 1 || d != 1) {
+      append("_pow_");
+      append_number(v);
+      if (d != 1) {
+        append("_");
+        append_number(d);
+      }
+    }
+  };
+  for (const Named& u : named) {
+    bool same = true;
+    for (std::size_t i = 0; i < sizeof...(p); ++i) {
+      same = same && den[i] == 1 && num[i] == u.power[i];
+    }
+    if (same) {
+      append(u.name);
+      return name;
+    }
+  }
+  for (std::size_t i = 0; i < sizeof...(p); ++i) {
+    if (num[i] > 0) {
+      if (n > 0) {
+        append("_");
+      }
+      append(plural[i]);
+      append_power(num[i], den[i]);
+    }
+  }
+  for (std::size_t i = 0; i < sizeof...(p); ++i) {
+    if (num[i] < 0) {
+      append(n > 0 ? "_per_" : "per_");
+      append(singular[i]);
+      append_power(-num[i], den[i]);
+    }
+  }
+  return name;
+}();
+
+//
+// OpenMetrics unit of the unit U, e.g. "seconds" for Unit<prefix::milli, second>.
+//
+template<typename U>
+constexpr const char* metric_unit_of() noexcept {
+  return []<typename... p>(const Coherent_unit_base<p...>*) {
+    return metric_unit_name<p...>.data();
+  }(static_cast<const typename U::Base*>(nullptr));
+}
+
+//
+// Longest text of a rendered value.
+//
+inline constexpr std::size_t max_value_chars = 32;
+
+inline char* write_value(char* p, TU_TYPE v) noexcept {
+  if (std::isnan(v)) {
+    return std::copy_n("NaN", 3, p);
+  }
+  if (std::isinf(v)) {
+    return std::copy_n(v > 0 ? "+Inf" : "-Inf", 4, p);
+  }
+  return std::to_chars(p, p + max_value_chars, v).ptr;
+}
+
+inline char* write_count(char* p, std::uint64_t v) noexcept {
+  return std::to_chars(p, p + max_value_chars, v).ptr;
+}
+
+//
+// s as an escaped-string of OpenMetrics, for label values and help texts.
+//
+inline void append_escaped(std::string& out, std::string_view s) {
+  for (const char c : s) {
+    if (c == '\\') {
+      out += "\\\\";
+    } else if (c == '\n') {
+      out += "\\n";
+    } else if (c == '"') {
+      out += "\\\"";
+    } else {
+      out += c;
+    }
+  }
+}
+
+//
+// Value of a gauge or counter series, as a base value.
+//
+struct Metric_value {
+  std::atomic<TU_TYPE> value{(TU_TYPE)0.0};
+};
+
+//
+// Buckets of a histogram series. counts[i] holds the observations in
+// (bounds[i - 1], bounds[i]] and counts[bounds.size()] those above the last
+// bound, and NaN.
+//
+struct Metric_buckets {
+  explicit Metric_buckets(std::vector<TU_TYPE> b) : bounds(std::move(b)), counts(new std::atomic<std::uint64_t>[bounds.size() + 1]) {
+    for (std::size_t i = 0; i <= bounds.size(); ++i) {
+      counts[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<TU_TYPE> bounds;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> counts;
+  std::atomic<TU_TYPE> sum{(TU_TYPE)0.0};
+};
+} // namespace internal
+
+//
+// Label names and values of a series, e.g. {{"method", "GET"}, {"code", "200"}}.
+//
+using Metric_labels = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+//
+// Gauge of the unit U that holds its value in the coherent unit, e.g. a
+// temperature in kelvin. It can be copied and used from any thread.
+//
+template<typename U>
+requires std::derived_from<U, internal::Unit_fundament>
+class Gauge {
+public:
+  explicit Gauge(internal::Metric_value& v) noexcept : v(&v) {}
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  void set(const V& value) noexcept {
+    v->value.store(value.base_value, std::memory_order_relaxed);
+  }
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  void add(const V& value) noexcept {
+    v->value.fetch_add(value.base_value, std::memory_order_relaxed);
+  }
+
+  internal::Coherent_of<U> get() const noexcept {
+    return internal::Coherent_of<U>(v->value.load(std::memory_order_relaxed));
+  }
+
+private:
+  internal::Metric_value* v;
+};
+
+//
+// Counter of the unit U, e.g. the energy used in joule or the busy time in
+// second. Increments must not be negative.
+//
+template<typename U>
+requires std::derived_from<U, internal::Unit_fundament>
+class Counter {
+public:
+  explicit Counter(internal::Metric_value& v) noexcept : v(&v) {}
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  void add(const V& increment) noexcept {
+    v->value.fetch_add(increment.base_value, std::memory_order_relaxed);
+  }
+
+  internal::Coherent_of<U> get() const noexcept {
+    return internal::Coherent_of<U>(v->value.load(std::memory_order_relaxed));
+  }
+
+private:
+  internal::Metric_value* v;
+};
+
+//
+// Histogram of observations of the unit U in buckets with upper bounds given
+// at registration, e.g. request durations in Unit<prefix::milli, second>.
+//
+template<typename U>
+requires std::derived_from<U, internal::Unit_fundament>
+class Histogram {
+public:
+  explicit Histogram(internal::Metric_buckets& b) noexcept : b(&b) {}
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  void observe(const V& value) noexcept {
+    const TU_TYPE x = value.base_value;
+    std::size_t i = 0;
+    // NaN is counted in the unbounded bucket.
+    while (i < b->bounds.size() && !(x <= b->bounds[i])) {
+      ++i;
+    }
+    b->counts[i].fetch_add(1, std::memory_order_relaxed);
+    b->sum.fetch_add(x, std::memory_order_relaxed);
+  }
+
+private:
+  internal::Metric_buckets* b;
+};
+
+//
+// Registry of gauges, counters and histograms typed by units that renders
+// them as OpenMetrics text, e.g. for a Prometheus scrape. Values are
+// rendered in the coherent SI unit, and the unit and its suffix of the
+// family name, e.g. "_seconds" or "_joules", follow from the dimension of
+// the unit at compile time, so that a duration in milliseconds is exposed as
+// seconds. Dimensionless quantities have no unit; a count of bytes is a
+// dimensionless counter with a name that ends in "_bytes".
+//
+// Registering a series with a name and labels that exist returns the
+// existing series. A family name must not be registered with two metric
+// types. Registration and rendering lock the registry, updates of the series
+// do not. The labels and the text around the values are rendered at
+// registration, so rendering only writes the values into a buffer that is
+// reused between scrapes.
+//
+// Example:
+//   Metrics_registry metrics;
+//   auto latency = metrics.histogram<Unit<prefix::milli, second>>("http_request_duration", "Request latency.",
+//     {Unit<prefix::milli, second>(5.0f), Unit<prefix::milli, second>(50.0f)}, {{"method", "GET"}});
+//   auto energy = metrics.counter<Unit<prefix::kilo, joule>>("cpu_energy", "Energy used by the CPU.");
+//   latency.observe(Unit<prefix::milli, second>(12.0f));
+//   energy.add(Unit<prefix::kilo, joule>(1.5f));
+//   std::string_view text = metrics.render();
+//   // # TYPE http_request_duration_seconds histogram
+//   // # UNIT http_request_duration_seconds seconds
+//   // # HELP http_request_duration_seconds Request latency.
+//   // http_request_duration_seconds_bucket{method="GET",le="0.005"} 0
+//   // ...
+//   // cpu_energy_joules_total 1500
+//   // # EOF
+//
+class Metrics_registry {
+public:
+  Metrics_registry() = default;
+  Metrics_registry(const Metrics_registry&) = delete;
+  Metrics_registry& operator = (const Metrics_registry&) = delete;
+
+  template<typename U>
+  requires std::derived_from<U, internal::Unit_fundament>
+  Gauge<U> gauge(std::string_view name, std::string_view help, Metric_labels labels = {}) {
+    return Gauge<U>(value_series(kind::gauge, name, internal::metric_unit_of<U>(), help, labels));
+  }
+
+  template<typename U>
+  requires std::derived_from<U, internal::Unit_fundament>
+  Counter<U> counter(std::string_view name, std::string_view help, Metric_labels labels = {}) {
+    return Counter<U>(value_series(kind::counter, name, internal::metric_unit_of<U>(), help, labels));
+  }
+
+  //
+  // Histogram with the ascending bucket upper `bounds`, to which an
+  // unbounded bucket is added.
+  //
+  template<typename U, typename V = U>
+  requires (std::derived_from<U, internal::Unit_fundament> && internal::Same_dimension<V, U>)
+  Histogram<U> histogram(std::string_view name, std::string_view help, std::span<const V> bounds, Metric_labels labels = {}) {
+    std::vector<TU_TYPE> b;
+    b.reserve(bounds.size());
+    for (const V& v : bounds) {
+      b.push_back(v.base_value);
+    }
+    return Histogram<U>(bucket_series(name, internal::metric_unit_of<U>(), help, std::move(b), labels));
+  }
+
+  //
+  // The bounds are taken in the coherent unit of U, so that they are not
+  // rounded by a conversion to U.
+  //
+  template<typename U>
+  requires std::derived_from<U, internal::Unit_fundament>
+  Histogram<U> histogram(std::string_view name, std::string_view help, std::initializer_list<internal::Coherent_of<U>> bounds,
+                         Metric_labels labels = {}) {
+    using C = internal::Coherent_of<U>;
+    return histogram<U, C>(name, help, std::span<const C>(bounds.begin(), bounds.size()), labels);
+  }
+
+  //
+  // The OpenMetrics text of all series. It stays valid until the next call
+  // of render.
+  //
+  std::string_view render() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffer.size() < capacity) {
+      buffer.resize(capacity);
+    }
+    char* p = buffer.data();
+    for (const Family& f : families) {
+      p = std::copy(f.header.begin(), f.header.end(), p);
+      for (const Series& s : f.series) {
+        p = std::copy(s.text.begin(), s.text.begin() + s.end[0], p);
+        if (s.value != nullptr) {
+          p = internal::write_value(p, s.value->value.load(std::memory_order_relaxed));
+          *p++ = '\n';
+          continue;
+        }
+        // Buckets are cumulative, followed by the count and the sum.
+        const internal::Metric_buckets& b = *s.buckets;
+        std::uint64_t count = 0;
+        for (std::size_t i = 0; i <= b.bounds.size(); ++i) {
+          count += b.counts[i].load(std::memory_order_relaxed);
+          p = internal::write_count(p, count);
+          p = std::copy(s.text.begin() + s.end[i], s.text.begin() + s.end[i + 1], p);
+        }
+        p = internal::write_count(p, count);
+        p = std::copy(s.text.begin() + s.end[b.bounds.size() + 1], s.text.end(), p);
+        p = internal::write_value(p, b.sum.load(std::memory_order_relaxed));
+        *p++ = '\n';
+      }
+    }
+    p = std::copy_n("# EOF\n", 6, p);
+    return std::string_view(buffer.data(), p - buffer.data());
+  }
+
+  std::size_t series() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return value_index.size() + bucket_index.size();
+  }
+
+private:
+  enum struct kind {
+    gauge,
+    counter,
+    histogram
+  };
+
+  //
+  // A series with its text before the first value in text[0, end[0]). A
+  // histogram has the text after each bucket count in text[end[i],
+  // end[i + 1]) and the text before the sum after the last end.
+  //
+  struct Series {
+    std::string text;
+    std::vector<std::size_t> end;
+    internal::Metric_value* value;
+    internal::Metric_buckets* buckets;
+  };
+
+  struct Family {
+    std::string header;
+    std::vector<Series> series;
+  };
+
+  static std::string family_name(std::string_view name, const char* unit) {
+    std::string full(name);
+    const std::string_view u(unit);
+    if (!u.empty() && !(full.size() > u.size() && full.ends_with(u) && full[full.size() - u.size() - 1] == '_')) {
+      full += '_';
+      full += u;
+    }
+    return full;
+  }
+
+  static std::string label_text(Metric_labels labels, std::string_view extra_name = {}, std::string_view extra_value = {}) {
+    std::string text;
+    if (labels.size() == 0 && extra_name.empty()) {
+      return text;
+    }
+    text += '{';
+    bool first = true;
+    const auto add = [&](std::string_view n, std::string_view v) {
+      if (!first) {
+        text += ',';
+      }
+      first = false;
+      text += n;
+      text += "=\"";
+      internal::append_escaped(text, v);
+      text += '"';
+    };
+    for (const auto& [n, v] : labels) {
+      add(n, v);
+    }
+    if (!extra_name.empty()) {
+      add(extra_name, extra_value);
+    }
+    text += '}';
+    return text;
+  }
+
+  Family& family(kind k, const std::string& full, const char* unit, std::string_view help) {
+    const auto [it, inserted] = family_index.try_emplace(full, families.size());
+    if (!inserted) {
+      return families[it->second];
+    }
+    static constexpr const char* types[] = {"gauge", "counter", "histogram"};
+    Family f;
+    f.header = "# TYPE " + full + " " + types[(int)k] + "\n";
+    if (*unit != '\0') {
+      f.header += "# UNIT " + full + " " + unit + "\n";
+    }
+    if (!help.empty()) {
+      f.header += "# HELP " + full + " ";
+      internal::append_escaped(f.header, help);
+      f.header += "\n";
+    }
+    capacity += f.header.size();
+    families.push_back(std::move(f));
+    return families.back();
+  }
+
+  internal::Metric_value& value_series(kind k, std::string_view name, const char* unit, std::string_view help, Metric_labels labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string full = family_name(name, unit);
+    const std::string labelled = full + label_text(labels);
+    if (const auto it = value_index.find(labelled); it != value_index.end()) {
+      return *it->second;
+    }
+    Family& f = family(k, full, unit, help);
+    internal::Metric_value& v = values.emplace_back();
+    Series s{full + (k == kind::counter ? "_total" : "") + label_text(labels) + " ", {}, &v, nullptr};
+    s.end.push_back(s.text.size());
+    capacity += s.text.size() + internal::max_value_chars + 1;
+    f.series.push_back(std::move(s));
+    value_index.emplace(labelled, &v);
+    return v;
+  }
+
+  internal::Metric_buckets& bucket_series(std::string_view name, const char* unit, std::string_view help, std::vector<TU_TYPE> bounds,
+                                          Metric_labels labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string full = family_name(name, unit);
+    const std::string labelled = full + label_text(labels);
+    if (const auto it = bucket_index.find(labelled); it != bucket_index.end()) {
+      return *it->second;
+    }
+    Family& f = family(kind::histogram, full, unit, help);
+    internal::Metric_buckets& b = buckets.emplace_back(std::move(bounds));
+    Series s{{}, {}, nullptr, &b};
+    char le[internal::max_value_chars];
+    for (std::size_t i = 0; i <= b.bounds.size(); ++i) {
+      const std::string_view bound = i < b.bounds.size() ? std::string_view(le, internal::write_value(le, b.bounds[i]) - le) : "+Inf";
+      if (i > 0) {
+        s.text += "\n";
+      }
+      s.text += full + "_bucket" + label_text(labels, "le", bound) + " ";
+      s.end.push_back(s.text.size());
+    }
+    s.text += "\n" + full + "_count" + label_text(labels) + " ";
+    s.end.push_back(s.text.size());
+    s.text += "\n" + full + "_sum" + label_text(labels) + " ";
+    capacity += s.text.size() + (b.bounds.size() + 3) * internal::max_value_chars + 1;
+    f.series.push_back(std::move(s));
+    bucket_index.emplace(labelled, &b);
+    return b;
+  }
+
+  mutable std::mutex mutex;
+  std::deque<internal::Metric_value> values;
+  std::deque<internal::Metric_buckets> buckets;
+  std::vector<Family> families;
+  std::unordered_map<std::string, std::size_t> family_index;
+  std::unordered_map<std::string, internal::Metric_value*> value_index;
+  std::unordered_map<std::string, internal::Metric_buckets*> bucket_index;
+  std::vector<char> buffer;
+  std::size_t capacity = 6;
+};
+
+} // namespace tu
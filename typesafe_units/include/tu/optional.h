@@ -0,0 +1,234 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "calculus.h"
+
+namespace tu {
+
+namespace internal {
+using Optional_bits = std::conditional_t<std::is_same_v<TU_TYPE, float>, std::uint32_t, std::uint64_t>;
+
+//
+// Quiet NaN with a payload that marks a missing value. NaN results of
+// operations have no payload on common hardware, so they are present values,
+// while operations on a missing value usually keep its payload.
+//
+inline constexpr Optional_bits missing_bits = std::is_same_v<TU_TYPE, float> ? (Optional_bits)0x7fc004d5u
+                                                                             : (Optional_bits)0x7ff80000000004d5u;
+
+//
+// All ones if the bits are not those of a missing value, else zero, for
+// masking without comparisons on floating point values, which GCC does not
+// vectorize.
+//
+constexpr Optional_bits present_mask(Optional_bits bits) noexcept {
+  return (Optional_bits)0 - (Optional_bits)(bits != missing_bits);
+}
+} // namespace internal
+
+//
+// Quantity of the unit U, e.g. Unit<prefix::kilo, watt>, that may be missing.
+// The value is stored in U as one TU_TYPE and a missing value is a NaN with a
+// reserved payload, so an Optional_quantity has the size of TU_TYPE and arrays
+// of them need no validity bitmap. A NaN that results from an operation is a
+// present value.
+//
+// Example:
+//   std::vector<Optional_quantity<Unit<prefix::kilo, watt>>> power(n);     // all missing
+//   power[3] = Unit<prefix::kilo, watt>(1.5f);
+//   auto mean_power = mean(std::span<const Optional_quantity<Unit<prefix::kilo, watt>>>(power));
+//   if (mean_power) std::cout << mean_power.value().base_value << std::endl;  // prints 1500
+//
+template<typename U>
+requires std::derived_from<U, internal::Unit_fundament>
+class Optional_quantity {
+public:
+  using Unit_type = U;
+
+  constexpr Optional_quantity() noexcept : value_(std::bit_cast<TU_TYPE>(internal::missing_bits)) {}
+
+  constexpr Optional_quantity(std::nullopt_t) noexcept : Optional_quantity() {}
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  Optional_quantity(const V& v) noexcept : value_(stored(v)) {}
+
+  constexpr bool has_value() const noexcept {
+    return std::bit_cast<internal::Optional_bits>(value_) != internal::missing_bits;
+  }
+
+  constexpr explicit operator bool() const noexcept {
+    return has_value();
+  }
+
+  //
+  // The value, which must be present.
+  //
+  U value() const noexcept {
+    return U(value_);
+  }
+
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  U value_or(const V& fallback) const noexcept {
+    return has_value() ? U(value_) : U(fallback);
+  }
+
+  //
+  // The stored value in U, NaN with the reserved payload if missing.
+  //
+  constexpr TU_TYPE raw() const noexcept {
+    return value_;
+  }
+
+private:
+  template<typename V>
+  static TU_TYPE stored(const V& v) noexcept {
+    if constexpr (internal::Coherent<U>) {
+      return U(v).base_value;
+    } else {
+      return U(v).value;
+    }
+  }
+
+  TU_TYPE value_;
+};
+
+static_assert(sizeof(Optional_quantity<Unit<prefix::kilo, watt>>) == sizeof(TU_TYPE));
+
+namespace internal {
+//
+// The base value of the stored value x of an Optional_quantity<U>, and 0 if x
+// is missing.
+//
+template<typename U>
+TU_TYPE present_base_value(TU_TYPE x) noexcept {
+  const TU_TYPE base = x * Unit_scale<U>::multiplier + Unit_scale<U>::adder;
+  return std::bit_cast<TU_TYPE>(std::bit_cast<Optional_bits>(base) & present_mask(std::bit_cast<Optional_bits>(x)));
+}
+} // namespace internal
+
+//
+// mask[i] is whether values[i] is present.
+//
+template<typename U>
+void is_present(std::span<const Optional_quantity<U>> values, std::span<bool> mask) noexcept {
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    mask[i] = std::bit_cast<internal::Optional_bits>(values[i].raw()) != internal::missing_bits;
+  }
+}
+
+//
+// Number of present values.
+//
+template<typename U>
+std::size_t count_present(std::span<const Optional_quantity<U>> values) noexcept {
+  std::size_t count = 0;
+  for (const auto& v : values) {
+    count += std::bit_cast<internal::Optional_bits>(v.raw()) != internal::missing_bits;
+  }
+  return count;
+}
+
+namespace internal {
+using Ordered_bits = std::make_signed_t<Optional_bits>;
+
+//
+// The bits of x as a signed integer that orders like x, with NaN beyond the
+// infinity of its sign. The mapping is its own inverse.
+//
+constexpr Ordered_bits ordered_bits(Ordered_bits b) noexcept {
+  return b ^ ((b >> (sizeof(Ordered_bits) * 8 - 1)) & std::numeric_limits<Ordered_bits>::max());
+}
+
+//
+// Smallest or largest present base value. The values are compared as
+// ordered_bits in sum_lanes partial results, since GCC does not vectorize
+// selects on floating point conditions, and missing values are replaced by
+// the identity of the reduction. That identity is the bits of a NaN, so a
+// result equal to it is taken as missing.
+//
+template<typename U, bool max>
+Optional_quantity<Coherent_of<U>> present_extremum(std::span<const Optional_quantity<U>> values) noexcept {
+  constexpr Ordered_bits fill = max ? std::numeric_limits<Ordered_bits>::min() : std::numeric_limits<Ordered_bits>::max();
+  const auto key = [](TU_TYPE x) {
+    const Optional_bits mask = present_mask(std::bit_cast<Optional_bits>(x));
+    const Ordered_bits b = ordered_bits(std::bit_cast<Ordered_bits>(x * Unit_scale<U>::multiplier + Unit_scale<U>::adder));
+    return std::bit_cast<Ordered_bits>((std::bit_cast<Optional_bits>(b) & mask) | ((Optional_bits)fill & ~mask));
+  };
+  const auto select = [](Ordered_bits a, Ordered_bits b) { return max ? std::max(a, b) : std::min(a, b); };
+  std::array<Ordered_bits, sum_lanes> lanes;
+  lanes.fill(fill);
+  const std::size_t n = values.size();
+  std::size_t i = 0;
+  for (; i + sum_lanes <= n; i += sum_lanes) {
+    for (std::size_t l = 0; l < sum_lanes; ++l) {
+      lanes[l] = select(lanes[l], key(values[i + l].raw()));
+    }
+  }
+  for (; i < n; ++i) {
+    lanes[0] = select(lanes[0], key(values[i].raw()));
+  }
+  Ordered_bits extremum = fill;
+  for (const Ordered_bits b : lanes) {
+    extremum = select(extremum, b);
+  }
+  if (extremum == fill) {
+    return std::nullopt;
+  }
+  return Coherent_of<U>(std::bit_cast<TU_TYPE>(ordered_bits(extremum)));
+}
+} // namespace internal
+
+//
+// Sum of the present values in their coherent unit on `threads` threads,
+// skipping the missing ones without branches, with the execution policy P.
+// The sum of no values is 0.
+//
+// Example:
+//   joule total = sum(std::span<const Optional_quantity<Unit<prefix::kilo, joule>>>(readings), 8, policy::strict);
+//
+template<typename U, internal::Policy P = typename Default_policy<internal::Coherent_of<U>>::type>
+internal::Coherent_of<U> sum(std::span<const Optional_quantity<U>> values, std::size_t threads = 1, P = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  return internal::Coherent_of<U>(internal::parallel_sum<P>(
+    [values](std::size_t i) { return internal::present_base_value<U>(values[i].raw()); }, values.size(), threads));
+}
+
+//
+// Mean of the present values in their coherent unit, missing if none is.
+//
+template<typename U, internal::Policy P = typename Default_policy<internal::Coherent_of<U>>::type>
+Optional_quantity<internal::Coherent_of<U>> mean(std::span<const Optional_quantity<U>> values, std::size_t threads = 1, P policy = P{}) {
+  const internal::Denormal_scope<P> denormals;
+  const std::size_t n = count_present(values);
+  if (n == 0) {
+    return std::nullopt;
+  }
+  return internal::Coherent_of<U>(sum(values, threads, policy).base_value / (TU_TYPE)n);
+}
+
+//
+// Smallest and largest present value in their coherent unit, missing if none
+// is. A present NaN orders beyond the infinity of its sign.
+//
+template<typename U>
+Optional_quantity<internal::Coherent_of<U>> min(std::span<const Optional_quantity<U>> values) noexcept {
+  return internal::present_extremum<U, false>(values);
+}
+
+template<typename U>
+Optional_quantity<internal::Coherent_of<U>> max(std::span<const Optional_quantity<U>> values) noexcept {
+  return internal::present_extremum<U, true>(values);
+}
+
+} // namespace tu
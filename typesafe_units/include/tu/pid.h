@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+//
+// Forms of PID controllers.
+//   pid:  The derivative acts on the error.
+//   pi_d: The derivative acts on the measurement only, so setpoint steps do
+//         not give derivative kicks.
+//
+enum struct pid_form {
+  pid,
+  pi_d
+};
+
+//
+// Parameters of a PID controller from the process variable PV to the output
+// Out. The gains are typed Out / PV, Out / (PV s) and Out s / PV.
+// `derivative_filter` is the time constant of the first order filter on the
+// derivative term and `tracking` the time constant of the anti-windup, i.e.
+// how fast the integral is corrected when the output saturates at `lower` or
+// `upper`.
+//
+// Example:
+//   Pid_parameters<kelvin, watt> p{.kp = Quotient_unit<watt, kelvin>(50.0f),
+//                                  .ki = Quotient_unit<watt, Product_unit<kelvin, second>>(5.0f),
+//                                  .kd = Quotient_unit<Product_unit<watt, second>, kelvin>(10.0f),
+//                                  .derivative_filter = Unit<prefix::milli, second>(2.0f),
+//                                  .tracking = Unit<prefix::milli, second>(50.0f),
+//                                  .lower = watt(0.0f),
+//                                  .upper = Unit<prefix::kilo, watt>(2.0f)};
+//
+template<internal::Coherent PV, internal::Coherent Out>
+struct Pid_parameters {
+  Quotient_unit<Out, PV> kp;
+  Quotient_unit<Out, Product_unit<PV, second>> ki;
+  Quotient_unit<Product_unit<Out, second>, PV> kd;
+  second derivative_filter;
+  second tracking;
+  Out lower;
+  Out upper;
+};
+
+namespace internal {
+//
+// Coefficients of the discretized controller for the sampling period dt.
+// Backward Euler discretization of the filtered derivative and of the
+// anti-windup tracking.
+//
+struct Pid_coefficients {
+  template<typename PV, typename Out>
+  constexpr Pid_coefficients(const Pid_parameters<PV, Out>& p, TU_TYPE dt) noexcept
+  : kp(p.kp.base_value),
+    ki(p.ki.base_value * dt),
+    kd(p.kd.base_value / (p.derivative_filter.base_value + dt)),
+    pole(p.derivative_filter.base_value / (p.derivative_filter.base_value + dt)),
+    tracking(dt / p.tracking.base_value),
+    lower(p.lower.base_value),
+    upper(p.upper.base_value) {}
+
+  TU_TYPE kp;
+  TU_TYPE ki;
+  TU_TYPE kd;
+  TU_TYPE pole;
+  TU_TYPE tracking;
+  TU_TYPE lower;
+  TU_TYPE upper;
+};
+
+//
+// One step of a controller. The state is the integral, the filtered derivative
+// and the previous input of the derivative. Saturation uses min and max so
+// that loops over banks of controllers have no branches.
+//
+template<pid_form form>
+constexpr TU_TYPE pid_step(TU_TYPE setpoint, TU_TYPE measurement,
+                           TU_TYPE kp, TU_TYPE ki, TU_TYPE kd, TU_TYPE pole, TU_TYPE tracking, TU_TYPE lower, TU_TYPE upper,
+                           TU_TYPE& integral, TU_TYPE& derivative, TU_TYPE& previous) noexcept {
+  const TU_TYPE error = setpoint - measurement;
+  const TU_TYPE input = form == pid_form::pid ? error : -measurement;
+  derivative = pole * derivative + kd * (input - previous);
+  previous = input;
+  const TU_TYPE unsaturated = kp * error + integral + derivative;
+  const TU_TYPE output = std::min(std::max(unsaturated, lower), upper);
+  integral += ki * error + tracking * (output - unsaturated);
+  return output;
+}
+} // namespace internal
+
+//
+// PID controller with a fixed sampling period, anti-windup by back
+// calculation and a filtered derivative. The discretized coefficients are
+// computed at construction so `update` only does a few multiplications and
+// additions and never allocates or throws.
+// Call `reset` with the current setpoint and measurement before the first
+// update so that the derivative starts from the current state.
+//
+// Example:
+//   Pid<kelvin, watt> heater(p, Unit<prefix::micro, second>(50.0f));
+//   heater.reset(setpoint, measurement);
+//   watt power = heater.update(setpoint, measurement);
+//
+template<internal::Coherent PV, internal::Coherent Out, pid_form form = pid_form::pi_d>
+class Pid {
+public:
+  template<typename T>
+  requires internal::Same_dimension<T, second>
+  constexpr Pid(const Pid_parameters<PV, Out>& parameters, const T& period) noexcept : c(parameters, period.base_value) {}
+
+  template<typename S, typename M>
+  requires (internal::Same_dimension<S, PV> && internal::Same_dimension<M, PV>)
+  constexpr void reset(const S& setpoint, const M& measurement) noexcept {
+    integral = (TU_TYPE)0.0;
+    derivative = (TU_TYPE)0.0;
+    previous = form == pid_form::pid ? setpoint.base_value - measurement.base_value : -measurement.base_value;
+  }
+
+  template<typename S, typename M>
+  requires (internal::Same_dimension<S, PV> && internal::Same_dimension<M, PV>)
+  constexpr Out update(const S& setpoint, const M& measurement) noexcept {
+    return Out(internal::pid_step<form>(setpoint.base_value, measurement.base_value,
+                                        c.kp, c.ki, c.kd, c.pole, c.tracking, c.lower, c.upper,
+                                        integral, derivative, previous));
+  }
+
+private:
+  internal::Pid_coefficients c;
+  TU_TYPE integral{0.0};
+  TU_TYPE derivative{0.0};
+  TU_TYPE previous{0.0};
+};
+
+//
+// Bank of N controllers with the same sampling period that are updated
+// together. Coefficients and states are kept as structure of arrays so that
+// `update` is one loop without branches which the compiler can vectorize.
+// The controllers give the same results as N separate Pid controllers.
+//
+// Example:
+//   Pid_bank<radian, Product_unit<newton, metre>, 256> axes(p, Unit<prefix::micro, second>(50.0f));
+//   axes.update(std::span<const radian, 256>(target), std::span<const radian, 256>(angle), std::span<Product_unit<newton, metre>, 256>(torque));
+//
+template<internal::Coherent PV, internal::Coherent Out, std::size_t N, pid_form form = pid_form::pi_d>
+class Pid_bank {
+public:
+  //
+  // All controllers get the same parameters. Use `configure` to change them
+  // for single controllers.
+  //
+  template<typename T>
+  requires internal::Same_dimension<T, second>
+  constexpr Pid_bank(const Pid_parameters<PV, Out>& parameters, const T& period) noexcept : dt(period.base_value) {
+    for (std::size_t i = 0; i < N; ++i) {
+      configure(i, parameters);
+    }
+  }
+
+  constexpr void configure(std::size_t i, const Pid_parameters<PV, Out>& parameters) noexcept {
+    const internal::Pid_coefficients c(parameters, dt);
+    kp[i] = c.kp;
+    ki[i] = c.ki;
+    kd[i] = c.kd;
+    pole[i] = c.pole;
+    tracking[i] = c.tracking;
+    lower[i] = c.lower;
+    upper[i] = c.upper;
+  }
+
+  template<typename S, typename M>
+  requires (internal::Same_dimension<S, PV> && internal::Same_dimension<M, PV>)
+  constexpr void reset(std::span<const S, N> setpoint, std::span<const M, N> measurement) noexcept {
+    for (std::size_t i = 0; i < N; ++i) {
+      integral[i] = (TU_TYPE)0.0;
+      derivative[i] = (TU_TYPE)0.0;
+      previous[i] = form == pid_form::pid ? setpoint[i].base_value - measurement[i].base_value : -measurement[i].base_value;
+    }
+  }
+
+  template<typename S, typename M>
+  requires (internal::Same_dimension<S, PV> && internal::Same_dimension<M, PV>)
+  void update(std::span<const S, N> setpoint, std::span<const M, N> measurement, std::span<Out, N> out) noexcept {
+    for (std::size_t i = 0; i < N; ++i) {
+      internal::store(out[i], internal::pid_step<form>(setpoint[i].base_value, measurement[i].base_value,
+                                                       kp[i], ki[i], kd[i], pole[i], tracking[i], lower[i], upper[i],
+                                                       integral[i], derivative[i], previous[i]));
+    }
+  }
+
+private:
+  TU_TYPE dt;
+  std::array<TU_TYPE, N> kp{};
+  std::array<TU_TYPE, N> ki{};
+  std::array<TU_TYPE, N> kd{};
+  std::array<TU_TYPE, N> pole{};
+  std::array<TU_TYPE, N> tracking{};
+  std::array<TU_TYPE, N> lower{};
+  std::array<TU_TYPE, N> upper{};
+  std::array<TU_TYPE, N> integral{};
+  std::array<TU_TYPE, N> derivative{};
+  std::array<TU_TYPE, N> previous{};
+};
+
+} // namespace tu
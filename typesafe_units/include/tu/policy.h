@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+
+#include "typesafe_units.h"
+#include "denormal.h"
+
+namespace tu {
+
+//
+// Execution policies of the batch kernels, passed as the last argument or
+// selected for the unit of the result with `Default_policy`.
+//
+namespace policy {
+//
+// Results are bitwise reproducible: products are rounded before they are
+// added, never contracted to fused multiply-adds, and sums are added in
+// fixed blocks in a fixed order, so the result does not depend on the number
+// of threads.
+//
+struct Strict {};
+
+//
+// Results may differ in the last bits: the compiler may contract products and
+// sums to fused multiply-adds, and sums are split between the threads, so the
+// result depends on the number of threads.
+//
+struct Fast {};
+
+//
+// As strict, and sums are the same bits whatever the order of their terms:
+// the terms are split into folds at fixed powers of two, which are added
+// exactly. Slower than strict, but the result does not depend on the number
+// of threads, the blocks or the vector width on any IEEE 754 machine.
+//
+struct Reproducible {};
+
+//
+// As P, with subnormal inputs and results flushed to zero on the calling
+// thread and the workers while the kernel runs, see `Flush_denormals`.
+// Results that would be subnormal become zero, which makes kernels on tiny
+// quantities, e.g. in dalton or electronvolt in float, many times faster.
+//
+template<typename P = Fast>
+struct Flushed {};
+
+inline constexpr Strict strict{};
+inline constexpr Fast fast{};
+inline constexpr Reproducible reproducible{};
+inline constexpr Flushed<Fast> flushed{};
+} // namespace policy
+
+namespace internal {
+template<typename P>
+struct arithmetic_policy {
+  using type = P;
+};
+
+template<typename P>
+struct arithmetic_policy<policy::Flushed<P>> {
+  using type = P;
+};
+
+//
+// The policy P without the flushing of subnormal values.
+//
+template<typename P>
+using Arithmetic = typename arithmetic_policy<P>::type;
+
+template<typename P>
+concept Policy = std::same_as<Arithmetic<P>, policy::Strict> || std::same_as<Arithmetic<P>, policy::Fast> ||
+                 std::same_as<Arithmetic<P>, policy::Reproducible>;
+
+//
+// Flushes subnormal values to zero for the duration of a kernel with the
+// policy P if P is Flushed.
+//
+template<Policy P>
+struct Denormal_scope {
+  constexpr Denormal_scope() noexcept {}
+};
+
+template<typename P>
+struct Denormal_scope<policy::Flushed<P>> : Flush_denormals {};
+} // namespace internal
+
+//
+// Policy of the batch kernels with results of the coherent unit U when none
+// is passed. Specialize it to select the strict policy for a unit.
+//
+// Example:
+//   template<> struct tu::Default_policy<tu::joule> { using type = tu::policy::Strict; };
+//
+template<typename U>
+struct Default_policy {
+  using type = policy::Fast;
+};
+
+namespace internal {
+//
+// Forces the values written through p to memory, so that the compiler can
+// neither contract them with the operations that read them later nor
+// keep them in registers across the barrier.
+//
+inline void memory_barrier(const void* p) noexcept {
+#if defined(__GNUC__)
+  asm volatile("" : : "r"(p) : "memory");
+#else
+  (void)p;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+//
+// x rounded to TU_TYPE so that the compiler cannot contract the operation
+// that computed it with the one that uses it to a fused multiply-add. It
+// prevents vectorization of the loop it is in and is meant for loops that
+// are not vectorized anyway, or are elementwise.
+//
+inline TU_TYPE no_contract(TU_TYPE x) noexcept {
+#if defined(__GNUC__) && defined(__SSE2__)
+  asm("" : "+x"(x));
+#elif defined(__GNUC__) && defined(__aarch64__)
+  asm("" : "+w"(x));
+#elif defined(__GNUC__)
+  asm("" : "+m"(x));
+#else
+  const volatile TU_TYPE rounded = x;
+  x = rounded;
+#endif
+  return x;
+}
+
+//
+// x rounded as by no_contract under the strict and reproducible policies,
+// and x under the fast policy, also when flushed.
+//
+template<Policy P>
+TU_TYPE rounded(TU_TYPE x) noexcept {
+  if constexpr (!std::same_as<Arithmetic<P>, policy::Fast>) {
+    return no_contract(x);
+  } else {
+    return x;
+  }
+}
+} // namespace internal
+
+} // namespace tu
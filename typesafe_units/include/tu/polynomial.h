@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <cstddef>
+#include <utility>
+
+#include "typesafe_units.h"
+#include "fast_math.h"
+
+namespace tu {
+
+namespace internal {
+//
+// The dimension of coefficient i of a polynomial from X to Y, i.e. Y / X^i.
+//
+template<typename X, typename Y, std::size_t i>
+using Coefficient_unit = Quotient_unit<Coherent_of<Y>, Power_unit<Coherent_of<X>, std::ratio<i>>>;
+
+template<typename X, typename Y, typename... C, std::size_t... i>
+constexpr bool are_coefficients(std::index_sequence<i...>) noexcept {
+  return (std::is_same<typename C::Base, typename Coefficient_unit<X, Y, i>::Base>::value && ...);
+}
+
+//
+// The value of v expressed in the unit type T.
+//
+template<typename T, typename V>
+constexpr TU_TYPE value_in(const V& v) noexcept {
+  if constexpr (std::is_same_v<T, V> && !Coherent<T>) {
+    return v.value;
+  } else {
+    return (v.base_value - Unit_scale<T>::adder) / Unit_scale<T>::multiplier;
+  }
+}
+
+template<std::size_t N>
+constexpr TU_TYPE horner(const std::array<TU_TYPE, N>& c, TU_TYPE x) noexcept {
+  TU_TYPE y = c[N - 1];
+  for (std::size_t i = N - 1; i > 0; --i) {
+    y = mul_add(y, x, c[i - 1]);
+  }
+  return y;
+}
+} // namespace internal
+
+//
+// Polynomial y = c0 + c1 x + ... + c(N-1) x^(N-1) from the unit type X to the
+// unit type Y, where X and Y are Units or Coherent_units. Coefficient i has the
+// dimension Y / X^i, which is checked at compile time when the polynomial is
+// created from typed coefficients. The polynomial operates on the values of x
+// and y expressed in X and Y, so prefixes and shifted units such as
+// degree_Celsius are handled as in tables of calibration coefficients.
+//
+// Example:
+//   // Position from time.
+//   Polynomial<second, metre, 3> s(Unit<prefix::no_prefix, metre>(1.0f),
+//                                  Unit<prefix::no_prefix, metre_per_second>(2.0f),
+//                                  Quotient_unit<metre, second_squared>(0.5f));
+//   metre m = s(Unit<prefix::milli, second>(2000.0f)); // 7 m
+//
+//   // Thermocouple calibration with coefficients in degree Celsius per microvolt^i.
+//   constexpr auto k = Polynomial<Unit<prefix::micro, volt>, Unit<prefix::no_prefix, degree_Celsius>, 3>::from_values({0.0f, 2.5e-2f, 7.9e-8f});
+//
+template<typename X, typename Y, std::size_t N>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament> && N > 0)
+struct Polynomial {
+  template<typename... C>
+  requires (sizeof...(C) == N && (std::derived_from<C, internal::Unit_fundament> && ...) && internal::are_coefficients<X, Y, C...>(std::make_index_sequence<N>()))
+  Polynomial(const C&... c) noexcept : values(coefficient_values(std::make_index_sequence<N>(), c...)) {}
+
+  //
+  // Create from the coefficients expressed in units of Y / X^i.
+  //
+  static constexpr Polynomial from_values(const std::array<TU_TYPE, N>& values) noexcept {
+    return Polynomial(values);
+  }
+
+  template<typename V>
+  requires std::is_same<typename V::Base, typename X::Base>::value
+  Y operator () (const V& x) const noexcept {
+    return Y(internal::horner(values, internal::value_in<X>(x)));
+  }
+
+  //
+  // Coefficient i. Coefficient 0 is a Y and the others are Coherent_units.
+  //
+  template<std::size_t i>
+  requires (i < N)
+  auto coefficient() const noexcept {
+    if constexpr (i == 0) {
+      return Y(values[0]);
+    } else {
+      return internal::Coefficient_unit<X, Y, i>(values[i] * internal::Unit_scale<Y>::multiplier / x_multiplier_power<i>());
+    }
+  }
+
+  const std::array<TU_TYPE, N> values;
+
+private:
+  constexpr Polynomial(const std::array<TU_TYPE, N>& values) noexcept : values(values) {}
+
+  template<std::size_t i>
+  static constexpr TU_TYPE x_multiplier_power() noexcept {
+    TU_TYPE p = (TU_TYPE)1.0;
+    for (std::size_t k = 0; k < i; ++k) {
+      p *= internal::Unit_scale<X>::multiplier;
+    }
+    return p;
+  }
+
+  template<std::size_t... i, typename... C>
+  static std::array<TU_TYPE, N> coefficient_values(std::index_sequence<i...>, const C&... c) noexcept {
+    return {(i == 0 ? internal::value_in<Y>(c) : c.base_value * x_multiplier_power<i>() / internal::Unit_scale<Y>::multiplier)...};
+  }
+};
+
+//
+// Rational function y = p(x) / q(x) where p is a polynomial from X to Y and q
+// a dimensionless polynomial of x expressed in X.
+//
+template<typename X, typename Y, std::size_t N, std::size_t M>
+struct Rational_function {
+  template<typename V>
+  requires std::is_same<typename V::Base, typename X::Base>::value
+  Y operator () (const V& x) const noexcept {
+    const TU_TYPE xv = internal::value_in<X>(x);
+    return Y(internal::horner(numerator.values, xv) / internal::horner(denominator.values, xv));
+  }
+
+  Polynomial<X, Y, N> numerator;
+  Polynomial<X, scalar, M> denominator;
+};
+
+//
+// Batch evaluation out[i] = p(x[i]). Both spans must have the same size.
+//
+template<typename X, typename Y, std::size_t N>
+void evaluate(const Polynomial<X, Y, N>& p, std::span<const X> x, std::span<Y> out) noexcept {
+  const std::array<TU_TYPE, N> c = p.values;
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    std::construct_at(&out[i], internal::horner(c, internal::value_in<X>(x[i])));
+  }
+}
+
+template<typename X, typename Y, std::size_t N, std::size_t M>
+void evaluate(const Rational_function<X, Y, N, M>& r, std::span<const X> x, std::span<Y> out) noexcept {
+  const std::array<TU_TYPE, N> p = r.numerator.values;
+  const std::array<TU_TYPE, M> q = r.denominator.values;
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    const TU_TYPE xv = internal::value_in<X>(x[i]);
+    std::construct_at(&out[i], internal::horner(p, xv) / internal::horner(q, xv));
+  }
+}
+
+} // namespace tu
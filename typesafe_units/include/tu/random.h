@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <numbers>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "fast_math.h"
+
+namespace tu {
+
+namespace internal {
+//
+// Philox4x32-10 counter based random number generator (Salmon et al. 2011).
+// Maps a 128 bit counter and a 64 bit key to 128 random bits. The function has
+// no state, so loops that call it for consecutive counters can be vectorized.
+//
+constexpr std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> c, std::array<std::uint32_t, 2> k) noexcept {
+  constexpr std::uint64_t m0 = 0xD2511F53;
+  constexpr std::uint64_t m1 = 0xCD9E8D57;
+  constexpr std::uint32_t w0 = 0x9E3779B9;
+  constexpr std::uint32_t w1 = 0xBB67AE85;
+  for (int round = 0; round < 10; ++round) {
+    const std::uint64_t p0 = m0 * c[0];
+    const std::uint64_t p1 = m1 * c[2];
+    c = {(std::uint32_t)(p1 >> 32) ^ c[1] ^ k[0],
+         (std::uint32_t)p1,
+         (std::uint32_t)(p0 >> 32) ^ c[3] ^ k[1],
+         (std::uint32_t)p0};
+    k[0] += w0;
+    k[1] += w1;
+  }
+  return c;
+}
+
+//
+// Uniform values in [0, 1) built from the high bits of the random words.
+// The bits are placed in the mantissa of a value in [1, 2) which avoids
+// integer to floating point conversions that do not vectorize.
+// Float uses one word per value and double uses two.
+//
+constexpr TU_TYPE uniform(std::uint32_t w0, [[maybe_unused]] std::uint32_t w1) noexcept {
+  if constexpr (std::is_same_v<TU_TYPE, float>) {
+    return std::bit_cast<float>((w0 >> 9) | 0x3F800000u) - 1.0f;
+  } else {
+    return std::bit_cast<double>(((((std::uint64_t)w0 << 32) | w1) >> 12) | 0x3FF0000000000000ull) - 1.0;
+  }
+}
+} // namespace internal
+
+//
+// A reproducible stream of random numbers identified by a seed and a stream
+// number. Value number i of a stream only depends on seed, stream and i. Use
+// one stream per thread, or split one stream over several threads with
+// `discard`, to get results that do not depend on the number of threads.
+//
+// Example:
+//   Random_stream stream(2024, thread_index);
+//
+struct Random_stream {
+  constexpr Random_stream(std::uint64_t seed, std::uint64_t stream = 0) noexcept : seed(seed), stream(stream) {}
+
+  //
+  // Skip n values.
+  //
+  constexpr void discard(std::uint64_t n) noexcept {
+    counter += n;
+  }
+
+  //
+  // 128 random bits for value number i of the stream.
+  //
+  constexpr std::array<std::uint32_t, 4> bits(std::uint64_t i) const noexcept {
+    return internal::philox4x32({(std::uint32_t)i, (std::uint32_t)(i >> 32), (std::uint32_t)stream, (std::uint32_t)(stream >> 32)},
+                                {(std::uint32_t)seed, (std::uint32_t)(seed >> 32)});
+  }
+
+  std::uint64_t seed;
+  std::uint64_t stream;
+  std::uint64_t counter{0};
+};
+
+//
+// Distributions of typed quantities. The parameters can be given in any unit
+// with the same dimension as U and are stored as Coherent_units.
+//
+// Example:
+//   Normal_distribution<metre> position{Unit<prefix::milli, metre>(5.0f), Unit<prefix::micro, metre>(20.0f)};
+//   Exponential_distribution<second> arrival{Unit<prefix::kilo, hertz>(2.0f)};
+//   Uniform_distribution<radian> direction{Unit<prefix::no_prefix, degree>(0.0f), Unit<prefix::no_prefix, degree>(360.0f)};
+//
+template<internal::Coherent U>
+struct Uniform_distribution {
+  U low;
+  U high;
+};
+
+template<internal::Coherent U>
+struct Normal_distribution {
+  U mean;
+  U sigma;
+};
+
+template<internal::Coherent U>
+struct Exponential_distribution {
+  Quotient_unit<scalar, U> rate;
+};
+
+namespace internal {
+constexpr TU_TYPE sample(const std::array<std::uint32_t, 4>& w, TU_TYPE low, TU_TYPE width, Uniform_distribution<scalar>) noexcept {
+  return low + width * uniform(w[0], w[1]);
+}
+
+//
+// Box-Muller transform with the fast log2, sqrt and sin approximations.
+//
+constexpr TU_TYPE sample(const std::array<std::uint32_t, 4>& w, TU_TYPE mean, TU_TYPE sigma, Normal_distribution<scalar>) noexcept {
+  const TU_TYPE u1 = (TU_TYPE)1.0 - uniform(w[0], w[1]);
+  const TU_TYPE u2 = uniform(w[2], w[3]);
+  const TU_TYPE r = fast_sqrt((TU_TYPE)-2.0 * std::numbers::ln2_v<TU_TYPE> * fast_log2(u1));
+  return mean + sigma * r * fast_sin((TU_TYPE)2.0 * std::numbers::pi_v<TU_TYPE> * u2 - std::numbers::pi_v<TU_TYPE>);
+}
+
+constexpr TU_TYPE sample(const std::array<std::uint32_t, 4>& w, TU_TYPE inverse_rate, TU_TYPE, Exponential_distribution<scalar>) noexcept {
+  const TU_TYPE u = (TU_TYPE)1.0 - uniform(w[0], w[1]);
+  return -std::numbers::ln2_v<TU_TYPE> * fast_log2(u) * inverse_rate;
+}
+
+template<typename U>
+constexpr std::pair<TU_TYPE, TU_TYPE> parameters(const Uniform_distribution<U>& d) noexcept {
+  return {d.low.base_value, d.high.base_value - d.low.base_value};
+}
+
+template<typename U>
+constexpr std::pair<TU_TYPE, TU_TYPE> parameters(const Normal_distribution<U>& d) noexcept {
+  return {d.mean.base_value, d.sigma.base_value};
+}
+
+template<typename U>
+constexpr std::pair<TU_TYPE, TU_TYPE> parameters(const Exponential_distribution<U>& d) noexcept {
+  return {(TU_TYPE)1.0 / d.rate.base_value, (TU_TYPE)0.0};
+}
+
+template<template<typename> typename Distribution>
+using Sample_tag = Distribution<scalar>;
+} // namespace internal
+
+//
+// Fill `out` with values drawn from `distribution` using consecutive values of
+// `stream` and advance the stream past them.
+// Each output value is computed from its own counter, independent of the
+// others, which lets the compiler vectorize the loop and makes the result
+// independent of how an array is split between calls or threads.
+//
+template<template<typename> typename Distribution, internal::Coherent U>
+void generate(const Distribution<U>& distribution, Random_stream& stream, std::span<U> out) noexcept {
+  const auto [p0, p1] = internal::parameters(distribution);
+  const std::uint64_t first = stream.counter;
+  const std::size_t n = out.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    internal::store(out[i], internal::sample(stream.bits(first + i), p0, p1, internal::Sample_tag<Distribution>()));
+  }
+  stream.discard(n);
+}
+
+//
+// Draw a single value.
+//
+template<template<typename> typename Distribution, internal::Coherent U>
+U draw(const Distribution<U>& distribution, Random_stream& stream) noexcept {
+  const auto [p0, p1] = internal::parameters(distribution);
+  const U u(internal::sample(stream.bits(stream.counter), p0, p1, internal::Sample_tag<Distribution>()));
+  stream.discard(1);
+  return u;
+}
+
+} // namespace tu
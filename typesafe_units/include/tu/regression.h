@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "calculus.h"
+
+namespace tu {
+
+//
+// Straight line y = slope x + intercept. The slope has the unit Y / X.
+//
+template<internal::Coherent X, internal::Coherent Y>
+struct Linear_fit {
+  Quotient_unit<Y, X> slope;
+  Y intercept;
+
+  template<typename V>
+  requires internal::Same_dimension<V, X>
+  constexpr Y operator () (const V& x) const noexcept {
+    return Y(slope.base_value * x.base_value + intercept.base_value);
+  }
+};
+
+//
+// Streaming ordinary least squares fit of Y against X. Samples are added one
+// at a time with running means and centered sums, which are accurate also in
+// float. Accumulators of separate parts of a series, e.g. from different
+// threads, are combined with `merge`.
+//
+// Example:
+//   Least_squares<second, kelvin> trend;
+//   for (...) {
+//     trend.add(t, temperature);
+//   }
+//   Linear_fit<second, kelvin> f = trend.fit();
+//   Quotient_unit<kelvin, second> rate = f.slope;
+//
+template<internal::Coherent X, internal::Coherent Y>
+class Least_squares {
+public:
+  template<typename V, typename W>
+  requires (internal::Same_dimension<V, X> && internal::Same_dimension<W, Y>)
+  constexpr void add(const V& x, const W& y) noexcept {
+    ++n;
+    const TU_TYPE dx = x.base_value - mean_x;
+    mean_x += dx / (TU_TYPE)n;
+    mean_y += (y.base_value - mean_y) / (TU_TYPE)n;
+    sxx += dx * (x.base_value - mean_x);
+    sxy += dx * (y.base_value - mean_y);
+  }
+
+  constexpr void merge(const Least_squares& other) noexcept {
+    if (other.n == 0) {
+      return;
+    }
+    const std::size_t total = n + other.n;
+    const TU_TYPE dx = other.mean_x - mean_x;
+    const TU_TYPE dy = other.mean_y - mean_y;
+    const TU_TYPE weight = (TU_TYPE)n * (TU_TYPE)other.n / (TU_TYPE)total;
+    mean_x += dx * (TU_TYPE)other.n / (TU_TYPE)total;
+    mean_y += dy * (TU_TYPE)other.n / (TU_TYPE)total;
+    sxx += other.sxx + dx * dx * weight;
+    sxy += other.sxy + dx * dy * weight;
+    n = total;
+  }
+
+  constexpr std::size_t count() const noexcept {
+    return n;
+  }
+
+  //
+  // The fit requires at least two samples with different x.
+  //
+  constexpr Linear_fit<X, Y> fit() const noexcept {
+    const TU_TYPE slope = sxy / sxx;
+    return {Quotient_unit<Y, X>(slope), Y(mean_y - slope * mean_x)};
+  }
+
+private:
+  std::size_t n{0};
+  TU_TYPE mean_x{0.0};
+  TU_TYPE mean_y{0.0};
+  TU_TYPE sxx{0.0};
+  TU_TYPE sxy{0.0};
+};
+
+//
+// Ordinary least squares fit of y against x. The sums are centered on the
+// means, computed in a first pass.
+//
+// Example:
+//   Linear_fit<second, metre> f = linear_fit(std::span<const second>(time), std::span<const metre>(position));
+//
+template<typename X, typename Y>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+Linear_fit<internal::Coherent_of<X>, internal::Coherent_of<Y>> linear_fit(std::span<const X> x, std::span<const Y> y) noexcept {
+  const std::size_t n = std::min(x.size(), y.size());
+  const TU_TYPE mean_x = internal::lane_sum([x](std::size_t i) { return x[i].base_value; }, 0, n) / (TU_TYPE)n;
+  const TU_TYPE mean_y = internal::lane_sum([y](std::size_t i) { return y[i].base_value; }, 0, n) / (TU_TYPE)n;
+  const TU_TYPE sxx = internal::lane_sum([x, mean_x](std::size_t i) {
+    return (x[i].base_value - mean_x) * (x[i].base_value - mean_x);
+  }, 0, n);
+  const TU_TYPE sxy = internal::lane_sum([x, y, mean_x](std::size_t i) {
+    return (x[i].base_value - mean_x) * y[i].base_value;
+  }, 0, n);
+  const TU_TYPE slope = sxy / sxx;
+  return {Quotient_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>(slope),
+          internal::Coherent_of<Y>(mean_y - slope * mean_x)};
+}
+
+//
+// Fits of many series sampled at the same points x, e.g. one minute of
+// samples from each of many channels. y holds the series one after the other,
+// x.size() samples each, and slope and intercept get one element per series.
+// Only as many series are fitted as y, slope and intercept all hold. Since x
+// is shared, its mean and spread are computed once. The series are split
+// between `threads` threads.
+//
+// Example:
+//   linear_fit(std::span<const second>(time), std::span<const kelvin>(samples),
+//              std::span<Quotient_unit<kelvin, second>>(rate), std::span<kelvin>(offset), 8);
+//
+template<typename X, typename Y>
+requires (std::derived_from<X, internal::Unit_fundament> && std::derived_from<Y, internal::Unit_fundament>)
+void linear_fit(std::span<const X> x, std::span<const Y> y,
+                std::span<Quotient_unit<internal::Coherent_of<Y>, internal::Coherent_of<X>>> slope,
+                std::span<internal::Coherent_of<Y>> intercept, std::size_t threads = 1) {
+  const std::size_t m = x.size();
+  if (m == 0) {
+    return;
+  }
+  const std::size_t series_count = std::min({y.size() / m, slope.size(), intercept.size()});
+  const TU_TYPE mean_x = internal::lane_sum([x](std::size_t i) { return x[i].base_value; }, 0, m) / (TU_TYPE)m;
+  const TU_TYPE sxx = internal::lane_sum([x, mean_x](std::size_t i) {
+    return (x[i].base_value - mean_x) * (x[i].base_value - mean_x);
+  }, 0, m);
+  internal::parallel_for([=](std::size_t first, std::size_t last) {
+    for (std::size_t s = first; s < last; ++s) {
+      const std::span<const Y> series = y.subspan(s * m, m);
+      const TU_TYPE b = internal::lane_sum([x, series, mean_x](std::size_t k) {
+        return (x[k].base_value - mean_x) * series[k].base_value;
+      }, 0, m) / sxx;
+      const TU_TYPE mean_y = internal::lane_sum([series](std::size_t k) { return series[k].base_value; }, 0, m) / (TU_TYPE)m;
+      internal::store(slope[s], b);
+      internal::store(intercept[s], mean_y - b * mean_x);
+    }
+  }, series_count, threads);
+}
+
+} // namespace tu
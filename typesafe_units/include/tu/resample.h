@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <span>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "calculus.h"
+
+namespace tu {
+
+//
+// Streaming rational resampler of a signal of the coherent unit U from one
+// sampling rate to another, e.g. 12.8 kHz to 10 kHz. The rates are rounded to
+// whole hertz and the ratio reduced to up / down, here 25 / 32. Upsampling and
+// decimation are the cases down == 1 and up == 1. Rates below 1 Hz, which
+// would round to 0, are taken as 1 Hz, and at least one tap is used.
+//
+// The anti-aliasing filter is designed at construction: a windowed sinc with
+// `taps` coefficients per phase and a cutoff at `passband` times the lower of
+// the two Nyquist frequencies. It is stored as `up` polyphase filters with
+// the coefficients reversed, so each output sample is a contiguous dot
+// product which the compiler vectorizes. Processing does not allocate.
+//
+// The output is delayed by `delay()` relative to the input.
+//
+// Example:
+//   Resampler<volt> r(Unit<prefix::kilo, hertz>(12.8f), Unit<prefix::kilo, hertz>(10.0f));
+//   std::vector<volt> out(r.max_output(in.size()));
+//   out.resize(r.process(std::span<const volt>(in), std::span<volt>(out)));
+//
+template<internal::Coherent U>
+class Resampler {
+public:
+  template<typename F, typename G>
+  requires (internal::Same_dimension<F, hertz> && internal::Same_dimension<G, hertz>)
+  Resampler(const F& input_rate, const G& output_rate, std::size_t taps = 24, TU_TYPE passband = 0.9f)
+  : rate(std::max(input_rate.base_value, (TU_TYPE)1.0)), taps_(std::max(taps, (std::size_t)1)) {
+    const long long in = std::max(std::llround(input_rate.base_value), 1LL);
+    const long long out = std::max(std::llround(output_rate.base_value), 1LL);
+    const long long g = std::gcd(in, out);
+    up_ = (std::size_t)(out / g);
+    down_ = (std::size_t)(in / g);
+    // Prototype filter at up times the input rate with the cutoff relative to
+    // that rate.
+    const std::size_t length = up_ * taps_;
+    const double cutoff = 0.5 * (double)passband / (double)std::max(up_, down_);
+    const double center = 0.5 * (double)(length - 1);
+    std::vector<double> h(length);
+    double sum = 0.0;
+    for (std::size_t i = 0; i < length; ++i) {
+      const double t = (double)i - center;
+      const double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * std::numbers::pi * cutoff * t) / (std::numbers::pi * t);
+      const double phase = 2.0 * std::numbers::pi * (double)i / (double)(length - 1);
+      const double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+      h[i] = sinc * (length > 1 ? blackman : 1.0);
+      sum += h[i];
+    }
+    coefficients.resize(length);
+    for (std::size_t p = 0; p < up_; ++p) {
+      for (std::size_t t = 0; t < taps_; ++t) {
+        coefficients[p * taps_ + taps_ - 1 - t] = (TU_TYPE)(h[p + up_ * t] * (double)up_ / sum);
+      }
+    }
+    line.assign(taps_ - 1 + block, (TU_TYPE)0.0);
+  }
+
+  std::size_t up() const noexcept {
+    return up_;
+  }
+
+  std::size_t down() const noexcept {
+    return down_;
+  }
+
+  std::size_t taps() const noexcept {
+    return taps_;
+  }
+
+  //
+  // Largest number of output samples for `input` input samples.
+  //
+  std::size_t max_output(std::size_t input) const noexcept {
+    return (input * up_ + down_ - 1) / down_ + 1;
+  }
+
+  //
+  // Group delay of the filter.
+  //
+  second delay() const noexcept {
+    return second((TU_TYPE)0.5 * (TU_TYPE)(up_ * taps_ - 1) / ((TU_TYPE)up_ * rate));
+  }
+
+  //
+  // Clear the history of the filter.
+  //
+  void reset() noexcept {
+    std::fill(line.begin(), line.end(), (TU_TYPE)0.0);
+    next = 0;
+  }
+
+  //
+  // Resample the next part of the stream and return the number of samples
+  // written to out, which must have room for max_output(in.size()).
+  //
+  template<typename X>
+  requires internal::Same_dimension<X, U>
+  std::size_t process(std::span<const X> in, std::span<U> out) noexcept {
+    std::size_t produced = 0;
+    for (std::size_t first = 0; first < in.size(); first += block) {
+      const std::size_t len = std::min(block, in.size() - first);
+      for (std::size_t i = 0; i < len; ++i) {
+        line[taps_ - 1 + i] = in[first + i].base_value;
+      }
+      // Output at time `next` in units of the prototype rate from the start
+      // of this part uses phase next % up and ends at input sample next / up.
+      for (; next < up_ * len; next += down_) {
+        const TU_TYPE* c = coefficients.data() + next % up_ * taps_;
+        const TU_TYPE* x = line.data() + next / up_;
+        internal::store(out[produced++], internal::lane_sum([c, x](std::size_t t) { return c[t] * x[t]; }, 0, taps_));
+      }
+      next -= up_ * len;
+      std::copy(line.begin() + (std::ptrdiff_t)len, line.begin() + (std::ptrdiff_t)(len + taps_ - 1), line.begin());
+    }
+    return produced;
+  }
+
+private:
+  //
+  // Number of input samples added to the delay line at a time.
+  //
+  static constexpr std::size_t block = 256;
+
+  TU_TYPE rate;
+  std::size_t taps_;
+  std::size_t up_;
+  std::size_t down_;
+  std::vector<TU_TYPE> coefficients;
+  std::vector<TU_TYPE> line;
+  std::size_t next{0};
+};
+
+} // namespace tu
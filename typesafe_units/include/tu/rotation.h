@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "angle.h"
+
+namespace tu {
+
+//
+// Vector with three components of the coherent unit U, e.g. a position in
+// metre or a velocity in metre_per_second.
+//
+// Example:
+//   Vec3<metre> r{metre(1.0f), metre(0.0f), Unit<prefix::milli, metre>(20.0f)};
+//
+template<internal::Coherent U>
+struct Vec3 {
+  using Unit_type = U;
+
+  U x;
+  U y;
+  U z;
+
+  bool operator == (const Vec3<U>& other) const noexcept = default;
+};
+
+template<typename U>
+Vec3<U> operator + (const Vec3<U>& l, const Vec3<U>& r) noexcept {
+  return {l.x + r.x, l.y + r.y, l.z + r.z};
+}
+
+template<typename U>
+Vec3<U> operator - (const Vec3<U>& l, const Vec3<U>& r) noexcept {
+  return {l.x - r.x, l.y - r.y, l.z - r.z};
+}
+
+template<typename L, typename R>
+Product_unit<L, R> dot(const Vec3<L>& l, const Vec3<R>& r) noexcept {
+  return Product_unit<L, R>(l.x.base_value * r.x.base_value + l.y.base_value * r.y.base_value + l.z.base_value * r.z.base_value);
+}
+
+template<typename L, typename R>
+Vec3<Product_unit<L, R>> cross(const Vec3<L>& l, const Vec3<R>& r) noexcept {
+  return {Product_unit<L, R>(l.y.base_value * r.z.base_value - l.z.base_value * r.y.base_value),
+          Product_unit<L, R>(l.z.base_value * r.x.base_value - l.x.base_value * r.z.base_value),
+          Product_unit<L, R>(l.x.base_value * r.y.base_value - l.y.base_value * r.x.base_value)};
+}
+
+template<typename U>
+U norm(const Vec3<U>& v) noexcept {
+  return U(std::sqrt(v.x.base_value * v.x.base_value + v.y.base_value * v.y.base_value + v.z.base_value * v.z.base_value));
+}
+
+namespace internal {
+//
+// Rotate v by the unit quaternion (w, q) with v' = v + 2 w (q x v) + 2 q x (q x v),
+// which is cheaper than the quaternion products.
+//
+constexpr std::array<TU_TYPE, 3> rotate(TU_TYPE w, TU_TYPE x, TU_TYPE y, TU_TYPE z, TU_TYPE vx, TU_TYPE vy, TU_TYPE vz) noexcept {
+  const TU_TYPE tx = (TU_TYPE)2.0 * (y * vz - z * vy);
+  const TU_TYPE ty = (TU_TYPE)2.0 * (z * vx - x * vz);
+  const TU_TYPE tz = (TU_TYPE)2.0 * (x * vy - y * vx);
+  return {vx + w * tx + (y * tz - z * ty),
+          vy + w * ty + (z * tx - x * tz),
+          vz + w * tz + (x * ty - y * tx)};
+}
+} // namespace internal
+
+//
+// Unit quaternion w + x i + y j + z k representing a rotation. Angles are
+// given as plane angle units, e.g. radian or degree, and are converted to
+// radians on construction.
+//
+// Example:
+//   Quaternion q = Quaternion::from_axis_angle(Vec3<scalar>{scalar(0.0f), scalar(0.0f), scalar(1.0f)},
+//                                              Unit<prefix::no_prefix, degree>(90.0f));
+//   Vec3<metre> r = q.rotate(Vec3<metre>{metre(1.0f), metre(0.0f), metre(0.0f)}); // (0, 1, 0) m
+//
+struct Quaternion {
+  constexpr Quaternion() noexcept = default;
+  constexpr Quaternion(TU_TYPE w, TU_TYPE x, TU_TYPE y, TU_TYPE z) noexcept : w(w), x(x), y(y), z(z) {}
+
+  //
+  // Rotation by `angle` about `axis`, which need not be normalized. A zero
+  // axis gives the identity.
+  //
+  template<typename U, internal::Angle A>
+  static Quaternion from_axis_angle(const Vec3<U>& axis, const A& angle) noexcept {
+    const TU_TYPE length = norm(axis).base_value;
+    if (length == (TU_TYPE)0.0) {
+      return {(TU_TYPE)1.0, (TU_TYPE)0.0, (TU_TYPE)0.0, (TU_TYPE)0.0};
+    }
+    const TU_TYPE half = (TU_TYPE)0.5 * angle.base_value;
+    const TU_TYPE s = std::sin(half) / length;
+    return {std::cos(half), axis.x.base_value * s, axis.y.base_value * s, axis.z.base_value * s};
+  }
+
+  //
+  // Rotation from yaw about z, then pitch about the new y and then roll about
+  // the new x (the aerospace z-y'-x'' sequence).
+  //
+  template<internal::Angle R, internal::Angle P, internal::Angle Y>
+  static Quaternion from_euler(const R& roll, const P& pitch, const Y& yaw) noexcept {
+    const TU_TYPE cr = std::cos((TU_TYPE)0.5 * roll.base_value);
+    const TU_TYPE sr = std::sin((TU_TYPE)0.5 * roll.base_value);
+    const TU_TYPE cp = std::cos((TU_TYPE)0.5 * pitch.base_value);
+    const TU_TYPE sp = std::sin((TU_TYPE)0.5 * pitch.base_value);
+    const TU_TYPE cy = std::cos((TU_TYPE)0.5 * yaw.base_value);
+    const TU_TYPE sy = std::sin((TU_TYPE)0.5 * yaw.base_value);
+    return {cr * cp * cy + sr * sp * sy,
+            sr * cp * cy - cr * sp * sy,
+            cr * sp * cy + sr * cp * sy,
+            cr * cp * sy - sr * sp * cy};
+  }
+
+  //
+  // The rotation angle in [0, 2 pi].
+  //
+  radian angle() const noexcept {
+    return radian((TU_TYPE)2.0 * std::atan2(std::sqrt(x * x + y * y + z * z), w));
+  }
+
+  constexpr Quaternion conjugate() const noexcept {
+    return {w, -x, -y, -z};
+  }
+
+  Quaternion normalized() const noexcept {
+    const TU_TYPE s = (TU_TYPE)1.0 / std::sqrt(w * w + x * x + y * y + z * z);
+    return {w * s, x * s, y * s, z * s};
+  }
+
+  template<typename U>
+  constexpr Vec3<U> rotate(const Vec3<U>& v) const noexcept {
+    const std::array<TU_TYPE, 3> r = internal::rotate(w, x, y, z, v.x.base_value, v.y.base_value, v.z.base_value);
+    return {U(r[0]), U(r[1]), U(r[2])};
+  }
+
+  bool operator == (const Quaternion& other) const noexcept = default;
+
+  TU_TYPE w{1.0};
+  TU_TYPE x{0.0};
+  TU_TYPE y{0.0};
+  TU_TYPE z{0.0};
+};
+
+//
+// Composition. (a * b).rotate(v) == a.rotate(b.rotate(v)).
+//
+constexpr Quaternion operator * (const Quaternion& a, const Quaternion& b) noexcept {
+  return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+          a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+//
+// Propagate the attitude q with the body angular velocity `omega` over the
+// time `dt`, assuming that omega is constant during dt.
+//
+// Example:
+//   Vec3<Quotient_unit<radian, second>> omega{...};
+//   q = integrate(q, omega, Unit<prefix::milli, second>(10.0f));
+//
+template<typename W, typename T>
+requires (internal::Same_dimension<W, Quotient_unit<radian, second>> && internal::Same_dimension<T, second>)
+Quaternion integrate(const Quaternion& q, const Vec3<W>& omega, const T& dt) noexcept {
+  const TU_TYPE rate = norm(omega).base_value;
+  if (rate == (TU_TYPE)0.0) {
+    return q;
+  }
+  return (q * Quaternion::from_axis_angle(omega, radian(rate * dt.base_value))).normalized();
+}
+
+//
+// Rotation matrix stored row by row.
+//
+// Example:
+//   Rotation_matrix r = Rotation_matrix::about_z(Unit<prefix::no_prefix, degree>(90.0f));
+//   Vec3<metre_per_second> v = r.rotate(Vec3<metre_per_second>{...});
+//
+struct Rotation_matrix {
+  constexpr Rotation_matrix() noexcept = default;
+  constexpr Rotation_matrix(const std::array<TU_TYPE, 9>& m) noexcept : m(m) {}
+
+  constexpr Rotation_matrix(const Quaternion& q) noexcept
+  : m{(TU_TYPE)1.0 - (TU_TYPE)2.0 * (q.y * q.y + q.z * q.z), (TU_TYPE)2.0 * (q.x * q.y - q.w * q.z), (TU_TYPE)2.0 * (q.x * q.z + q.w * q.y),
+      (TU_TYPE)2.0 * (q.x * q.y + q.w * q.z), (TU_TYPE)1.0 - (TU_TYPE)2.0 * (q.x * q.x + q.z * q.z), (TU_TYPE)2.0 * (q.y * q.z - q.w * q.x),
+      (TU_TYPE)2.0 * (q.x * q.z - q.w * q.y), (TU_TYPE)2.0 * (q.y * q.z + q.w * q.x), (TU_TYPE)1.0 - (TU_TYPE)2.0 * (q.x * q.x + q.y * q.y)} {}
+
+  template<internal::Angle A>
+  static Rotation_matrix about_x(const A& angle) noexcept {
+    const TU_TYPE c = std::cos(angle.base_value);
+    const TU_TYPE s = std::sin(angle.base_value);
+    return {{(TU_TYPE)1.0, (TU_TYPE)0.0, (TU_TYPE)0.0, (TU_TYPE)0.0, c, -s, (TU_TYPE)0.0, s, c}};
+  }
+
+  template<internal::Angle A>
+  static Rotation_matrix about_y(const A& angle) noexcept {
+    const TU_TYPE c = std::cos(angle.base_value);
+    const TU_TYPE s = std::sin(angle.base_value);
+    return {{c, (TU_TYPE)0.0, s, (TU_TYPE)0.0, (TU_TYPE)1.0, (TU_TYPE)0.0, -s, (TU_TYPE)0.0, c}};
+  }
+
+  template<internal::Angle A>
+  static Rotation_matrix about_z(const A& angle) noexcept {
+    const TU_TYPE c = std::cos(angle.base_value);
+    const TU_TYPE s = std::sin(angle.base_value);
+    return {{c, -s, (TU_TYPE)0.0, s, c, (TU_TYPE)0.0, (TU_TYPE)0.0, (TU_TYPE)0.0, (TU_TYPE)1.0}};
+  }
+
+  //
+  // The inverse rotation.
+  //
+  constexpr Rotation_matrix transpose() const noexcept {
+    return {{m[0], m[3], m[6], m[1], m[4], m[7], m[2], m[5], m[8]}};
+  }
+
+  template<typename U>
+  constexpr Vec3<U> rotate(const Vec3<U>& v) const noexcept {
+    return {U(m[0] * v.x.base_value + m[1] * v.y.base_value + m[2] * v.z.base_value),
+            U(m[3] * v.x.base_value + m[4] * v.y.base_value + m[5] * v.z.base_value),
+            U(m[6] * v.x.base_value + m[7] * v.y.base_value + m[8] * v.z.base_value)};
+  }
+
+  std::array<TU_TYPE, 9> m{(TU_TYPE)1.0, (TU_TYPE)0.0, (TU_TYPE)0.0,
+                                 (TU_TYPE)0.0, (TU_TYPE)1.0, (TU_TYPE)0.0,
+                                 (TU_TYPE)0.0, (TU_TYPE)0.0, (TU_TYPE)1.0};
+};
+
+constexpr Rotation_matrix operator * (const Rotation_matrix& a, const Rotation_matrix& b) noexcept {
+  std::array<TU_TYPE, 9> m{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 3; ++j) {
+      m[3 * i + j] = a.m[3 * i] * b.m[j] + a.m[3 * i + 1] * b.m[3 + j] + a.m[3 * i + 2] * b.m[6 + j];
+    }
+  }
+  return {m};
+}
+
+//
+// Structure of arrays view of vectors. The components are kept in separate
+// contiguous arrays of Coherent_units so that batch rotations run over plain
+// arrays of base values.
+//
+template<typename U>
+requires internal::Coherent<std::remove_const_t<U>>
+struct Vec3_span {
+  std::span<U> x;
+  std::span<U> y;
+  std::span<U> z;
+
+  std::size_t size() const noexcept {
+    return x.size();
+  }
+};
+
+namespace internal {
+//
+// Apply f(x, y, z, i) -> std::array<TU_TYPE, 3> to the vectors of `in`. The
+// results of a block go to local arrays first. With the outputs written
+// directly the compiler would need more run time alias checks between the
+// six arrays than it is willing to make and would not vectorize the loop.
+//
+template<typename U, typename F>
+void transform_vectors(Vec3_span<const U> in, Vec3_span<U> out, F f) noexcept {
+  constexpr std::size_t block = 64;
+  std::array<TU_TYPE, block> x;
+  std::array<TU_TYPE, block> y;
+  std::array<TU_TYPE, block> z;
+  const std::size_t n = out.size();
+  for (std::size_t first = 0; first < n; first += block) {
+    const std::size_t count = std::min(block, n - first);
+    for (std::size_t j = 0; j < count; ++j) {
+      const std::array<TU_TYPE, 3> r = f(in.x[first + j].base_value, in.y[first + j].base_value, in.z[first + j].base_value, first + j);
+      x[j] = r[0];
+      y[j] = r[1];
+      z[j] = r[2];
+    }
+    for (std::size_t j = 0; j < count; ++j) {
+      store(out.x[first + j], x[j]);
+      store(out.y[first + j], y[j]);
+      store(out.z[first + j], z[j]);
+    }
+  }
+}
+} // namespace internal
+
+//
+// Batch rotation out[i] = r.rotate(in[i]) of all vectors by the same rotation.
+// A quaternion is converted to a matrix first since the matrix product needs
+// fewer operations per vector. The loops have no branches and are vectorized
+// by the compiler. All spans must have the same size. `in` and `out` may be
+// the same arrays.
+//
+// Example:
+//   rotate(attitude, Vec3_span<const metre>{x, y, z}, Vec3_span<metre>{xr, yr, zr});
+//
+template<typename U>
+void rotate(const Rotation_matrix& r, Vec3_span<const U> in, Vec3_span<U> out) noexcept {
+  const std::array<TU_TYPE, 9> m = r.m;
+  internal::transform_vectors(in, out, [&m](TU_TYPE x, TU_TYPE y, TU_TYPE z, std::size_t) {
+    return std::array<TU_TYPE, 3>{m[0] * x + m[1] * y + m[2] * z,
+                                  m[3] * x + m[4] * y + m[5] * z,
+                                  m[6] * x + m[7] * y + m[8] * z};
+  });
+}
+
+template<typename U>
+void rotate(const Quaternion& q, Vec3_span<const U> in, Vec3_span<U> out) noexcept {
+  rotate(Rotation_matrix(q), in, out);
+}
+
+//
+// Batch rotation out[i] = q[i].rotate(in[i]) with one rotation per vector,
+// e.g. one attitude per vehicle.
+//
+template<typename U>
+void rotate(std::span<const Quaternion> q, Vec3_span<const U> in, Vec3_span<U> out) noexcept {
+  internal::transform_vectors(in, out, [q](TU_TYPE x, TU_TYPE y, TU_TYPE z, std::size_t i) {
+    return internal::rotate(q[i].w, q[i].x, q[i].y, q[i].z, x, y, z);
+  });
+}
+
+} // namespace tu
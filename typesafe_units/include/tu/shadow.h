@@ -0,0 +1,368 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <ratio>
+#include <source_location>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+//
+// Largest relative error of the values of one operation on one unit at one
+// call site, with the value and shadow where it occurred. Results of
+// operators have no call site and are recorded per operator and unit.
+//
+struct Shadow_error {
+  const char* operation;
+  const char* unit;
+  std::source_location call_site;
+  std::uint64_t count;
+  long double max_relative_error;
+  TU_TYPE value;
+  long double shadow;
+};
+
+//
+// Relative errors recorded by Shadow quantities. Each thread records in its
+// own profile, `thread_shadow_profile()`, and the profiles of several threads
+// are combined with `merge` or `collect_shadow_profile`.
+//
+class Shadow_profile {
+public:
+  void add(const char* operation, const char* unit, const std::source_location& call_site, TU_TYPE value, long double shadow) {
+    const long double error = value == shadow ? 0.0L : std::abs((long double)value - shadow) / std::abs(shadow);
+    add({operation, unit, call_site, 1, error, value, shadow});
+  }
+
+  void merge(const Shadow_profile& other) {
+    for (const auto& [key, e] : other.errors) {
+      add(e);
+    }
+  }
+
+  void clear() noexcept {
+    errors.clear();
+  }
+
+  long double max_relative_error() const noexcept {
+    long double m = 0.0L;
+    for (const auto& [key, e] : errors) {
+      m = std::max(m, e.max_relative_error);
+    }
+    return m;
+  }
+
+  //
+  // The sites ordered from the largest to the smallest error.
+  //
+  std::vector<Shadow_error> ranked() const {
+    std::vector<Shadow_error> sites;
+    sites.reserve(errors.size());
+    for (const auto& [key, e] : errors) {
+      sites.push_back(e);
+    }
+    std::sort(sites.begin(), sites.end(), [](const Shadow_error& l, const Shadow_error& r) {
+      return l.max_relative_error > r.max_relative_error;
+    });
+    return sites;
+  }
+
+  //
+  // Print the `top` sites with the largest errors, also in units of the
+  // machine epsilon of TU_TYPE.
+  //
+  void print(std::FILE* out, std::size_t top = 20) const {
+    const std::vector<Shadow_error> sites = ranked();
+    std::fprintf(out, "%12s %12s %10s  %-12s %-20s %s\n", "count", "max error", "epsilon", "operation", "unit", "call site");
+    for (std::size_t i = 0; i < std::min(top, sites.size()); ++i) {
+      const Shadow_error& e = sites[i];
+      std::fprintf(out, "%12llu %12.3Lg %10.1Lf  %-12s %-20s ", (unsigned long long)e.count, e.max_relative_error,
+                   e.max_relative_error / (long double)std::numeric_limits<TU_TYPE>::epsilon(), e.operation, e.unit);
+      if (e.call_site.line() == 0) {
+        std::fprintf(out, "(operator)\n");
+      } else {
+        std::fprintf(out, "%s:%u %s\n", e.call_site.file_name(), (unsigned)e.call_site.line(), e.call_site.function_name());
+      }
+    }
+  }
+
+private:
+  //
+  // The strings are compared by content, since a header included in several
+  // translation units may have its strings stored once in each.
+  //
+  struct Key {
+    std::string_view operation;
+    std::string_view unit;
+    std::string_view file;
+    std::uint_least32_t line;
+    std::uint_least32_t column;
+
+    bool operator == (const Key&) const noexcept = default;
+  };
+
+  struct Key_hash {
+    std::size_t operator () (const Key& k) const noexcept {
+      std::size_t h = std::hash<std::string_view>()(k.operation);
+      h = h * 31 + std::hash<std::string_view>()(k.unit);
+      h = h * 31 + std::hash<std::string_view>()(k.file);
+      return h * 31 + k.line * 1024 + k.column;
+    }
+  };
+
+  void add(const Shadow_error& e) {
+    const Key key{e.operation, e.unit, e.call_site.file_name(), e.call_site.line(), e.call_site.column()};
+    auto [site, inserted] = errors.try_emplace(key, e);
+    if (!inserted) {
+      site->second.count += e.count;
+      if (e.max_relative_error > site->second.max_relative_error) {
+        site->second.max_relative_error = e.max_relative_error;
+        site->second.value = e.value;
+        site->second.shadow = e.shadow;
+      }
+    }
+  }
+
+  std::unordered_map<Key, Shadow_error, Key_hash> errors;
+};
+
+//
+// The profile the calling thread records its errors in.
+//
+inline Shadow_profile& thread_shadow_profile() noexcept {
+  thread_local Shadow_profile profile;
+  return profile;
+}
+
+namespace internal {
+inline std::mutex shadow_profile_mutex;
+} // namespace internal
+
+//
+// Merge the errors recorded by the calling thread into `total` and clear
+// them. Threads may collect into the same total at the same time.
+//
+inline void collect_shadow_profile(Shadow_profile& total) {
+  std::lock_guard<std::mutex> lock(internal::shadow_profile_mutex);
+  total.merge(thread_shadow_profile());
+  thread_shadow_profile().clear();
+}
+
+namespace internal {
+//
+// The base value of v in long double, from its value in the unit of v.
+//
+template<typename V>
+long double shadow_base_value(const V& v) noexcept {
+  if constexpr (Coherent<V>) {
+    return (long double)v.base_value;
+  } else {
+    return (long double)v.value * (long double)Unit_scale<V>::multiplier + (long double)Unit_scale<V>::adder;
+  }
+}
+} // namespace internal
+
+//
+// Debug quantity of the coherent unit U that carries a long double shadow
+// along with its TU_TYPE value. Every operation computes both and records the
+// relative error of the value in `thread_shadow_profile()`. Built with
+// TU_TYPE float, the profile shows which parts of a computation keep enough
+// precision in float and which need double.
+//
+// Operators record per operator and unit. Constructors, pow, sqrt, unop,
+// `to` and `checkpoint` record per call site, so a checkpoint after each
+// stage of a pipeline shows where the error grows. Plain units may be mixed
+// with Shadow quantities and are taken as exact.
+//
+// Example:
+//   Shadow<joule> e(Unit<prefix::no_prefix, electronvolt>(13.6f));
+//   Shadow<kilogram> m(9.1093837e-31L);
+//   auto v = checkpoint(sqrt(scalar(2.0f) * e / m));
+//   tu::thread_shadow_profile().print(stdout);
+//
+template<internal::Coherent U>
+class Shadow {
+public:
+  using Unit_type = U;
+
+  //
+  // A unit value. The shadow is the base value computed from v in long
+  // double, so the rounding of the conversion of e.g. electronvolt to joule
+  // is recorded at the call site.
+  //
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  Shadow(const V& v, std::source_location call_site = std::source_location::current())
+  : value_(U(v).base_value), shadow_(internal::shadow_base_value(v)) {
+    record("construct", call_site);
+  }
+
+  //
+  // The base value `exact`, rounded to TU_TYPE for the value. The rounding
+  // error is recorded.
+  //
+  explicit Shadow(long double exact, std::source_location call_site = std::source_location::current())
+  : value_((TU_TYPE)exact), shadow_(exact) {
+    record("construct", call_site);
+  }
+
+  U value() const noexcept {
+    return value_;
+  }
+
+  long double shadow() const noexcept {
+    return shadow_;
+  }
+
+  long double relative_error() const noexcept {
+    return value_ == shadow_ ? 0.0L : std::abs((long double)value_ - shadow_) / std::abs(shadow_);
+  }
+
+  //
+  // The value in the unit V, e.g. Unit<prefix::no_prefix, degree_Celsius>,
+  // with the error of the conversion recorded.
+  //
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  V to(std::source_location call_site = std::source_location::current()) const {
+    const V v{U(value_)};
+    const long double exact = (shadow_ - (long double)internal::Unit_scale<V>::adder) / (long double)internal::Unit_scale<V>::multiplier;
+    if constexpr (requires { v.value; }) {
+      thread_shadow_profile().add("to", internal::dimension_of<U>(), call_site, v.value, exact);
+    } else {
+      thread_shadow_profile().add("to", internal::dimension_of<U>(), call_site, v.base_value, exact);
+    }
+    return v;
+  }
+
+  //
+  // A unit value taken as exact without recording it, e.g. a plain unit
+  // operand of an operator.
+  //
+  template<typename V>
+  requires internal::Same_dimension<V, U>
+  static Shadow untraced(const V& v) noexcept {
+    return Shadow(U(v).base_value, internal::shadow_base_value(v));
+  }
+
+  //
+  // Result of an operation, recorded per operation and call site.
+  //
+  static Shadow traced(const char* operation, TU_TYPE value, long double shadow, const std::source_location& call_site = {}) {
+    Shadow s(value, shadow);
+    s.record(operation, call_site);
+    return s;
+  }
+
+private:
+  Shadow(TU_TYPE value, long double shadow) noexcept : value_(value), shadow_(shadow) {}
+
+  void record(const char* operation, const std::source_location& call_site) const {
+    thread_shadow_profile().add(operation, internal::dimension_of<U>(), call_site, value_, shadow_);
+  }
+
+  TU_TYPE value_;
+  long double shadow_;
+};
+
+namespace internal {
+template<typename T>
+struct is_shadow : std::false_type {};
+
+template<typename U>
+struct is_shadow<Shadow<U>> : std::true_type {};
+
+template<typename T>
+concept Shadow_operand = is_shadow<T>::value || std::derived_from<T, Unit_fundament>;
+
+//
+// Operands of a Shadow operator, at least one of which is a Shadow.
+//
+template<typename L, typename R>
+concept Shadow_operands = Shadow_operand<L> && Shadow_operand<R> && (is_shadow<L>::value || is_shadow<R>::value);
+
+template<typename T>
+auto as_shadow(const T& t) noexcept {
+  if constexpr (is_shadow<T>::value) {
+    return t;
+  } else {
+    return Shadow<Coherent_of<T>>::untraced(t);
+  }
+}
+
+template<typename L, typename R, typename F>
+auto shadow_binary(const char* operation, const L& l, const R& r, const F& op) {
+  const auto a = as_shadow(l);
+  const auto b = as_shadow(r);
+  const auto v = op(a.value(), b.value());
+  return Shadow<Coherent_of<decltype(v)>>::traced(operation, v.base_value, op(a.shadow(), b.shadow()));
+}
+} // namespace internal
+
+template<typename L, typename R>
+requires internal::Shadow_operands<L, R>
+auto operator + (const L& l, const R& r) {
+  return internal::shadow_binary("+", l, r, [](const auto& a, const auto& b) { return a + b; });
+}
+
+template<typename L, typename R>
+requires internal::Shadow_operands<L, R>
+auto operator - (const L& l, const R& r) {
+  return internal::shadow_binary("-", l, r, [](const auto& a, const auto& b) { return a - b; });
+}
+
+template<typename L, typename R>
+requires internal::Shadow_operands<L, R>
+auto operator * (const L& l, const R& r) {
+  return internal::shadow_binary("*", l, r, [](const auto& a, const auto& b) { return a * b; });
+}
+
+template<typename L, typename R>
+requires internal::Shadow_operands<L, R>
+auto operator / (const L& l, const R& r) {
+  return internal::shadow_binary("/", l, r, [](const auto& a, const auto& b) { return a / b; });
+}
+
+template<internal::Ratio exp, typename U>
+auto pow(const Shadow<U>& u, std::source_location call_site = std::source_location::current()) {
+  const auto v = pow<exp>(u.value());
+  const long double s = std::pow(u.shadow(), (long double)exp::num / (long double)exp::den);
+  return Shadow<internal::Coherent_of<decltype(v)>>::traced("pow", v.base_value, s, call_site);
+}
+
+template<typename U>
+auto sqrt(const Shadow<U>& u, std::source_location call_site = std::source_location::current()) {
+  const auto v = sqrt(u.value());
+  return Shadow<internal::Coherent_of<decltype(v)>>::traced("sqrt", v.base_value, std::sqrt(u.shadow()), call_site);
+}
+
+//
+// Apply f to a scalar Shadow. f is called with the TU_TYPE value and with the
+// long double shadow, e.g. [](auto x) { return std::exp(x); }.
+//
+template<typename F, typename U>
+requires (U::is_scalar() && std::invocable<const F&, TU_TYPE> && std::invocable<const F&, long double>)
+Shadow<U> unop(const F& f, const Shadow<U>& u, std::source_location call_site = std::source_location::current()) {
+  return Shadow<U>::traced("unop", (TU_TYPE)f(u.value().base_value), (long double)f(u.shadow()), call_site);
+}
+
+//
+// Record the error of u at the call site and return it.
+//
+template<typename U>
+const Shadow<U>& checkpoint(const Shadow<U>& u, std::source_location call_site = std::source_location::current()) {
+  thread_shadow_profile().add("checkpoint", internal::dimension_of<U>(), call_site, u.value().base_value, u.shadow());
+  return u;
+}
+
+} // namespace tu
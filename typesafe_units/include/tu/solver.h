@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <cstddef>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+namespace internal {
+template<typename F, typename... Args>
+using Function_value = std::remove_cvref_t<std::invoke_result_t<F&, Args...>>;
+
+//
+// A function of X, optionally preceded by further arguments, returning a unit.
+//
+template<typename F, typename X, typename... Args>
+concept Unit_function = std::invocable<F&, Args..., X> && std::derived_from<Function_value<F, Args..., X>, Unit_fundament>;
+
+//
+// A function of X returning a unit with the dimension of dF/dX.
+//
+template<typename DF, typename F, typename X, typename... Args>
+concept Derivative_of = Unit_function<DF, X, Args...> &&
+                        Same_dimension<Function_value<DF, Args..., X>, Quotient_unit<Coherent_of<Function_value<F, Args..., X>>, X>>;
+
+using Magnitude_bits = std::conditional_t<std::is_same_v<TU_TYPE, float>, std::uint32_t, std::uint64_t>;
+
+//
+// The bits of |x|. They order like the magnitudes, with NaN above infinity.
+//
+constexpr Magnitude_bits magnitude_bits(TU_TYPE x) noexcept {
+  return std::bit_cast<Magnitude_bits>(x) & (std::numeric_limits<Magnitude_bits>::max() >> 1);
+}
+
+constexpr bool same_sign(TU_TYPE a, TU_TYPE b) noexcept {
+  return std::signbit(a) == std::signbit(b);
+}
+} // namespace internal
+
+//
+// Result of a root finding or minimization. `iterations` is the number of
+// updates of the estimate `x`. `converged` is false if the tolerances were not
+// met within the maximum number of iterations or if the input did not allow a
+// solution, e.g. a bracket without a sign change.
+//
+template<internal::Coherent X>
+struct Root {
+  X x;
+  int iterations;
+  bool converged;
+};
+
+template<internal::Coherent X, internal::Coherent Y>
+struct Minimum {
+  X x;
+  Y value;
+  int iterations;
+  bool converged;
+};
+
+//
+// Solvers for f(x) = 0 where f is a function from X to a unit Y.
+// The tolerances are typed. `x_tolerance` has the dimension of X and
+// `residual_tolerance` the dimension of Y. A solver stops when the estimate
+// changes less than `x_tolerance` or when |f(x)| <= `residual_tolerance`.
+// X is the Coherent_unit of the initial estimate or bracket, which f is called
+// with.
+//
+// Example:
+//   // Temperature where the specific enthalpy h(T) = cp T + b T^2 reaches 400 kJ/kg.
+//   auto h = [](kelvin T) { return cp * T + b * T * T - target; };
+//   auto dh = [](kelvin T) { return cp + b * T + b * T; };
+//   Root<kelvin> T = newton_raphson(h, dh, kelvin(300.0f), Unit<prefix::milli, kelvin>(1.0f), Quotient_unit<joule, kilogram>(1.0f));
+//
+
+//
+// Newton-Raphson method. The derivative `df` must return a unit with the dimension
+// Y / X, which is checked at compile time.
+//
+template<typename G, typename F, typename DF, typename Tx, typename Ty, typename X = internal::Coherent_of<G>>
+requires (internal::Unit_function<F, X> && internal::Derivative_of<DF, F, X> &&
+          internal::Same_dimension<Tx, X> && internal::Same_dimension<Ty, internal::Function_value<F, X>>)
+Root<X> newton_raphson(F f, DF df, const G& guess, const Tx& x_tolerance, const Ty& residual_tolerance, int max_iterations = 50) {
+  TU_TYPE x = guess.base_value;
+  for (int i = 0; i < max_iterations; ++i) {
+    const TU_TYPE y = f(X(x)).base_value;
+    if (std::abs(y) <= residual_tolerance.base_value) {
+      return {X(x), i, true};
+    }
+    const TU_TYPE step = y / df(X(x)).base_value;
+    if (!std::isfinite(step)) {
+      return {X(x), i, false};
+    }
+    x -= step;
+    if (std::abs(step) <= x_tolerance.base_value) {
+      return {X(x), i + 1, true};
+    }
+  }
+  return {X(x), max_iterations, false};
+}
+
+//
+// Bisection of the bracket [lower, upper] where f(lower) and f(upper) must have
+// opposite signs.
+//
+template<typename G, typename H, typename F, typename Tx, typename Ty, typename X = internal::Coherent_of<G>>
+requires (internal::Unit_function<F, X> && internal::Same_dimension<H, X> &&
+          internal::Same_dimension<Tx, X> && internal::Same_dimension<Ty, internal::Function_value<F, X>>)
+Root<X> bisection(F f, const G& lower, const H& upper, const Tx& x_tolerance, const Ty& residual_tolerance, int max_iterations = 200) {
+  TU_TYPE a = lower.base_value;
+  TU_TYPE b = upper.base_value;
+  const TU_TYPE fa = f(X(a)).base_value;
+  const TU_TYPE fb = f(X(b)).base_value;
+  // An end of the bracket may already be a root, e.g. f = +0 there.
+  if (std::abs(fa) <= residual_tolerance.base_value) {
+    return {X(a), 0, true};
+  }
+  if (std::abs(fb) <= residual_tolerance.base_value) {
+    return {X(b), 0, true};
+  }
+  if (internal::same_sign(fa, fb)) {
+    return {X(a), 0, false};
+  }
+  for (int i = 1; i <= max_iterations; ++i) {
+    const TU_TYPE m = (TU_TYPE)0.5 * (a + b);
+    const TU_TYPE fm = f(X(m)).base_value;
+    if (std::abs(fm) <= residual_tolerance.base_value || (TU_TYPE)0.5 * std::abs(b - a) <= x_tolerance.base_value) {
+      return {X(m), i, true};
+    }
+    if (internal::same_sign(fa, fm)) {
+      a = m;
+    } else {
+      b = m;
+    }
+  }
+  return {X((TU_TYPE)0.5 * (a + b)), max_iterations, false};
+}
+
+//
+// Brent's method (Brent 1973) for the bracket [lower, upper] where f(lower) and
+// f(upper) must have opposite signs. Combines inverse quadratic interpolation
+// and the secant method with bisection, so it converges superlinearly for
+// smooth functions and never slower than bisection.
+//
+template<typename G, typename H, typename F, typename Tx, typename Ty, typename X = internal::Coherent_of<G>>
+requires (internal::Unit_function<F, X> && internal::Same_dimension<H, X> &&
+          internal::Same_dimension<Tx, X> && internal::Same_dimension<Ty, internal::Function_value<F, X>>)
+Root<X> brent(F f, const G& lower, const H& upper, const Tx& x_tolerance, const Ty& residual_tolerance, int max_iterations = 100) {
+  TU_TYPE a = lower.base_value;
+  TU_TYPE b = upper.base_value;
+  TU_TYPE fa = f(X(a)).base_value;
+  TU_TYPE fb = f(X(b)).base_value;
+  if (internal::same_sign(fa, fb) && fa != (TU_TYPE)0.0 && fb != (TU_TYPE)0.0) {
+    return {X(b), 0, false};
+  }
+  TU_TYPE c = b;
+  TU_TYPE fc = fb;
+  TU_TYPE d = b - a;
+  TU_TYPE e = d;
+  for (int i = 0; i < max_iterations; ++i) {
+    // Keep the root between b and c, with b the best estimate.
+    if (internal::same_sign(fb, fc)) {
+      c = a;
+      fc = fa;
+      d = b - a;
+      e = d;
+    }
+    if (std::abs(fc) < std::abs(fb)) {
+      a = b;
+      b = c;
+      c = a;
+      fa = fb;
+      fb = fc;
+      fc = fa;
+    }
+    const TU_TYPE tolerance = (TU_TYPE)2.0 * std::numeric_limits<TU_TYPE>::epsilon() * std::abs(b) + (TU_TYPE)0.5 * x_tolerance.base_value;
+    const TU_TYPE half = (TU_TYPE)0.5 * (c - b);
+    if (std::abs(half) <= tolerance || std::abs(fb) <= residual_tolerance.base_value) {
+      return {X(b), i, true};
+    }
+    if (std::abs(e) >= tolerance && std::abs(fa) > std::abs(fb)) {
+      // Interpolate. Secant if only two points are distinct.
+      const TU_TYPE s = fb / fa;
+      TU_TYPE p;
+      TU_TYPE q;
+      if (a == c) {
+        p = (TU_TYPE)2.0 * half * s;
+        q = (TU_TYPE)1.0 - s;
+      } else {
+        const TU_TYPE qa = fa / fc;
+        const TU_TYPE r = fb / fc;
+        p = s * ((TU_TYPE)2.0 * half * qa * (qa - r) - (b - a) * (r - (TU_TYPE)1.0));
+        q = (qa - (TU_TYPE)1.0) * (r - (TU_TYPE)1.0) * (s - (TU_TYPE)1.0);
+      }
+      if (p > (TU_TYPE)0.0) {
+        q = -q;
+      }
+      p = std::abs(p);
+      // Accept the interpolation only if it stays within the bracket and
+      // converges faster than bisection.
+      if ((TU_TYPE)2.0 * p < std::min((TU_TYPE)3.0 * half * q - std::abs(tolerance * q), std::abs(e * q))) {
+        e = d;
+        d = p / q;
+      } else {
+        d = half;
+        e = d;
+      }
+    } else {
+      d = half;
+      e = d;
+    }
+    a = b;
+    fa = fb;
+    b += std::abs(d) > tolerance ? d : std::copysign(tolerance, half);
+    fb = f(X(b)).base_value;
+  }
+  return {X(b), max_iterations, false};
+}
+
+//
+// Golden section search for a minimum of f in [lower, upper]. f must have a
+// single minimum in the interval. Stops when the interval containing the
+// minimum is narrower than 2 `x_tolerance`.
+//
+// Example:
+//   Minimum<metre, joule> m = minimize(energy, metre(0.1f), metre(1.0f), Unit<prefix::micro, metre>(1.0f));
+//
+template<typename G, typename H, typename F, typename Tx, typename X = internal::Coherent_of<G>>
+requires (internal::Unit_function<F, X> && internal::Same_dimension<H, X> && internal::Same_dimension<Tx, X>)
+Minimum<X, internal::Coherent_of<internal::Function_value<F, X>>> minimize(F f, const G& lower, const H& upper, const Tx& x_tolerance, int max_iterations = 200) {
+  using Y = internal::Coherent_of<internal::Function_value<F, X>>;
+  constexpr TU_TYPE r = (TU_TYPE)1.0 / std::numbers::phi_v<TU_TYPE>;
+  TU_TYPE a = lower.base_value;
+  TU_TYPE b = upper.base_value;
+  TU_TYPE x1 = b - r * (b - a);
+  TU_TYPE x2 = a + r * (b - a);
+  TU_TYPE f1 = f(X(x1)).base_value;
+  TU_TYPE f2 = f(X(x2)).base_value;
+  for (int i = 0; i < max_iterations; ++i) {
+    if ((TU_TYPE)0.5 * std::abs(b - a) <= x_tolerance.base_value) {
+      return f1 < f2 ? Minimum<X, Y>{X(x1), Y(f1), i, true} : Minimum<X, Y>{X(x2), Y(f2), i, true};
+    }
+    if (f1 < f2) {
+      b = x2;
+      x2 = x1;
+      f2 = f1;
+      x1 = b - r * (b - a);
+      f1 = f(X(x1)).base_value;
+    } else {
+      a = x1;
+      x1 = x2;
+      f1 = f2;
+      x2 = a + r * (b - a);
+      f2 = f(X(x2)).base_value;
+    }
+  }
+  return f1 < f2 ? Minimum<X, Y>{X(x1), Y(f1), max_iterations, false} : Minimum<X, Y>{X(x2), Y(f2), max_iterations, false};
+}
+
+//
+// Batch Newton-Raphson method for independent problems solved in lockstep. `x`
+// holds the initial estimates and receives the roots. The functions are called
+// as f(i, x) and df(i, x) where i is the index of the problem.
+// Every iteration updates all problems in one loop. Problems that have
+// converged keep their estimate through a mask. The comparisons for the mask
+// are made on the bit patterns of the magnitudes, which order like the values
+// and put NaN above infinity, since GCC does not vectorize selects on floating
+// point conditions. The loop is thereby vectorized when f and df can be
+// inlined. Iteration stops when all problems have converged. A problem whose
+// step is not finite keeps its last estimate, as in the scalar version.
+// Returns the number of problems that did not converge.
+//
+// Example:
+//   // Temperatures where the enthalpy reaches h_target[i].
+//   auto h = [&](std::size_t i, kelvin T) { return cp * T + b * T * T - h_target[i]; };
+//   auto dh = [&](std::size_t, kelvin T) { return cp + b * T + b * T; };
+//   std::vector<kelvin> T(n, kelvin(300.0f));
+//   newton_raphson(h, dh, std::span<kelvin>(T), Unit<prefix::milli, kelvin>(1.0f), Quotient_unit<joule, kilogram>(1.0f));
+//
+template<internal::Coherent X, typename F, typename DF, typename Tx, typename Ty>
+requires (internal::Unit_function<F, X, std::size_t> && internal::Derivative_of<DF, F, X, std::size_t> &&
+          internal::Same_dimension<Tx, X> && internal::Same_dimension<Ty, internal::Function_value<F, std::size_t, X>>)
+std::size_t newton_raphson(F f, DF df, std::span<X> x, const Tx& x_tolerance, const Ty& residual_tolerance, int max_iterations = 50) {
+  using Bits = internal::Magnitude_bits;
+  const Bits x_tol = internal::magnitude_bits(x_tolerance.base_value);
+  const Bits residual_tol = internal::magnitude_bits(residual_tolerance.base_value);
+  const Bits infinity = internal::magnitude_bits(std::numeric_limits<TU_TYPE>::infinity());
+  const std::size_t n = x.size();
+  std::size_t active = n;
+  for (int iteration = 0; iteration < max_iterations && active > 0; ++iteration) {
+    active = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      const TU_TYPE y = f(i, x[i]).base_value;
+      const TU_TYPE step = y / df(i, x[i]).base_value;
+      // A step that is not finite, e.g. where df is 0, is not taken, and the
+      // problem counts as not converged since done is then 0.
+      const Bits unsolved = internal::magnitude_bits(y) > residual_tol;
+      const Bits move = unsolved & (Bits)(internal::magnitude_bits(step) < infinity);
+      const Bits done = internal::magnitude_bits(step) <= x_tol;
+      active += unsolved & (done ^ 1);
+      internal::store(x[i], x[i].base_value - std::bit_cast<TU_TYPE>(std::bit_cast<Bits>(step) & ((Bits)0 - move)));
+    }
+  }
+  return active;
+}
+
+} // namespace tu
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+#include "denormal.h"
+
+namespace tu {
+
+//
+// Entry of a sparse matrix at (row, column).
+//
+template<internal::Coherent U>
+struct Triplet {
+  std::size_t row;
+  std::size_t column;
+  U value;
+};
+
+//
+// Sparse matrix in compressed sparse row format whose entries all have the
+// coherent unit U, e.g. a nodal conductance matrix in siemens. The entries of
+// row i are values[row_start[i]] to values[row_start[i + 1] - 1] with the
+// columns in column_index, sorted in increasing order.
+//
+// Example:
+//   std::vector<Triplet<siemens>> stamps;
+//   stamps.push_back({0, 0, siemens(2.0f)});
+//   stamps.push_back({0, 1, siemens(-1.0f)});
+//   ...
+//   Csr_matrix<siemens> g = Csr_matrix<siemens>::from_triplets(n, n, std::span<const Triplet<siemens>>(stamps));
+//
+template<internal::Coherent U>
+struct Csr_matrix {
+  using Unit_type = U;
+
+  //
+  // Create from entries in any order. Entries at the same position are added,
+  // e.g. the stamps of several components connected to the same nodes.
+  //
+  static Csr_matrix from_triplets(std::size_t rows, std::size_t columns, std::span<const Triplet<U>> entries) {
+    std::vector<std::size_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&entries](std::size_t a, std::size_t b) {
+      return entries[a].row < entries[b].row || (entries[a].row == entries[b].row && entries[a].column < entries[b].column);
+    });
+    Csr_matrix m{rows, columns, std::vector<std::size_t>(rows + 1, 0), {}, {}};
+    m.column_index.reserve(entries.size());
+    m.values.reserve(entries.size());
+    for (std::size_t k = 0; k < order.size(); ++k) {
+      const Triplet<U>& e = entries[order[k]];
+      if (k > 0 && e.row == entries[order[k - 1]].row && e.column == entries[order[k - 1]].column) {
+        std::construct_at(&m.values.back(), m.values.back().base_value + e.value.base_value);
+      } else {
+        m.column_index.push_back(e.column);
+        m.values.push_back(e.value);
+        ++m.row_start[e.row + 1];
+      }
+    }
+    std::partial_sum(m.row_start.begin(), m.row_start.end(), m.row_start.begin());
+    return m;
+  }
+
+  //
+  // The entry at (row, column), zero if it is not stored.
+  //
+  U operator () (std::size_t row, std::size_t column) const noexcept {
+    const auto first = column_index.begin() + row_start[row];
+    const auto last = column_index.begin() + row_start[row + 1];
+    const auto it = std::lower_bound(first, last, column);
+    return it != last && *it == column ? values[it - column_index.begin()] : U(0.0f);
+  }
+
+  std::size_t non_zeros() const noexcept {
+    return values.size();
+  }
+
+  std::size_t rows;
+  std::size_t columns;
+  std::vector<std::size_t> row_start;
+  std::vector<std::size_t> column_index;
+  std::vector<U> values;
+};
+
+namespace internal {
+//
+// Rows [first, last) of y = m x where x(j) gives element j of x and
+// y(i, v) sets element i of y.
+//
+template<typename U, typename Get, typename Set>
+void multiply_rows(const Csr_matrix<U>& m, Get x, Set y, std::size_t first, std::size_t last) noexcept {
+  for (std::size_t i = first; i < last; ++i) {
+    TU_TYPE sum = (TU_TYPE)0.0;
+    for (std::size_t k = m.row_start[i]; k < m.row_start[i + 1]; ++k) {
+      sum += m.values[k].base_value * x(m.column_index[k]);
+    }
+    y(i, sum);
+  }
+}
+
+//
+// y = m x on `threads` threads. The rows are split so that the threads get
+// about the same number of entries.
+//
+template<typename U, typename Get, typename Set>
+void multiply(const Csr_matrix<U>& m, Get x, Set y, std::size_t threads) {
+  threads = std::max(std::min(threads, m.rows), (std::size_t)1);
+  std::vector<std::jthread> workers;
+  workers.reserve(threads - 1);
+  std::size_t first = 0;
+  for (std::size_t t = 1; t < threads; ++t) {
+    const std::size_t target = m.non_zeros() * t / threads;
+    const std::size_t last = std::lower_bound(m.row_start.begin() + first, m.row_start.end() - 1, target) - m.row_start.begin();
+    workers.push_back(internal::worker([&m, x, y, first, last] { multiply_rows(m, x, y, first, last); }));
+    first = last;
+  }
+  multiply_rows(m, x, y, first, m.rows);
+}
+} // namespace internal
+
+//
+// Sparse matrix vector product y = m x, e.g. currents in ampere from a
+// conductance matrix in siemens and node voltages in volt. The unit of y is
+// the product of the units of m and x. The rows are split between `threads`
+// threads.
+// x must have m.columns and y m.rows elements.
+//
+// Example:
+//   std::vector<volt> u(n);
+//   std::vector<ampere> i(n);
+//   multiply(g, std::span<const volt>(u), std::span<ampere>(i), 8);
+//
+template<typename U, internal::Coherent X>
+void multiply(const Csr_matrix<U>& m, std::span<const X> x, std::span<Product_unit<U, X>> y, std::size_t threads = 1) {
+  internal::multiply(m,
+                     [x](std::size_t j) { return x[j].base_value; },
+                     [y](std::size_t i, TU_TYPE v) { internal::store(y[i], v); },
+                     threads);
+}
+
+//
+// Result of an iterative solver. `residual` is the Euclidean norm of b - A x
+// in the unit of b.
+//
+template<internal::Coherent B>
+struct Solver_result {
+  B residual;
+  int iterations;
+  bool converged;
+};
+
+//
+// Buffers of conjugate_gradient for systems of n unknowns, so that repeated
+// solves, e.g. in every step of a simulation, do not allocate.
+//
+class Cg_workspace {
+public:
+  explicit Cg_workspace(std::size_t n) : n(n), data(6 * n) {}
+
+  std::size_t size() const noexcept {
+    return n;
+  }
+
+  //
+  // The i-th of the six buffers, used by conjugate_gradient.
+  //
+  std::span<TU_TYPE> buffer(std::size_t i) noexcept {
+    return std::span<TU_TYPE>(data).subspan(i * n, n);
+  }
+
+private:
+  std::size_t n;
+  std::vector<TU_TYPE> data;
+};
+
+//
+// Solve A x = b for a symmetric positive definite matrix A with the conjugate
+// gradient method preconditioned with the diagonal of A. The units follow the
+// system, e.g. A in siemens, x in volt and b in ampere, so the residuals are
+// currents and the tolerance is given as a current. x holds the initial
+// estimate and receives the solution. Stops when the norm of the residual is
+// at most `tolerance`. The matrix products use `threads` threads.
+// A must be square, and b, x and `workspace` must have its size. Otherwise
+// nothing is solved and the result has a NaN residual and is not converged.
+// With one thread the solver does not allocate. With more, every matrix
+// product starts its threads, which allocates.
+//
+// Example:
+//   Cg_workspace workspace(n);
+//   std::vector<volt> u(n, volt(0.0f));
+//   Solver_result<ampere> r = conjugate_gradient(g, std::span<const ampere>(injected), std::span<volt>(u),
+//                                                Unit<prefix::micro, ampere>(1.0f), 1000, workspace, 8);
+//
+template<typename U, internal::Coherent X, typename B, typename T>
+requires (std::is_same_v<B, Product_unit<U, X>> && internal::Same_dimension<T, B>)
+Solver_result<B> conjugate_gradient(const Csr_matrix<U>& a, std::span<const B> b, std::span<X> x, const T& tolerance,
+                                    int max_iterations, Cg_workspace& workspace, std::size_t threads = 1) {
+  const std::size_t n = a.rows;
+  if (a.columns != n || b.size() != n || x.size() != n || workspace.size() != n) {
+    return {B(std::numeric_limits<TU_TYPE>::quiet_NaN()), 0, false};
+  }
+  // Residual r and product q = A p have the unit of b. The solution u, the
+  // preconditioned residual z and the direction p have the unit of x.
+  const std::span<TU_TYPE> u = workspace.buffer(0);
+  const std::span<TU_TYPE> r = workspace.buffer(1);
+  const std::span<TU_TYPE> z = workspace.buffer(2);
+  const std::span<TU_TYPE> p = workspace.buffer(3);
+  const std::span<TU_TYPE> q = workspace.buffer(4);
+  const std::span<TU_TYPE> inverse_diagonal = workspace.buffer(5);
+  for (std::size_t i = 0; i < n; ++i) {
+    u[i] = x[i].base_value;
+    inverse_diagonal[i] = (TU_TYPE)1.0 / a(i, i).base_value;
+  }
+  const auto dot = [n](std::span<const TU_TYPE> l, std::span<const TU_TYPE> r) {
+    TU_TYPE sum = (TU_TYPE)0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+      sum += l[i] * r[i];
+    }
+    return sum;
+  };
+  const auto product = [&a, q, threads](std::span<const TU_TYPE> v) {
+    internal::multiply(a, [v](std::size_t j) { return v[j]; }, [q](std::size_t i, TU_TYPE s) { q[i] = s; }, threads);
+  };
+  const auto result = [&](TU_TYPE rr, int iterations, bool converged) {
+    for (std::size_t i = 0; i < n; ++i) {
+      internal::store(x[i], u[i]);
+    }
+    return Solver_result<B>{B(std::sqrt(rr)), iterations, converged};
+  };
+  product(u);
+  for (std::size_t i = 0; i < n; ++i) {
+    r[i] = b[i].base_value - q[i];
+    z[i] = inverse_diagonal[i] * r[i];
+    p[i] = z[i];
+  }
+  const TU_TYPE tolerance2 = tolerance.base_value * tolerance.base_value;
+  TU_TYPE rr = dot(r, r);
+  TU_TYPE rz = dot(r, z);
+  for (int k = 0; k < max_iterations; ++k) {
+    if (rr <= tolerance2) {
+      return result(rr, k, true);
+    }
+    product(p);
+    const TU_TYPE alpha = rz / dot(p, q);
+    for (std::size_t i = 0; i < n; ++i) {
+      u[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+      z[i] = inverse_diagonal[i] * r[i];
+    }
+    const TU_TYPE rz_next = dot(r, z);
+    const TU_TYPE beta = rz_next / rz;
+    rz = rz_next;
+    for (std::size_t i = 0; i < n; ++i) {
+      p[i] = z[i] + beta * p[i];
+    }
+    rr = dot(r, r);
+  }
+  return result(rr, max_iterations, rr <= tolerance2);
+}
+
+//
+// As above with a workspace of its own, which is allocated for each call.
+//
+template<typename U, internal::Coherent X, typename B, typename T>
+requires (std::is_same_v<B, Product_unit<U, X>> && internal::Same_dimension<T, B>)
+Solver_result<B> conjugate_gradient(const Csr_matrix<U>& a, std::span<const B> b, std::span<X> x, const T& tolerance,
+                                    int max_iterations, std::size_t threads = 1) {
+  Cg_workspace workspace(a.rows);
+  return conjugate_gradient(a, b, x, tolerance, max_iterations, workspace, threads);
+}
+
+} // namespace tu
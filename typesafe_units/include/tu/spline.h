@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <cstddef>
+
+#include "typesafe_units.h"
+
+namespace tu {
+
+//
+// Kinds of cubic splines.
+//   natural: Twice continuously differentiable with zero second derivative at
+//            the end knots.
+//   akima:   Slopes from Akima (1970). Continuously differentiable and less
+//            prone to overshoot near outliers than the natural spline.
+//   pchip:   Piecewise cubic Hermite interpolation with the slopes of Fritsch
+//            and Carlson (1980). Monotone where the data is monotone.
+//
+enum struct spline_kind {
+  natural,
+  akima,
+  pchip
+};
+
+namespace internal {
+template<std::size_t N>
+using Spline_storage = std::conditional_t<N == std::dynamic_extent, std::vector<TU_TYPE>, std::array<TU_TYPE, N>>;
+
+template<std::size_t N>
+constexpr Spline_storage<N> make_spline_storage([[maybe_unused]] std::size_t n) {
+  if constexpr (N == std::dynamic_extent) {
+    return std::vector<TU_TYPE>(n);
+  } else {
+    return {};
+  }
+}
+
+constexpr TU_TYPE absolute(TU_TYPE x) noexcept {
+  return x < (TU_TYPE)0.0 ? -x : x;
+}
+
+constexpr bool same_sign_nonzero(TU_TYPE a, TU_TYPE b) noexcept {
+  return (a > (TU_TYPE)0.0 && b > (TU_TYPE)0.0) || (a < (TU_TYPE)0.0 && b < (TU_TYPE)0.0);
+}
+
+//
+// Slopes at the knots for the spline kinds. h holds the knot spacings and m the
+// slopes of the n - 1 segments.
+//
+template<typename S>
+constexpr void natural_slopes(const S& h, const S& m, S& slope, std::size_t n) {
+  // Solve the tridiagonal system for the second derivatives M with the Thomas
+  // algorithm. M[0] = M[n - 1] = 0.
+  S diagonal = h;
+  S rhs = h;
+  S second = h;
+  for (std::size_t i = 0; i < n; ++i) {
+    second[i] = (TU_TYPE)0.0;
+  }
+  for (std::size_t i = 1; i + 1 < n; ++i) {
+    diagonal[i] = (TU_TYPE)2.0 * (h[i - 1] + h[i]);
+    rhs[i] = (TU_TYPE)6.0 * (m[i] - m[i - 1]);
+    if (i > 1) {
+      const TU_TYPE w = h[i - 1] / diagonal[i - 1];
+      diagonal[i] -= w * h[i - 1];
+      rhs[i] -= w * rhs[i - 1];
+    }
+  }
+  for (std::size_t i = n - 2; i > 0; --i) {
+    second[i] = (rhs[i] - (i + 2 < n ? h[i] * second[i + 1] : (TU_TYPE)0.0)) / diagonal[i];
+  }
+  for (std::size_t i = 0; i + 1 < n; ++i) {
+    slope[i] = m[i] - h[i] * ((TU_TYPE)2.0 * second[i] + second[i + 1]) / (TU_TYPE)6.0;
+  }
+  slope[n - 1] = m[n - 2] + h[n - 2] * (second[n - 2] + (TU_TYPE)2.0 * second[n - 1]) / (TU_TYPE)6.0;
+}
+
+template<typename S>
+constexpr void akima_slopes(const S& m, S& slope, std::size_t n) {
+  // Segment slopes outside the knots are extrapolated linearly.
+  const auto segment = [&](std::ptrdiff_t k) {
+    const std::ptrdiff_t last = (std::ptrdiff_t)n - 2;
+    if (k < 0) {
+      return m[0] + (TU_TYPE)k * (last > 0 ? m[1] - m[0] : (TU_TYPE)0.0);
+    }
+    if (k > last) {
+      return m[last] + (TU_TYPE)(k - last) * (last > 0 ? m[last] - m[last - 1] : (TU_TYPE)0.0);
+    }
+    return m[k];
+  };
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::ptrdiff_t k = (std::ptrdiff_t)i;
+    const TU_TYPE w1 = absolute(segment(k + 1) - segment(k));
+    const TU_TYPE w2 = absolute(segment(k - 1) - segment(k - 2));
+    slope[i] = w1 + w2 == (TU_TYPE)0.0 ? (TU_TYPE)0.5 * (segment(k - 1) + segment(k))
+                                       : (w1 * segment(k - 1) + w2 * segment(k)) / (w1 + w2);
+  }
+}
+
+template<typename S>
+constexpr void pchip_slopes(const S& h, const S& m, S& slope, std::size_t n) {
+  if (n == 2) {
+    slope[0] = m[0];
+    slope[1] = m[0];
+    return;
+  }
+  for (std::size_t i = 1; i + 1 < n; ++i) {
+    // Weighted harmonic mean of the neighbouring segment slopes.
+    const TU_TYPE w1 = (TU_TYPE)2.0 * h[i] + h[i - 1];
+    const TU_TYPE w2 = h[i] + (TU_TYPE)2.0 * h[i - 1];
+    slope[i] = same_sign_nonzero(m[i - 1], m[i]) ? (w1 + w2) / (w1 / m[i - 1] + w2 / m[i]) : (TU_TYPE)0.0;
+  }
+  // Three point end slopes, limited to keep the ends monotone.
+  const auto end = [](TU_TYPE h0, TU_TYPE h1, TU_TYPE m0, TU_TYPE m1) {
+    const TU_TYPE d = ((TU_TYPE)2.0 * h0 + h1) * m0 / (h0 + h1) - h0 * m1 / (h0 + h1);
+    if (!same_sign_nonzero(d, m0)) {
+      return (TU_TYPE)0.0;
+    }
+    if (!same_sign_nonzero(m0, m1) && absolute(d) > absolute((TU_TYPE)3.0 * m0)) {
+      return (TU_TYPE)3.0 * m0;
+    }
+    return d;
+  };
+  slope[0] = end(h[0], h[1], m[0], m[1]);
+  slope[n - 1] = end(h[n - 2], h[n - 3], m[n - 2], m[n - 3]);
+}
+} // namespace internal
+
+//
+// Cubic spline through the knots (x[i], y[i]) from the Coherent_unit X to the
+// Coherent_unit Y. The knots must be strictly increasing and at least two.
+// The spline is stored as one cubic polynomial per interval. Values outside
+// the knots are extrapolated with the polynomials of the end intervals.
+// N is the number of knots for fixed size tables, which can be constructed in
+// constant expressions from std::arrays of Coherent_units, or
+// std::dynamic_extent for a number of knots given at run time.
+// Derivatives have the dimension Y / X and integrals the dimension Y * X.
+//
+// Example:
+//   std::vector<second> t = ...;
+//   std::vector<metre> s = ...;
+//   Spline path(spline_kind::pchip, std::span<const second>(t), std::span<const metre>(s));
+//   metre s0 = path(Unit<prefix::milli, second>(1500.0f));
+//   metre_per_second v0 = path.derivative(Unit<prefix::milli, second>(1500.0f));
+//
+//   constexpr std::array<kelvin, 4> T{kelvin(250.0f), kelvin(300.0f), kelvin(350.0f), kelvin(400.0f)};
+//   constexpr std::array<Quotient_unit<kilogram, metre_cubed>, 4> rho{...};
+//   constexpr Spline density(spline_kind::natural, T, rho);
+//
+template<internal::Coherent X, internal::Coherent Y, std::size_t N = std::dynamic_extent>
+requires (N == std::dynamic_extent || N >= 2)
+class Spline {
+public:
+  template<typename Xe, typename Ye>
+  requires (N != std::dynamic_extent && internal::Same_dimension<Xe, X> && internal::Same_dimension<Ye, Y>)
+  constexpr Spline(spline_kind kind, const std::array<Xe, N>& x, const std::array<Ye, N>& y)
+  : Spline(kind, std::span<const Xe>(x), std::span<const Ye>(y)) {}
+
+  //
+  // The spans must have the same size of at least two and, for fixed size
+  // tables, the size N.
+  //
+  template<typename Xe, typename Ye>
+  requires (internal::Same_dimension<Xe, X> && internal::Same_dimension<Ye, Y>)
+  constexpr Spline(spline_kind kind, std::span<const Xe> x, std::span<const Ye> y)
+  : knots(internal::make_spline_storage<N>(x.size())),
+    c0(internal::make_spline_storage<N>(x.size())),
+    c1(internal::make_spline_storage<N>(x.size())),
+    c2(internal::make_spline_storage<N>(x.size())),
+    c3(internal::make_spline_storage<N>(x.size())),
+    cumulative(internal::make_spline_storage<N>(x.size())) {
+    const std::size_t n = x.size();
+    Storage h = internal::make_spline_storage<N>(n);
+    Storage m = internal::make_spline_storage<N>(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      knots[i] = x[i].base_value;
+      c0[i] = y[i].base_value;
+    }
+    for (std::size_t i = 0; i + 1 < n; ++i) {
+      h[i] = knots[i + 1] - knots[i];
+      m[i] = (c0[i + 1] - c0[i]) / h[i];
+    }
+    switch (kind) {
+      case spline_kind::natural:
+        internal::natural_slopes(h, m, c1, n);
+        break;
+      case spline_kind::akima:
+        internal::akima_slopes(m, c1, n);
+        break;
+      case spline_kind::pchip:
+        internal::pchip_slopes(h, m, c1, n);
+        break;
+    }
+    // Hermite form to c0 + c1 s + c2 s^2 + c3 s^3 with s = x - knots[i].
+    for (std::size_t i = 0; i + 1 < n; ++i) {
+      c2[i] = ((TU_TYPE)3.0 * m[i] - (TU_TYPE)2.0 * c1[i] - c1[i + 1]) / h[i];
+      c3[i] = (c1[i] + c1[i + 1] - (TU_TYPE)2.0 * m[i]) / (h[i] * h[i]);
+      cumulative[i + 1] = cumulative[i] + antiderivative(i, h[i]);
+    }
+    c2[n - 1] = c2[n - 2];
+    c3[n - 1] = c3[n - 2];
+  }
+
+  template<typename V>
+  requires internal::Same_dimension<V, X>
+  constexpr Y operator () (const V& x) const noexcept {
+    const std::size_t i = interval(x.base_value);
+    return Y(value(i, x.base_value - knots[i]));
+  }
+
+  template<typename V>
+  requires internal::Same_dimension<V, X>
+  constexpr Quotient_unit<Y, X> derivative(const V& x) const noexcept {
+    const std::size_t i = interval(x.base_value);
+    const TU_TYPE s = x.base_value - knots[i];
+    return Quotient_unit<Y, X>(c1[i] + s * ((TU_TYPE)2.0 * c2[i] + (TU_TYPE)3.0 * c3[i] * s));
+  }
+
+  //
+  // The integral of the spline from `from` to `to`.
+  //
+  template<typename V, typename W>
+  requires (internal::Same_dimension<V, X> && internal::Same_dimension<W, X>)
+  constexpr Product_unit<Y, X> integral(const V& from, const W& to) const noexcept {
+    return Product_unit<Y, X>(primitive(to.base_value) - primitive(from.base_value));
+  }
+
+  constexpr std::size_t size() const noexcept {
+    return knots.size();
+  }
+
+  //
+  // Index of the interval used for x, i.e. the last i < size() - 1 with
+  // knots[i] <= x, or 0. The binary search has no data dependent branches.
+  //
+  constexpr std::size_t interval(TU_TYPE x) const noexcept {
+    std::size_t first = 0;
+    std::size_t length = knots.size() - 1;
+    while (length > 1) {
+      const std::size_t half = length / 2;
+      first = knots[first + half] <= x ? first + half : first;
+      length -= half;
+    }
+    return first;
+  }
+
+  template<internal::Coherent X_, internal::Coherent Y_, std::size_t N_, typename V>
+  requires internal::Same_dimension<V, X_>
+  friend void evaluate(const Spline<X_, Y_, N_>& spline, std::span<const V> x, std::span<Y_> out) noexcept;
+
+private:
+  using Storage = internal::Spline_storage<N>;
+
+  constexpr TU_TYPE value(std::size_t i, TU_TYPE s) const noexcept {
+    return c0[i] + s * (c1[i] + s * (c2[i] + s * c3[i]));
+  }
+
+  constexpr TU_TYPE antiderivative(std::size_t i, TU_TYPE s) const noexcept {
+    return s * (c0[i] + s * (c1[i] / (TU_TYPE)2.0 + s * (c2[i] / (TU_TYPE)3.0 + s * c3[i] / (TU_TYPE)4.0)));
+  }
+
+  constexpr TU_TYPE primitive(TU_TYPE x) const noexcept {
+    const std::size_t i = interval(x);
+    return cumulative[i] + antiderivative(i, x - knots[i]);
+  }
+
+  Storage knots;
+  Storage c0;
+  Storage c1;
+  Storage c2;
+  Storage c3;
+  Storage cumulative;
+};
+
+template<typename Xe, typename Ye, std::size_t N>
+Spline(spline_kind, const std::array<Xe, N>&, const std::array<Ye, N>&) -> Spline<internal::Coherent_of<Xe>, internal::Coherent_of<Ye>, N>;
+
+template<typename Xe, typename Ye>
+Spline(spline_kind, std::span<const Xe>, std::span<const Ye>) -> Spline<internal::Coherent_of<Xe>, internal::Coherent_of<Ye>>;
+
+//
+// Batch evaluation out[i] = spline(x[i]), e.g. to resample a series onto a
+// grid. The intervals of a block of points are found first and the
+// polynomials are then evaluated for the whole block in a loop without
+// branches that the compiler can vectorize with gather loads. The results go
+// to a local block first since the compiler cannot vectorize gathers from the
+// coefficients in a loop that stores to memory the coefficients may alias.
+// Both spans must have the same size.
+//
+template<internal::Coherent X, internal::Coherent Y, std::size_t N, typename V>
+requires internal::Same_dimension<V, X>
+void evaluate(const Spline<X, Y, N>& spline, std::span<const V> x, std::span<Y> out) noexcept {
+  constexpr std::size_t block = 64;
+  std::array<std::int32_t, block> index;
+  std::array<TU_TYPE, block> local;
+  const TU_TYPE* c0 = spline.c0.data();
+  const TU_TYPE* c1 = spline.c1.data();
+  const TU_TYPE* c2 = spline.c2.data();
+  const TU_TYPE* c3 = spline.c3.data();
+  const std::size_t n = out.size();
+  for (std::size_t first = 0; first < n; first += block) {
+    const std::size_t count = std::min(block, n - first);
+    for (std::size_t j = 0; j < count; ++j) {
+      const TU_TYPE xj = x[first + j].base_value;
+      const std::size_t i = spline.interval(xj);
+      index[j] = (std::int32_t)i;
+      local[j] = xj - spline.knots[i];
+    }
+    for (std::size_t j = 0; j < count; ++j) {
+      const std::int32_t i = index[j];
+      const TU_TYPE s = local[j];
+      local[j] = c0[i] + s * (c1[i] + s * (c2[i] + s * c3[i]));
+    }
+    for (std::size_t j = 0; j < count; ++j) {
+      internal::store(out[first + j], local[j]);
+    }
+  }
+}
+
+} // namespace tu
@@ -14,6 +14,42 @@
 #include <compare>
 #include <numbers>
 #include <ratio>
+#include <memory>
+#include <array>
+
+//
+// With TU_CHECKED defined every constructor, operator, pow, sqrt, unop,
+// conversion and batch result is checked for NaN, infinity and subnormal
+// values, see `set_check_handler`. Without it the checks compile to nothing.
+// All translation units of a program must agree on TU_CHECKED.
+//
+// With TU_PROFILE_CONVERSIONS defined every convert_to, converting Unit
+// constructor and promotion of a Unit to its coherent unit is counted per
+// call site, see `Conversion_profile`.
+//
+#if defined(TU_CHECKED) || defined(TU_PROFILE_CONVERSIONS)
+#   include <source_location>
+#   define TU_CALL_SITE , [[maybe_unused]] std::source_location call_site = std::source_location::current()
+#   define TU_FORWARD_CALL_SITE , call_site
+#else
+#   define TU_CALL_SITE
+#   define TU_FORWARD_CALL_SITE
+#endif
+
+#if defined(TU_CHECKED)
+#   include <atomic>
+#   include <cstdio>
+#endif
+
+#if defined(TU_PROFILE_CONVERSIONS)
+#   include <algorithm>
+#   include <cstdint>
+#   include <cstdio>
+#   include <mutex>
+#   include <string_view>
+#   include <unordered_map>
+#   include <vector>
+#endif
 
 namespace tu {
 
@@ -94,6 +130,125 @@ enum struct prefix {
   quetta = 30,
 };
 
+namespace internal {
+//
+// Name of the dimension with the powers p of s, m, kg, A, K, mol and cd.
+//
+template<typename... p>
+inline constexpr auto dimension_name = [] {
+  constexpr const char* symbols[] = {"s", "m", "kg", "A", "K", "mol", "cd"};
+  constexpr std::intmax_t num[] = {p::num..., 0};
+  constexpr std::intmax_t den[] = {p::den..., 1};
+  std::array<char, 128> name{};
+  std::size_t n = 0;
+  const auto append_number = [&](std::intmax_t v) {
+    char digits[24]{};
+    std::size_t d = 0;
+    do {
+      digits[d++] = (char)('0' + v % 10);
+      v /= 10;
+    } while (v > 0);
+    while (d > 0) {
+      name[n++] = digits[--d];
+    }
+  };
+  for (std::size_t i = 0; i < sizeof...(p); ++i) {
+    if (num[i] == 0) {
+      continue;
+    }
+    if (n > 0) {
+      name[n++] = ' ';
+    }
+    for (const char* c = symbols[i]; *c != '\0'; ++c) {
+      name[n++] = *c;
+    }
+    if (num[i] != 1 || den[i] != 1) {
+      name[n++] = '^';
+      if (num[i] < 0) {
+        name[n++] = '-';
+      }
+      append_number(num[i] < 0 ? -num[i] : num[i]);
+      if (den[i] != 1) {
+        name[n++] = '/';
+        append_number(den[i]);
+      }
+    }
+  }
+  if (n == 0) {
+    name[n++] = '1';
+  }
+  return name;
+}();
+} // namespace internal
+
+#if defined(TU_PROFILE_CONVERSIONS)
+namespace internal {
+template<typename From, typename To>
+void count_conversion(const std::source_location& call_site);
+} // namespace internal
+#endif
+
+#if defined(TU_CHECKED)
+//
+// Kind of value found by a check.
+//
+enum struct check_failure {
+  nan,
+  infinite,
+  subnormal
+};
+
+//
+// A checked result that is NaN, infinite or subnormal. `unit` is the
+// dimension of the result in base units, e.g. "s^-2 m^2 kg" for joule, and
+// `call_site` is where the result was created. Results of operators are
+// reported at the operator, whose function name holds the operand types.
+//
+struct Check_report {
+  check_failure failure;
+  TU_TYPE value;
+  const char* unit;
+  std::source_location call_site;
+};
+
+using Check_handler = void (*)(const Check_report&);
+
+namespace internal {
+inline void print_check_report(const Check_report& r) noexcept {
+  static constexpr const char* failures[] = {"NaN", "infinite", "subnormal"};
+  std::fprintf(stderr, "tu: %s result %g [%s] at %s:%u in %s\n", failures[(int)r.failure], (double)r.value, r.unit,
+               r.call_site.file_name(), (unsigned)r.call_site.line(), r.call_site.function_name());
+}
+
+inline std::atomic<Check_handler> check_handler{print_check_report};
+
+template<typename... p>
+constexpr void check(TU_TYPE value, const std::source_location& call_site) noexcept {
+  if (std::is_constant_evaluated()) {
+    return;
+  }
+  const int c = std::fpclassify(value);
+  if (c == FP_NAN || c == FP_INFINITE || c == FP_SUBNORMAL) {
+    const check_failure failure = c == FP_NAN ? check_failure::nan : c == FP_INFINITE ? check_failure::infinite : check_failure::subnormal;
+    check_handler.load(std::memory_order_relaxed)({failure, value, dimension_name<p...>.data(), call_site});
+  }
+}
+} // namespace internal
+
+//
+// Set the function called for checked results that are NaN, infinite or
+// subnormal and return the previous one. The default prints the report to
+// stderr. The handler is called from noexcept functions, so to stop at the
+// first report it should abort rather than throw.
+//
+// Example:
+//   tu::set_check_handler([](const tu::Check_report&) { std::abort(); });
+//
+inline Check_handler set_check_handler(Check_handler handler) noexcept {
+  return internal::check_handler.exchange(handler);
+}
+#endif
+
 namespace internal {
 //  
 // Returns compile time calculation of 10^exp.
@@ -181,13 +336,34 @@ template<Ratio... p>
 struct Coherent_unit_base : Unit_fundament {
   using Base = Coherent_unit_base<p...>;
   constexpr Coherent_unit_base() noexcept = default;
-  Coherent_unit_base(TU_TYPE v) noexcept : base_value(v){}
+  constexpr Coherent_unit_base(TU_TYPE v TU_CALL_SITE) noexcept : base_value(v) {
+#if defined(TU_CHECKED)
+    check<p...>(base_value, call_site);
+#endif
+  }
   
   template<prefix pf,
            typename U,
            template<prefix, typename> typename Un>
   requires std::is_same<typename U::Base, Base>::value
-  Coherent_unit_base(const Un<pf, U>, TU_TYPE value) noexcept : base_value(value * U::base_multiplier * pow10<(int)pf>() + U::base_adder) {}
+  Coherent_unit_base(const Un<pf, U>, TU_TYPE value TU_CALL_SITE) noexcept : base_value(value * U::base_multiplier * pow10<(int)pf>() + U::base_adder) {
+#if defined(TU_CHECKED)
+    check<p...>(base_value, call_site);
+#endif
+  }
+
+#if defined(TU_PROFILE_CONVERSIONS)
+  //
+  // Promotion of a Unit to its coherent unit, e.g. when passed to an operator.
+  //
+  template<prefix pf,
+           typename U,
+           template<prefix, typename> typename Un>
+  requires std::is_same<typename U::Base, Base>::value
+  Coherent_unit_base(const Un<pf, U>& u TU_CALL_SITE) noexcept : base_value(u.base_value) {
+    count_conversion<Un<pf, U>, Base>(call_site);
+  }
+#endif
 
   auto operator <=> (const Coherent_unit_base<p...>& other) const noexcept = default;
   
@@ -293,9 +469,16 @@ template<Second_power T,
          Mole_power N,
          Candela_power J>
 struct Coherent_unit: internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power> {
-  Coherent_unit() = default;
-  Coherent_unit(const internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>& cb) : internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>(cb) {}
-  Coherent_unit(TU_TYPE v) : internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>(v){}
+  Coherent_unit() noexcept = default;
+  constexpr Coherent_unit(const internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>& cb) noexcept : internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>(cb) {}
+  constexpr Coherent_unit(TU_TYPE v TU_CALL_SITE) noexcept : internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>(v TU_FORWARD_CALL_SITE){}
+#if defined(TU_PROFILE_CONVERSIONS)
+  template<prefix pf,
+           typename U,
+           template<prefix, typename> typename Un>
+  requires std::is_same<typename U::Base, typename Coherent_unit::Base>::value
+  Coherent_unit(const Un<pf, U>& u TU_CALL_SITE) noexcept : internal::Coherent_unit_base<typename T::power, typename L::power, typename M::power, typename I::power, typename Theta::power, typename N::power, typename J::power>(u TU_FORWARD_CALL_SITE) {}
+#endif
 };
 
 namespace internal {
@@ -308,6 +491,37 @@ template<Ratio ts, Ratio tm, Ratio tkg, Ratio tA, Ratio tK, Ratio tmol, Ratio tc
 constexpr auto create_coherent_unit(const Coherent_unit_base<ts, tm, tkg, tA, tK, tmol, tcd>& cb) noexcept {
   return Coherent_unit<s<ts>, m<tm>, kg<tkg>, A<tA>, K<tK>, mol<tmol>, cd<tcd>>(cb);
 }
+
+//
+// Satisfied by Coherent_units, i.e. the types returned by operations on units.
+// A Coherent_unit holds nothing but its base value which makes contiguous
+// arrays of them suitable for batch operations.
+//
+template<typename U>
+concept Coherent = std::derived_from<U, Unit_fundament> &&
+                   std::is_same_v<U, decltype(create_coherent_unit(std::declval<typename U::Base>()))>;
+
+//
+// The Coherent_unit that U is expressed in, e.g. Coherent_of<Unit<prefix::milli, hour>> is second.
+//
+template<typename U>
+using Coherent_of = decltype(create_coherent_unit(std::declval<typename U::Base>()));
+
+//
+// V is a unit with the same dimension as U.
+//
+template<typename V, typename U>
+concept Same_dimension = std::derived_from<V, Unit_fundament> && std::is_same<typename V::Base, typename U::Base>::value;
+
+//
+// Overwrite the coherent unit `u` with a new base value.
+// Units are immutable. Batch operations that fill preallocated arrays of units
+// use this to write their results.
+//
+template<Coherent U>
+void store(U& u, TU_TYPE base_value TU_CALL_SITE) noexcept {
+  std::construct_at(&u, base_value TU_FORWARD_CALL_SITE);
+}
 } // namespace internal
 
 // 
@@ -334,8 +548,11 @@ template<prefix to_prefix,
          typename From_unit,
          template<prefix, typename> typename Unit>
 requires std::is_same<typename From_unit::Base, typename To_unit::Base>::value
-Unit<to_prefix, To_unit> convert_to(const Unit<from_prefix, From_unit>& from) noexcept {
-  return {(from.base_value - To_unit::base_adder) * internal::pow10<-(int)to_prefix>() / To_unit::base_multiplier};
+Unit<to_prefix, To_unit> convert_to(const Unit<from_prefix, From_unit>& from TU_CALL_SITE) noexcept {
+#if defined(TU_PROFILE_CONVERSIONS)
+  internal::count_conversion<Unit<from_prefix, From_unit>, Unit<to_prefix, To_unit>>(call_site);
+#endif
+  return {(from.base_value - To_unit::base_adder) * internal::pow10<-(int)to_prefix>() / To_unit::base_multiplier TU_FORWARD_CALL_SITE};
 }
 
 // 
@@ -347,15 +564,208 @@ Unit<to_prefix, To_unit> convert_to(const Unit<from_prefix, From_unit>& from) no
 template<prefix pf, typename U>
 requires std::derived_from<U, internal::Unit_fundament>
 struct Unit : U::Base {
-  Unit(TU_TYPE v) noexcept : U::Base(*this, v), value(v) {};
+  Unit(TU_TYPE v TU_CALL_SITE) noexcept : U::Base(*this, v TU_FORWARD_CALL_SITE), value(v) {};
   
   template<typename V>
   requires (std::derived_from<V, internal::Unit_fundament> && std::is_same<typename V::Base, typename U::Base>::value)
-  Unit(const V& v) noexcept : U::Base(*this, (v.base_value - U::base_adder) * internal::pow10<-(int)pf>() / U::base_multiplier), value((v.base_value - U::base_adder) * internal::pow10<-(int)pf>() / U::base_multiplier){}
+  Unit(const V& v TU_CALL_SITE) noexcept : U::Base(*this, (v.base_value - U::base_adder) * internal::pow10<-(int)pf>() / U::base_multiplier TU_FORWARD_CALL_SITE), value((v.base_value - U::base_adder) * internal::pow10<-(int)pf>() / U::base_multiplier) {
+#if defined(TU_PROFILE_CONVERSIONS)
+    internal::count_conversion<V, Unit>(call_site);
+#endif
+  }
 
   const TU_TYPE value{0.0};
 };
 
+namespace internal {
+//
+// Relation between the value of a unit type and its base value:
+// base_value = value * multiplier + adder.
+// For Coherent_units the value is the base value.
+//
+template<typename T>
+struct Unit_scale {
+  static constexpr TU_TYPE multiplier{1.0f};
+  static constexpr TU_TYPE adder{0.0f};
+};
+
+template<prefix pf, typename U>
+struct Unit_scale<Unit<pf, U>> {
+  static constexpr TU_TYPE multiplier = U::base_multiplier * pow10<(int)pf>();
+  static constexpr TU_TYPE adder = U::base_adder;
+};
+
+//
+// Name of the dimension of the unit U, e.g. "s^-2 m^2 kg" for joule.
+//
+template<typename U>
+constexpr const char* dimension_of() noexcept {
+  return []<typename... p>(const Coherent_unit_base<p...>*) {
+    return dimension_name<p...>.data();
+  }(static_cast<const typename U::Base*>(nullptr));
+}
+} // namespace internal
+
+#if defined(TU_PROFILE_CONVERSIONS)
+//
+// Unit of a counted conversion, with base_value = value * multiplier + adder
+// in the coherent unit of the dimension `dimension`, e.g. 0.001 and "m" for
+// millimetre.
+//
+struct Conversion_unit {
+  TU_TYPE multiplier;
+  TU_TYPE adder;
+  const char* dimension;
+};
+
+//
+// Number of conversions from one unit to another at one call site.
+//
+struct Conversion_count {
+  const Conversion_unit* from;
+  const Conversion_unit* to;
+  std::source_location call_site;
+  std::uint64_t count;
+};
+
+//
+// Counts of conversions per unit pair and call site. Each thread counts its
+// conversions in its own profile, `thread_conversion_profile()`, and the
+// profiles of several threads are combined with `merge` or
+// `collect_conversion_profile`.
+//
+// Example:
+//   tu::Conversion_profile total;
+//   ... on each thread when done:
+//   tu::collect_conversion_profile(total);
+//   ...
+//   total.print(stderr, 10);
+//
+class Conversion_profile {
+public:
+  void add(const Conversion_unit* from, const Conversion_unit* to, const std::source_location& call_site, std::uint64_t n = 1) {
+    auto [site, inserted] = counts.try_emplace(Key{from, to, call_site.file_name(), call_site.line(), call_site.column()},
+                                               Conversion_count{from, to, call_site, 0});
+    site->second.count += n;
+  }
+
+  void merge(const Conversion_profile& other) {
+    for (const auto& [key, c] : other.counts) {
+      add(c.from, c.to, c.call_site, c.count);
+    }
+  }
+
+  void clear() noexcept {
+    counts.clear();
+  }
+
+  std::uint64_t total() const noexcept {
+    std::uint64_t sum = 0;
+    for (const auto& [key, c] : counts) {
+      sum += c.count;
+    }
+    return sum;
+  }
+
+  //
+  // The call sites ordered from the most to the least conversions.
+  //
+  std::vector<Conversion_count> ranked() const {
+    std::vector<Conversion_count> sites;
+    sites.reserve(counts.size());
+    for (const auto& [key, c] : counts) {
+      sites.push_back(c);
+    }
+    std::sort(sites.begin(), sites.end(), [](const Conversion_count& l, const Conversion_count& r) { return l.count > r.count; });
+    return sites;
+  }
+
+  //
+  // Print the `top` call sites with the most conversions.
+  //
+  void print(std::FILE* out, std::size_t top = 20) const {
+    const std::vector<Conversion_count> sites = ranked();
+    std::fprintf(out, "%12s  %-24s %-24s %s\n", "conversions", "from", "to", "call site");
+    for (std::size_t i = 0; i < std::min(top, sites.size()); ++i) {
+      const Conversion_count& c = sites[i];
+      char from[64];
+      char to[64];
+      std::fprintf(out, "%12llu  %-24s %-24s %s:%u %s\n", (unsigned long long)c.count, format(*c.from, from), format(*c.to, to),
+                   c.call_site.file_name(), (unsigned)c.call_site.line(), c.call_site.function_name());
+    }
+  }
+
+private:
+  //
+  // The file is compared by name, since a header included in several
+  // translation units may have its name stored once in each.
+  //
+  struct Key {
+    const Conversion_unit* from;
+    const Conversion_unit* to;
+    std::string_view file;
+    std::uint_least32_t line;
+    std::uint_least32_t column;
+
+    bool operator == (const Key&) const noexcept = default;
+  };
+
+  struct Key_hash {
+    std::size_t operator () (const Key& k) const noexcept {
+      std::size_t h = std::hash<const void*>()(k.from);
+      h = h * 31 + std::hash<const void*>()(k.to);
+      h = h * 31 + std::hash<std::string_view>()(k.file);
+      return h * 31 + k.line * 1024 + k.column;
+    }
+  };
+
+  template<std::size_t N>
+  static const char* format(const Conversion_unit& u, char (&text)[N]) noexcept {
+    int n = 0;
+    if (u.multiplier != (TU_TYPE)1.0) {
+      n = std::snprintf(text, N, "%g ", (double)u.multiplier);
+    }
+    n += std::snprintf(text + n, N - (std::size_t)n, "%s", u.dimension);
+    if (u.adder != (TU_TYPE)0.0) {
+      std::snprintf(text + n, N - (std::size_t)n, " + %g %s", (double)u.adder, u.dimension);
+    }
+    return text;
+  }
+
+  std::unordered_map<Key, Conversion_count, Key_hash> counts;
+};
+
+//
+// The profile the calling thread counts its conversions in.
+//
+inline Conversion_profile& thread_conversion_profile() noexcept {
+  thread_local Conversion_profile profile;
+  return profile;
+}
+
+namespace internal {
+inline std::mutex conversion_profile_mutex;
+
+template<typename U>
+inline constexpr Conversion_unit conversion_unit{Unit_scale<U>::multiplier, Unit_scale<U>::adder, dimension_of<U>()};
+
+template<typename From, typename To>
+void count_conversion(const std::source_location& call_site) {
+  thread_conversion_profile().add(&conversion_unit<From>, &conversion_unit<To>, call_site);
+}
+} // namespace internal
+
+//
+// Merge the counts of the calling thread into `total` and clear them. Threads
+// may collect into the same total at the same time.
+//
+inline void collect_conversion_profile(Conversion_profile& total) {
+  std::lock_guard<std::mutex> lock(internal::conversion_profile_mutex);
+  total.merge(thread_conversion_profile());
+  thread_conversion_profile().clear();
+}
+#endif
+
 // 
 // Define binary operations +, -, *, and / for units.
 // 
@@ -438,21 +848,37 @@ constexpr auto binary_op_args_num(internal::Coherent_unit_base<U_first, U_args..
 template<internal::Ratio exp,
          internal::Ratio U_first,
          internal::Ratio... U_args>
-auto pow(internal::Coherent_unit_base<U_first, U_args...> u) noexcept -> decltype(binary_op_args_num(internal::Coherent_unit_base<U_first, U_args...>(),
+auto pow(internal::Coherent_unit_base<U_first, U_args...> u TU_CALL_SITE) noexcept -> decltype(binary_op_args_num(internal::Coherent_unit_base<U_first, U_args...>(),
                                                                                                      exp(),
                                                                                                      internal::Coherent_unit_base<>(),
                                                                                                      internal::Multiply())) {
-  return {std::pow(u.base_value, internal::fraction(exp()))};
+  return {std::pow(u.base_value, internal::fraction(exp())) TU_FORWARD_CALL_SITE};
 }
 
 //
 // sqrt for struct Unit and Coherent_unit<> or similar.
 //
 template<typename... U_args>
-auto sqrt(internal::Coherent_unit_base<U_args...> u) noexcept {
-  return pow<std::ratio<1,2>>(u);
+auto sqrt(internal::Coherent_unit_base<U_args...> u TU_CALL_SITE) noexcept {
+  return pow<std::ratio<1,2>>(u TU_FORWARD_CALL_SITE);
 }
 
+//
+// The Coherent_unit types that result from *, / and pow on units.
+// Example:
+//   Product_unit<ohm, ampere> is volt
+//   Quotient_unit<metre, second> is metre_per_second
+//   Power_unit<metre, std::ratio<2>> is metre_squared
+//
+template<typename L, typename R>
+using Product_unit = decltype(std::declval<L>() * std::declval<R>());
+
+template<typename L, typename R>
+using Quotient_unit = decltype(std::declval<L>() / std::declval<R>());
+
+template<typename U, internal::Ratio exp>
+using Power_unit = decltype(pow<exp>(std::declval<U>()));
+
 //
 // Define `unop`. 
 // unop is a template function that applies any unary function that takes a TU_TYPE
@@ -461,7 +887,7 @@ auto sqrt(internal::Coherent_unit_base<U_args...> u) noexcept {
 // the resulting value of the performed operation. This makes it possible to operate with
 // any unary function (subjected to the restrictions above) from the standard library on a
 // Unit or Coherent_unit. unop can take both unary functions and lambda expressions as
-// template parameter. 
+// template parameter. unop is noexcept so the function must not throw.
 //
 // Example:
 //  std::cout << unop<std::sin>(Unit<prefix::no_prefix, degree>(90)).base_value; // prints 1
@@ -470,14 +896,14 @@ using Unary_op_func = TU_TYPE(*)(TU_TYPE);
 
 template<Unary_op_func op, prefix pf, typename U>
 requires (Unit<pf, U>::is_scalar())
-auto unop(const Unit<pf, U>& u){
-  return internal::create_coherent_unit(typename U::Base(op(u.base_value)));
+auto unop(const Unit<pf, U>& u TU_CALL_SITE) noexcept {
+  return internal::create_coherent_unit(typename U::Base(op(u.base_value) TU_FORWARD_CALL_SITE));
 }
 
 template<Unary_op_func op, typename U>
 requires (U::is_scalar())
-auto unop(const U& u){
-  return U(op(u.base_value));
+auto unop(const U& u TU_CALL_SITE) noexcept {
+  return U(op(u.base_value) TU_FORWARD_CALL_SITE);
 }
 
 // 